@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) 2026 Claes Nästén <pekdon@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * Counts heap allocations made per file when opening files and looking
+ * up their cached thumbnails.
+ *
+ * Files are created in a temporary directory and opened by relative
+ * path, half of them with a space in the name so that URIs need
+ * escaping. Cache lookups run without the cache index so that the
+ * cache path is built for every file.
+ *
+ * Usage: bench_alloc [count]
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "file_multi.h"
+#include "thumb.h"
+
+#define BENCH_ALLOC_COUNT 10000
+
+extern void *__libc_malloc (size_t size);
+extern void *__libc_calloc (size_t nmemb, size_t size);
+extern void *__libc_realloc (void *ptr, size_t size);
+
+static __thread gboolean bench_counting = FALSE;
+static __thread guint64 bench_allocs = 0;
+
+static void bench_start (void);
+static guint64 bench_stop (void);
+
+void*
+malloc (size_t size)
+{
+    if (bench_counting) {
+        bench_allocs++;
+    }
+    return __libc_malloc (size);
+}
+
+void*
+calloc (size_t nmemb, size_t size)
+{
+    if (bench_counting) {
+        bench_allocs++;
+    }
+    return __libc_calloc (nmemb, size);
+}
+
+void*
+realloc (void *ptr, size_t size)
+{
+    if (bench_counting) {
+        bench_allocs++;
+    }
+    return __libc_realloc (ptr, size);
+}
+
+int
+main (int argc, char *argv[])
+{
+    guint i, count = argc > 1 ? atoi (argv[1]) : BENCH_ALLOC_COUNT;
+    gchar *dir, **names;
+    guint64 allocs_open, allocs_lookup;
+    struct file_multi_arena *arena;
+    struct file_multi **files;
+
+    /* Keep the cache lookups away from the users cache */
+    dir = g_dir_make_tmp ("geh-bench-XXXXXX", NULL);
+    if (! dir || chdir (dir)) {
+        fprintf (stderr, "failed to create temporary directory\n");
+        return 1;
+    }
+    g_setenv ("XDG_CACHE_HOME", dir, TRUE);
+
+    names = g_malloc (sizeof (gchar*) * count);
+    files = g_malloc (sizeof (struct file_multi*) * count);
+    for (i = 0; i < count; i++) {
+        names[i] = g_strdup_printf (i % 2 ? "image %u.jpg" : "image_%u.jpg",
+                                    i);
+        g_file_set_contents (names[i], "", 0, NULL);
+    }
+
+    /* Warm up one-time lookups, current directory and cache directory */
+    arena = file_multi_arena_new ();
+    thumb_is_cached (file_multi_open (arena, names[0]), THUMB_DEFAULT_SIDE);
+
+    bench_start ();
+    for (i = 0; i < count; i++) {
+        files[i] = file_multi_open (arena, names[i]);
+        file_multi_get_uri (files[i]);
+        file_multi_get_ext (files[i]);
+    }
+    allocs_open = bench_stop ();
+
+    bench_start ();
+    for (i = 0; i < count; i++) {
+        thumb_is_cached (files[i], THUMB_DEFAULT_SIDE);
+    }
+    allocs_lookup = bench_stop ();
+
+    printf ("files:  %u\n", count);
+    printf ("open:   %.3f allocations per file\n",
+            (gdouble) allocs_open / count);
+    printf ("lookup: %.3f allocations per file\n",
+            (gdouble) allocs_lookup / count);
+
+    /* Clean up */
+    file_multi_arena_free (arena);
+    for (i = 0; i < count; i++) {
+        g_unlink (names[i]);
+        g_free (names[i]);
+    }
+    g_free (names);
+    g_free (files);
+    g_rmdir (dir);
+    g_free (dir);
+
+    return 0;
+}
+
+/**
+ * Starts counting allocations made by the calling thread.
+ */
+void
+bench_start (void)
+{
+    bench_allocs = 0;
+    bench_counting = TRUE;
+}
+
+/**
+ * Stops counting allocations.
+ *
+ * @return Number of allocations since bench_start.
+ */
+guint64
+bench_stop (void)
+{
+    bench_counting = FALSE;
+    return bench_allocs;
+}
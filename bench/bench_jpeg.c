@@ -0,0 +1,191 @@
+/*
+ * Copyright (C) 2026 Claes Nästén <pekdon@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * Times opening a JPEG file for display fitted to a view, decoded at
+ * full size with the gdk-pixbuf loader and scaled down compared to
+ * decoded downscaled with libjpeg DCT scaling.
+ *
+ * Decode times are given both for the decode alone and for opening
+ * and zooming the image to fit as when displayed.
+ *
+ * Usage: bench_jpeg file.jpg [width height [iterations]]
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <glib.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "image.h"
+#include "jpeg.h"
+
+#define BENCH_JPEG_WIDTH 1024
+#define BENCH_JPEG_HEIGHT 768
+#define BENCH_JPEG_ITERATIONS 10
+
+static gdouble bench_decode_loader (const gchar *path, guint iterations);
+static gdouble bench_decode_dct (const gchar *path, guint width,
+                                 guint height, guint iterations);
+static gdouble bench_open (const gchar *path, guint width, guint height,
+                           gboolean fit, guint iterations);
+
+int
+main (int argc, char *argv[])
+{
+    guint width = BENCH_JPEG_WIDTH, height = BENCH_JPEG_HEIGHT;
+    guint iterations = BENCH_JPEG_ITERATIONS;
+    struct jpeg_info info;
+
+    if (argc < 2) {
+        fprintf (stderr, "usage: %s file.jpg [width height [iterations]]\n",
+                 argv[0]);
+        return 1;
+    }
+    if (argc > 3) {
+        width = MAX (1, atoi (argv[2]));
+        height = MAX (1, atoi (argv[3]));
+    }
+    if (argc > 4) {
+        iterations = MAX (1, atoi (argv[4]));
+    }
+
+    if (! jpeg_info_read (argv[1], G_MAXUINT, &info)) {
+        fprintf (stderr, "%s is not a JPEG file\n", argv[1]);
+        return 1;
+    }
+
+    printf ("image:         %dx%d\n", info.width, info.height);
+    printf ("view:          %ux%u\n", width, height);
+    printf ("decode loader: %.2f ms\n",
+            bench_decode_loader (argv[1], iterations));
+    printf ("decode dct:    %.2f ms\n",
+            bench_decode_dct (argv[1], width, height, iterations));
+    printf ("open full:     %.2f ms\n",
+            bench_open (argv[1], width, height, FALSE, iterations));
+    printf ("open fit:      %.2f ms\n",
+            bench_open (argv[1], width, height, TRUE, iterations));
+
+    return 0;
+}
+
+/**
+ * Times decoding at full size with the gdk-pixbuf loader.
+ *
+ * @param path Path to image.
+ * @param iterations Number of decodes to average over.
+ * @return Milliseconds per decode, negative on failure.
+ */
+gdouble
+bench_decode_loader (const gchar *path, guint iterations)
+{
+    GdkPixbuf *pix;
+    gint64 start;
+    guint i;
+
+    start = g_get_monotonic_time ();
+    for (i = 0; i < iterations; i++) {
+        pix = gdk_pixbuf_new_from_file (path, NULL);
+        if (! pix) {
+            return -1.0;
+        }
+        g_object_unref (pix);
+    }
+
+    return (g_get_monotonic_time () - start) / 1000.0 / iterations;
+}
+
+/**
+ * Times decoding with libjpeg at the smallest DCT scale covering width
+ * x height.
+ *
+ * @param path Path to image.
+ * @param width Width to decode for.
+ * @param height Height to decode for.
+ * @param iterations Number of decodes to average over.
+ * @return Milliseconds per decode, negative on failure.
+ */
+gdouble
+bench_decode_dct (const gchar *path, guint width, guint height,
+                  guint iterations)
+{
+#ifdef HAVE_LIBJPEG
+    GdkPixbuf *pix;
+    gint64 start;
+    guint i, denom;
+
+    start = g_get_monotonic_time ();
+    for (i = 0; i < iterations; i++) {
+        pix = jpeg_load_scaled (path, width, height, FALSE, &denom, NULL);
+        if (! pix) {
+            return -1.0;
+        }
+        g_object_unref (pix);
+    }
+
+    return (g_get_monotonic_time () - start) / 1000.0 / iterations;
+#else /* ! HAVE_LIBJPEG */
+    return -1.0;
+#endif /* HAVE_LIBJPEG */
+}
+
+/**
+ * Times opening an image and zooming it to fit width x height.
+ *
+ * @param path Path to image.
+ * @param width Width to fit in.
+ * @param height Height to fit in.
+ * @param fit Open with image_open_fit, else image_open.
+ * @param iterations Number of opens to average over.
+ * @return Milliseconds per open, negative on failure.
+ */
+gdouble
+bench_open (const gchar *path, guint width, guint height, gboolean fit,
+            guint iterations)
+{
+    struct image *im;
+    gint64 start;
+    guint i;
+
+    start = g_get_monotonic_time ();
+    for (i = 0; i < iterations; i++) {
+        if (fit) {
+            im = image_open_fit (path, width, height, NULL, NULL, NULL);
+        } else {
+            im = image_open (path, NULL, NULL, NULL);
+        }
+        if (! im) {
+            return -1.0;
+        }
+        image_zoom_fit (im, width, height);
+        image_close (im);
+    }
+
+    return (g_get_monotonic_time () - start) / 1000.0 / iterations;
+}
@@ -31,6 +31,8 @@
 #endif /* HAVE_CONFIG_H */
 
 #include <glib.h>
+#include <sys/types.h>
+#include <dirent.h>
 #include <string.h>
 #include <stdlib.h>
 
@@ -38,17 +40,23 @@
 #include "dir.h"
 #include "file_multi.h"
 #include "file_queue.h"
+#include "file_stat.h"
 
 static void dir_scan_worker (gpointer data);
 static void dir_scan_recursive (struct dir_scan *ds,
                                 const gchar *path, gint levels);
+static guchar dir_scan_type (const gchar *path, guchar d_type);
+static gint dir_scan_cmp (gconstpointer a, gconstpointer b);
+
+static void dir_scan_push (struct dir_scan *ds, struct file_multi *file);
+static void dir_scan_flush (struct dir_scan *ds);
 
 /**
  * Starts directory scanning thread.
  *
  * @param queue file_queue to push scanned files onto.
  * @param files NULL terminated list of files.
- * @param file_count_inc File count callback.
+ * @param file_count_inc File count callback, or NULL.
  * @param file_count_inc_data File count callback data.
  * @return Pointer to struct dir_scan doing the work.
  */
@@ -70,6 +78,8 @@ dir_scan_start (struct file_queue *queue, gchar **files,
     ds->files = files;
     ds->file_count_inc = file_count_inc;
     ds->file_count_inc_data = file_count_inc_data;
+    ds->stat = file_stat_new ();
+    ds->batch_len = 0;
     ds->stop = FALSE;
 
     /* Start worker thread scanning directories and files */
@@ -95,6 +105,7 @@ dir_scan_stop (struct dir_scan *ds)
     g_thread_join (ds->thread_work);
 
     /* Free resources */
+    file_stat_free (ds->stat);
     g_free (ds);
 }
 
@@ -115,9 +126,11 @@ dir_scan_worker (gpointer data)
                 dir_scan_recursive (ds, ds->files[i], options.levels);
             }
         } else {
-            file_queue_push (ds->queue, file_multi_open (ds->files[i]));
+            dir_scan_push (ds, file_multi_open (ds->queue->arena,
+                                                ds->files[i]));
         }
     }
+    dir_scan_flush (ds);
 
     /* Signal directory scanning done */
     file_queue_done (ds->queue);
@@ -134,10 +147,11 @@ void
 dir_scan_recursive (struct dir_scan *ds, const gchar *path, gint levels)
 {
     gchar *file;
-    guint added = 0;
+    guint i, added = 0;
     const gchar *name;
-    GDir *dir;
-    GList *list = NULL, *it;
+    DIR *dir;
+    struct dirent *ent;
+    GPtrArray *files;
 
     /* Check that path is a directory */
     if (! g_file_test (path, G_FILE_TEST_IS_DIR)) {
@@ -146,42 +160,128 @@ dir_scan_recursive (struct dir_scan *ds, const gchar *path, gint levels)
     }
 
     /* Open directory */
-    dir = g_dir_open (path, 0, NULL);
+    dir = opendir (path);
     if (!dir) {
         g_warning ("unable to open %s as directory", path);
         return;
     }
 
-    /* Scan directory, store files for sorting later on. */
-    while (! ds->stop && (name = g_dir_read_name (dir)) != NULL) {
+    /* Scan directory, store files for sorting later on. The entry type
+       from readdir is used when available to avoid a stat per entry. */
+    files = g_ptr_array_new ();
+    while (! ds->stop && (ent = readdir (dir)) != NULL) {
+        name = ent->d_name;
+        if (name[0] == '.'
+            && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+            continue;
+        }
+
         file = g_build_filename (path, name, NULL);
-        if (g_file_test (file, G_FILE_TEST_IS_DIR)) {
+        switch (dir_scan_type (file, ent->d_type)) {
+        case DT_DIR:
             dir_scan_recursive (ds, file,
                                 (levels == -1) ? levels : levels - 1);
-        } else {
-            list = g_list_insert_sorted (list, (gpointer) file,
-                                         (GCompareFunc) &strcmp);
+            g_free (file);
+            break;
+        case DT_REG:
+            g_ptr_array_add (files, file);
+            break;
+        default:
+            g_free (file);
+            break;
         }
     }
-    g_dir_close (dir);
+    closedir (dir);
 
     /* Scan files. */
-    for (it = g_list_first (list); it != NULL; it = g_list_next (it)) {
-        name = (const char*) it->data;
-        if (g_file_test (name, G_FILE_TEST_IS_REGULAR)) {
-            file_queue_push (ds->queue, file_multi_open (name));
-            added++;
-        }
+    g_ptr_array_sort (files, &dir_scan_cmp);
+    for (i = 0; i < files->len; i++) {
+        dir_scan_push (ds, file_multi_open (ds->queue->arena,
+                                            g_ptr_array_index (files, i)));
+        added++;
     }
 
     /* Add to total number of items (progress bar) */
-    if (added > 0) {
+    if (added > 0 && ds->file_count_inc) {
         ds->file_count_inc (ds->file_count_inc_data, added);
     }
 
     /* Cleanup */
-    for (it = g_list_first (list); it != NULL; it = g_list_next (it)) {
-        free (it->data);
+    for (i = 0; i < files->len; i++) {
+        g_free (g_ptr_array_index (files, i));
+    }
+    g_ptr_array_free (files, TRUE /* free_segment */);
+}
+
+/**
+ * Resolves type of directory entry, falls back to stat if the
+ * filesystem does not report the type.
+ *
+ * @param path Path to entry.
+ * @param d_type Type as reported by readdir.
+ * @return DT_DIR, DT_REG or DT_UNKNOWN.
+ */
+guchar
+dir_scan_type (const gchar *path, guchar d_type)
+{
+    if (d_type == DT_DIR || d_type == DT_REG) {
+        return d_type;
+    }
+
+    if (d_type == DT_UNKNOWN || d_type == DT_LNK) {
+        if (g_file_test (path, G_FILE_TEST_IS_DIR)) {
+            return DT_DIR;
+        } else if (g_file_test (path, G_FILE_TEST_IS_REGULAR)) {
+            return DT_REG;
+        }
+    }
+
+    return DT_UNKNOWN;
+}
+
+/**
+ * Compare function for sorting GPtrArray of paths.
+ */
+gint
+dir_scan_cmp (gconstpointer a, gconstpointer b)
+{
+    return strcmp (*((const gchar**) a), *((const gchar**) b));
+}
+
+/**
+ * Adds file to the pending batch, collects metadata for the batch and
+ * pushes it onto the queue when full.
+ *
+ * @param ds struct dir_scan to add file to.
+ * @param file struct file_multi to add.
+ */
+void
+dir_scan_push (struct dir_scan *ds, struct file_multi *file)
+{
+    ds->batch[ds->batch_len++] = file;
+    if (ds->batch_len == FILE_STAT_BATCH) {
+        dir_scan_flush (ds);
+    }
+}
+
+/**
+ * Collects metadata for pending batch and pushes files onto queue.
+ *
+ * @param ds struct dir_scan to flush.
+ */
+void
+dir_scan_flush (struct dir_scan *ds)
+{
+    guint i;
+
+    if (ds->batch_len == 0) {
+        return;
+    }
+
+    file_stat_batch (ds->stat, ds->batch, ds->batch_len);
+    file_multi_digest_batch (ds->batch, ds->batch_len);
+    for (i = 0; i < ds->batch_len; i++) {
+        file_queue_push (ds->queue, ds->batch[i]);
     }
-    g_list_free (list);
+    ds->batch_len = 0;
 }
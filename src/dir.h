@@ -36,6 +36,7 @@
 #include <glib.h>
 
 #include "file_queue.h"
+#include "file_stat.h"
 
 /**
  * Dir scanner structure, holds thread info etc.
@@ -47,6 +48,10 @@ struct dir_scan {
     void (*file_count_inc)(gpointer, gint); /**< File count callback. */
     gpointer file_count_inc_data; /**< Data for count callback. */
 
+    struct file_stat *stat; /**< Metadata collector for scanned files. */
+    struct file_multi *batch[FILE_STAT_BATCH]; /**< Files pending metadata. */
+    guint batch_len; /**< Number of files in batch. */
+
     GThread *thread_work; /**< Worker thread */
     gboolean stop; /**< Stop flag */
 };
@@ -42,18 +42,27 @@
 #include "util.h"
 
 #define IMAGE_EXT "bmp", "gif", "jpg", "jpeg", "png", "svg", "tiff", "xpm", NULL
+#define FILE_FETCH_READAHEAD 8
 
 static gpointer file_fetch_worker (gpointer data);
 static void file_fetch_file (gpointer data, gpointer user_data);
+static void file_fetch_thumb (gpointer data, gpointer user_data);
+static void file_fetch_free (struct file_fetch *file_fetch, gboolean immediate);
+static void file_fetch_readahead (struct file_fetch *file_fetch);
+static gboolean file_fetch_in_shard (struct file_multi *file);
 static guint file_fetch_enqueue_images (struct file_fetch *file_fetch,
                                         GList *images);
 static void file_fetch_progress (struct file_fetch *file_fetch,
                                  struct file_multi *file, gboolean status);
+static void file_fetch_progress_stat (struct file_fetch *file_fetch,
+                                      struct file_multi *file);
 
 /**
  * Starts fetching of files.
  *
  * @param file_list GList of struct file_multi to fetch.
+ * @param ui UI window to add thumbnails to, NULL to only generate
+ *           thumbnails into the cache using all processors.
  * @return FALSE on error, else TRUE.
  */
 struct file_fetch*
@@ -66,12 +75,18 @@ file_fetch_start (struct file_queue *queue, GList *file_list,
 
     file_fetch->ui = ui;
     file_fetch->queue = queue;
+    file_fetch->readahead = readahead_new (FILE_FETCH_READAHEAD,
+                                           READAHEAD_BUDGET);
 
     /* Create hash table for keeping track of fetched files */
     file_fetch->hash = g_hash_table_new (g_str_hash, g_str_equal);
     g_mutex_init(&file_fetch->hash_mutex);
 
     file_fetch->stop = FALSE;
+    file_fetch->stat_cached = 0;
+    file_fetch->stat_generated = 0;
+    file_fetch->stat_failed = 0;
+    file_fetch->stat_failed_before = 0;
 
     /* Start worker thread which starts thread pool */
     file_fetch->thread =
@@ -93,14 +108,43 @@ file_fetch_stop (struct file_fetch *file_fetch)
     /* No locking, should be safe. */
     file_fetch->stop = TRUE;
 
+    file_fetch_free (file_fetch, TRUE /* immediate */);
+}
+
+/**
+ * Waits for all files in the queue to be processed.
+ *
+ * @param file_fetch struct file_fetch to wait for.
+ */
+void
+file_fetch_wait (struct file_fetch *file_fetch)
+{
+    g_assert (file_fetch);
+
+    file_fetch_free (file_fetch, FALSE /* immediate */);
+}
+
+/**
+ * Joins worker thread and frees resources.
+ *
+ * @param file_fetch struct file_fetch to free.
+ * @param immediate TRUE to drop work not yet started.
+ */
+void
+file_fetch_free (struct file_fetch *file_fetch, gboolean immediate)
+{
     /* Join worker thread */
     g_thread_join (file_fetch->thread);
 
     /* Stop fetching threads */
-    g_thread_pool_free (file_fetch->pool,
-                        TRUE /* immediate */, TRUE /* wait */);
+    g_thread_pool_free (file_fetch->pool, immediate, TRUE /* wait */);
+    if (file_fetch->thumb_pool) {
+        g_thread_pool_free (file_fetch->thumb_pool, immediate,
+                            TRUE /* wait */);
+    }
 
     /* Free resources */
+    readahead_free (file_fetch->readahead);
     g_hash_table_destroy (file_fetch->hash);
     g_mutex_clear (&file_fetch->hash_mutex);
 }
@@ -125,10 +169,24 @@ file_fetch_worker (gpointer data)
                                           3 /* max threads */,
                                           FALSE /* exclusive */, NULL);
 
+    /* Without UI there is nothing to keep responsive, generate
+       thumbnails on all processors. */
+    file_fetch->thumb_pool = NULL;
+    if (! file_fetch->ui) {
+        file_fetch->thumb_pool =
+            g_thread_pool_new ((GFunc) &file_fetch_thumb, data /* user data */,
+                               g_get_num_processors () /* max threads */,
+                               FALSE /* exclusive */, NULL);
+    }
+
     /* Go through list of files and fetch */
     while (! file_fetch->stop
            && (file = file_queue_pop (file_fetch->queue)) != NULL) {
-        if (file_multi_need_fetch (file)) {
+        if (! file_fetch_in_shard (file)) {
+            /* Handled by another process */
+            file_queue_done (file_fetch->queue);
+
+        } else if (file_multi_need_fetch (file)) {
             g_mutex_lock (&file_fetch->hash_mutex);
             if (! g_hash_table_lookup (file_fetch->hash,
                                        file_multi_get_path (file))) {
@@ -137,20 +195,76 @@ file_fetch_worker (gpointer data)
             }
             g_mutex_unlock (&file_fetch->hash_mutex);
 
+        } else if (file_fetch->thumb_pool) {
+            g_thread_pool_push (file_fetch->thumb_pool, (gpointer) file, NULL);
+
         } else {
             /* Do not always use the thread pool as it might block if mixing
                files to fetch and files not needed to be fetched. */
             file_fetch_progress (file_fetch, file, TRUE);
             file_queue_done (file_fetch->queue);
         }
+
+        if (file_fetch->thumb_pool) {
+            file_fetch_readahead (file_fetch);
+        }
     }
 
-    /* Hide progress bar when done */    
-    ui_window_progress_hide (file_fetch->ui, TRUE /* lock */);
+    /* Hide progress bar when done */
+    if (file_fetch->ui) {
+        ui_window_progress_hide (file_fetch->ui, TRUE /* lock */);
+    }
 
     return NULL;  
 }
 
+/**
+ * Checks if file belongs to the shard being processed. Files are
+ * split on the digest of their URI so every process sharing a cache
+ * agrees on the split without coordination.
+ *
+ * @param file File to check.
+ * @return TRUE if file is in shard, else FALSE.
+ */
+gboolean
+file_fetch_in_shard (struct file_multi *file)
+{
+    const md5_byte_t *digest;
+    guint32 value;
+
+    if (options.shard_count <= 1) {
+        return TRUE;
+    }
+
+    digest = file_multi_get_digest (file);
+    value = ((guint32) digest[0] << 24) | ((guint32) digest[1] << 16)
+        | ((guint32) digest[2] << 8) | digest[3];
+
+    return value % options.shard_count == options.shard_index;
+}
+
+/**
+ * Hints upcoming local files in the queue that will be read when
+ * generating thumbnails.
+ *
+ * @param file_fetch struct file_fetch to hint files for.
+ */
+void
+file_fetch_readahead (struct file_fetch *file_fetch)
+{
+    struct file_multi *files[FILE_FETCH_READAHEAD];
+    guint i, count;
+
+    count = file_queue_peek (file_fetch->queue, files,
+                             file_fetch->readahead->count);
+    for (i = 0; i < count; i++) {
+        if (file_fetch_in_shard (files[i])
+            && thumb_need_read (files[i], options.thumb_side)) {
+            readahead_hint (file_fetch->readahead, files[i]);
+        }
+    }
+}
+
 /**
  * Fetch next file in queue.
  *
@@ -169,7 +283,8 @@ file_fetch_file (gpointer data, gpointer user_data)
     struct file_multi *file = (struct file_multi*) data;
 
     /* Check total image count */
-    images_total = ui_window_progress_get_total (file_fetch->ui);
+    images_total = file_fetch->ui
+        ? ui_window_progress_get_total (file_fetch->ui) : 0;
     images_total_before = images_total;
 
     /* Double check fetched file hash to avoid race */
@@ -215,7 +330,7 @@ file_fetch_file (gpointer data, gpointer user_data)
     }
 
     /* Set total number of images */
-    if (images_total != images_total_before) {
+    if (file_fetch->ui && images_total != images_total_before) {
         ui_window_progress_set_total (file_fetch->ui, images_total);
         ui_window_progress_progress (file_fetch->ui,
                                      0 /* count */, TRUE /* lock */);
@@ -224,6 +339,24 @@ file_fetch_file (gpointer data, gpointer user_data)
     file_queue_done (file_fetch->queue);
 }
 
+/**
+ * Generates thumbnail for local file, used without UI.
+ *
+ * @param data Pointer to struct file_multi.
+ * @param user_data Pointer to struct file_fetch.
+ */
+void
+file_fetch_thumb (gpointer data, gpointer user_data)
+{
+    struct file_fetch *file_fetch = (struct file_fetch*) user_data;
+    struct file_multi *file = (struct file_multi*) data;
+
+    if (! file_fetch->stop) {
+        file_fetch_progress (file_fetch, file, TRUE);
+    }
+    file_queue_done (file_fetch->queue);
+}
+
 /**
  * Enqueue images on work queue, filter already fetched images first.
  *
@@ -245,7 +378,8 @@ file_fetch_enqueue_images (struct file_fetch *file_fetch, GList *images)
     for (it = images; it; it = it->next) {
         if (! g_hash_table_lookup (file_fetch->hash, (gchar*) it->data)) {
             file_queue_push (file_fetch->queue,
-                             file_multi_open ((gchar*) it->data));
+                             file_multi_open (file_fetch->queue->arena,
+                                              (gchar*) it->data));
             added++;
         }
         g_free (it->data);
@@ -269,7 +403,10 @@ file_fetch_progress (struct file_fetch *file_fetch,
 {
     static gboolean first = TRUE;
 
-    GdkPixbuf *thumb;
+    if (! file_fetch->ui) {
+        file_fetch_progress_stat (file_fetch, file);
+        return;
+    }
 
     if (first
         && (ui_window_get_mode (file_fetch->ui) != UI_WINDOW_MODE_THUMB)) {
@@ -280,11 +417,40 @@ file_fetch_progress (struct file_fetch *file_fetch,
                              file_fetch->ui->zoom_fit, TRUE /* lock */);
     }
 
-    /* Always add thumbnail version so switching of modes is possible. */
-    thumb =  thumb_get (file, options.thumb_side, TRUE);
-    if (thumb) {
-        ui_window_add_thumbnail (file_fetch->ui, file, thumb);
-    }
+    /* Always add thumbnail version so switching of modes is possible.
+       Thumbnails are generated by the view once they become visible. */
+    ui_window_add_thumbnail (file_fetch->ui, file, NULL);
     ui_window_progress_progress (file_fetch->ui,
                                  1 /* count */, TRUE /* lock */);
 }
+
+/**
+ * Makes sure file has a cached thumbnail, used without UI.
+ *
+ * @param file_fetch File fetch to update statistics for.
+ * @param file Pointer to file_multi progressed.
+ */
+void
+file_fetch_progress_stat (struct file_fetch *file_fetch,
+                          struct file_multi *file)
+{
+    GdkPixbuf *thumb;
+
+    if (thumb_is_cached (file, options.thumb_side)) {
+        g_atomic_int_inc (&file_fetch->stat_cached);
+        return;
+    }
+    if (thumb_is_failed (file)) {
+        g_atomic_int_inc (&file_fetch->stat_failed_before);
+        return;
+    }
+
+    readahead_read (file_fetch->readahead, file);
+    thumb = thumb_get (file, options.thumb_side, TRUE);
+    if (thumb) {
+        g_atomic_int_inc (&file_fetch->stat_generated);
+        g_object_unref (thumb);
+    } else {
+        g_atomic_int_inc (&file_fetch->stat_failed);
+    }
+}
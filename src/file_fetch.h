@@ -36,6 +36,7 @@
 #include <glib.h>
 
 #include "file_queue.h"
+#include "readahead.h"
 #include "ui_window.h"
 
 /**
@@ -47,11 +48,20 @@ struct file_fetch {
 
     GThread *thread; /**< Worker thread pushing files onto thread pool. */
     GThreadPool *pool; /**< Thread pool fetching files. */
+    GThreadPool *thumb_pool; /**< Thread pool generating thumbnails
+                                  without UI, NULL with UI. */
+
+    struct readahead *readahead; /**< Readahead of files to thumbnail. */
 
     GHashTable *hash; /**< Hash table of fetched files. */
     GMutex hash_mutex; /**< Mutex for hash. */
 
     gboolean stop; /**< Stop flag. */
+
+    gint stat_cached; /**< Files with a valid cached thumbnail. */
+    gint stat_generated; /**< Files a thumbnail was generated for. */
+    gint stat_failed; /**< Files a thumbnail could not be generated for. */
+    gint stat_failed_before; /**< Files that failed on an earlier run. */
 };
 
 extern struct file_fetch *file_fetch_start (struct file_queue *queue,
@@ -59,5 +69,6 @@ extern struct file_fetch *file_fetch_start (struct file_queue *queue,
                                             struct ui_window *ui);
 
 extern void file_fetch_stop (struct file_fetch *file_fetch);
+extern void file_fetch_wait (struct file_fetch *file_fetch);
 
 #endif /* _FILE_FETCH_H_ */
@@ -129,8 +129,8 @@ file_fetch_img_build_url (const gchar *site, const gchar *dir, const gchar *src)
         /* Absolute URL on site */
         img_url = g_strjoin(NULL, site, src, NULL);
 
-    } else if ((util_stripos (src, "http://") == src)
-               ||(util_stripos (src, "https://") == src)) {
+    } else if (util_str_has_prefix_casei (src, "http://")
+               || util_str_has_prefix_casei (src, "https://")) {
         /* Absolute URL, just copy */
         img_url = g_strdup (src);
 
@@ -181,7 +181,6 @@ file_fetch_img_get_img (GString *buf)
 
         /* Extract src value */
         len = (end - start) / sizeof (end[0]);
-        img = g_malloc (sizeof(gchar) * len);
         img = g_strndup (start, len);
     }
 
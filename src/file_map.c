@@ -0,0 +1,190 @@
+/*
+ * Copyright (C) 2026 Claes Nästén <pekdon@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * Input layer feeding file contents to a consumer, memory mapped when
+ * possible.
+ *
+ * Regular files on local filesystems are mapped and handed to the
+ * consumer in a single call, avoiding the copy through a read buffer
+ * and the syscall per chunk. Pipes, character devices and files on
+ * network filesystems, where mappings can fault on server side
+ * changes, are streamed in chunks.
+ *
+ * Local files truncated while mapped raise SIGBUS when the consumer
+ * reads past the new end. The consumers are third party decoders that
+ * can not be left safely from a signal handler, so the fault is not
+ * caught. Files changed in the last FILE_MAP_SETTLE seconds, such as
+ * files still being written, are streamed instead. Truncating a
+ * settled file while it is fed still ends the process.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/vfs.h>
+#endif /* __linux__ */
+
+#include "file_map.h"
+
+#define FILE_MAP_NFS_MAGIC 0x6969
+#define FILE_MAP_SMB_MAGIC 0x517b
+#define FILE_MAP_CIFS_MAGIC 0xff534d42
+#define FILE_MAP_SMB2_MAGIC 0xfe534d42
+#define FILE_MAP_FUSE_MAGIC 0x65735546
+
+/* Seconds since last change before a file is mapped */
+#define FILE_MAP_SETTLE 10
+
+static gboolean file_map_can_map (int fd, struct stat *buf);
+static gboolean file_map_stream (int fd, file_map_func func,
+                                 gpointer user_data);
+
+/**
+ * Feeds all of file to func.
+ *
+ * @param path Path to file.
+ * @param func Function consuming file data.
+ * @param user_data User data passed to func.
+ * @return TRUE if all of file was consumed, else FALSE.
+ */
+gboolean
+file_map_feed (const gchar *path, file_map_func func, gpointer user_data)
+{
+    int fd;
+    gpointer map;
+    gboolean status;
+    struct stat buf;
+
+    fd = g_open (path, O_RDONLY, 0);
+    if (fd == -1) {
+        return FALSE;
+    }
+
+    if (file_map_can_map (fd, &buf)) {
+        map = mmap (NULL, buf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            madvise (map, buf.st_size, MADV_SEQUENTIAL);
+            madvise (map, buf.st_size, MADV_WILLNEED);
+
+            status = func (map, buf.st_size, user_data);
+
+            munmap (map, buf.st_size);
+            close (fd);
+
+            return status;
+        }
+    }
+
+    status = file_map_stream (fd, func, user_data);
+    close (fd);
+
+    return status;
+}
+
+/**
+ * Checks if file should be memory mapped.
+ *
+ * @param fd File descriptor of file.
+ * @param buf Set to stat of file.
+ * @return TRUE if file is a non-empty regular file on a local
+ * filesystem that has not changed recently, else FALSE.
+ */
+gboolean
+file_map_can_map (int fd, struct stat *buf)
+{
+#ifdef __linux__
+    struct statfs fs_buf;
+#endif /* __linux__ */
+
+    if (fstat (fd, buf) || ! S_ISREG (buf->st_mode) || buf->st_size == 0
+        || (guint64) buf->st_size > G_MAXSIZE) {
+        return FALSE;
+    }
+
+    /* Recently changed files might still be written or truncated */
+    if (time (NULL) - buf->st_ctime < FILE_MAP_SETTLE) {
+        return FALSE;
+    }
+
+#ifdef __linux__
+    if (fstatfs (fd, &fs_buf)) {
+        return FALSE;
+    }
+
+    switch ((guint32) fs_buf.f_type) {
+    case FILE_MAP_NFS_MAGIC:
+    case FILE_MAP_SMB_MAGIC:
+    case FILE_MAP_CIFS_MAGIC:
+    case FILE_MAP_SMB2_MAGIC:
+    case FILE_MAP_FUSE_MAGIC:
+        return FALSE;
+    default:
+        break;
+    }
+#endif /* __linux__ */
+
+    return TRUE;
+}
+
+/**
+ * Feeds file to func in chunks.
+ *
+ * @param fd File descriptor to read from.
+ * @param func Function consuming file data.
+ * @param user_data User data passed to func.
+ * @return TRUE if all of file was consumed, else FALSE.
+ */
+gboolean
+file_map_stream (int fd, file_map_func func, gpointer user_data)
+{
+    guchar *buf;
+    ssize_t buf_read;
+    gboolean status = TRUE;
+
+    buf = g_malloc (FILE_MAP_CHUNK);
+    while (status && (buf_read = read (fd, buf, FILE_MAP_CHUNK)) != 0) {
+        if (buf_read == -1) {
+            status = errno == EINTR;
+        } else {
+            status = func (buf, buf_read, user_data);
+        }
+    }
+    g_free (buf);
+
+    return status;
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2026 Claes Nästén <pekdon@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * Input layer feeding file contents to a consumer, memory mapped when
+ * possible.
+ */
+
+#ifndef _FILE_MAP_H_
+#define _FILE_MAP_H_
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <glib.h>
+
+#define FILE_MAP_CHUNK 65536
+
+/**
+ * Consumer of file data.
+ *
+ * @param data Data read.
+ * @param len Length of data.
+ * @param user_data User supplied data.
+ * @return TRUE to continue, FALSE to abort.
+ */
+typedef gboolean (*file_map_func) (const guchar *data, gsize len,
+                                   gpointer user_data);
+
+extern gboolean file_map_feed (const gchar *path, file_map_func func,
+                               gpointer user_data);
+
+#endif /* _FILE_MAP_H_ */
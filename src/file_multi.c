@@ -35,16 +35,18 @@
 #include <glib/gstdio.h>
 
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <sys/wait.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <string.h>
-#include <libgen.h>
 
+#include "file_map.h"
 #include "file_multi.h"
 #include "util.h"
 
 #define BUF_STDIN 8192
-#define BUF_SAVE 8192
+#define BUF_PATH 4096
 
 #define WGET_CHECK_INTERVAL 50000
 #define WGET_DIE_SIGNAL 9
@@ -52,14 +54,18 @@
 #define WGET_KILL_WAIT 500000
 #define WGET_SPAWN_FLAGS G_SPAWN_DO_NOT_REAP_CHILD|G_SPAWN_SEARCH_PATH|G_SPAWN_STDOUT_TO_DEV_NULL|G_SPAWN_STDERR_TO_DEV_NULL
 
-static void file_multi_free_strings (struct file_multi *fm);
+static struct file_multi *file_multi_arena_alloc (
+    struct file_multi_arena *arena);
+static const gchar *file_multi_arena_intern_dir (
+    struct file_multi_arena *arena, const gchar *dir, gsize len);
 
 static guint file_multi_get_method (const gchar *path);
-static gchar *file_multi_create_name (const gchar *path, guint method);
-static gchar *file_multi_create_ext (const gchar *path);
-static gchar *file_multi_create_dir (const gchar *path);
-static gchar *file_multi_create_uri (const gchar *path, guint method);
+static void file_multi_set_path (struct file_multi *fm, const gchar *path);
+static void file_multi_set_path_local (struct file_multi *fm,
+                                       const gchar *path);
 
+static gboolean file_multi_save_write (const guchar *data, gsize len,
+                                       gpointer user_data);
 static gchar *file_multi_create_tmpname (void);
 
 static gboolean file_multi_fetch_stdin (struct file_multi *fm,
@@ -72,41 +78,138 @@ static gboolean file_multi_fetch_ftp (struct file_multi *fm,
 static gboolean file_multi_fetch_wget (struct file_multi *fm,
                                        gboolean *stop);
 
+/**
+ * Creates new arena for file_multi records.
+ *
+ * @return Pointer to newly created struct file_multi_arena.
+ */
+struct file_multi_arena*
+file_multi_arena_new (void)
+{
+    struct file_multi_arena *arena;
+
+    arena = g_malloc (sizeof (struct file_multi_arena));
+    arena->blocks = NULL;
+    arena->block_used = 0;
+    arena->strings = g_string_chunk_new (FILE_MULTI_ARENA_STRINGS);
+    arena->dir_last = NULL;
+    arena->dir_last_len = 0;
+    g_mutex_init (&arena->mutex);
+
+    return arena;
+}
+
+/**
+ * Frees arena and all file_multi records allocated in it.
+ *
+ * @param arena Pointer to struct file_multi_arena to free.
+ */
+void
+file_multi_arena_free (struct file_multi_arena *arena)
+{
+    g_assert (arena);
+
+    g_slist_free_full (arena->blocks, g_free);
+    g_string_chunk_free (arena->strings);
+    g_mutex_clear (&arena->mutex);
+
+    g_free (arena);
+}
+
+/**
+ * Allocates record from arena, caller must hold the arena lock.
+ *
+ * @param arena Pointer to struct file_multi_arena to allocate from.
+ * @return Pointer to uninitialized struct file_multi.
+ */
+struct file_multi*
+file_multi_arena_alloc (struct file_multi_arena *arena)
+{
+    if (! arena->blocks || arena->block_used == FILE_MULTI_ARENA_BLOCK) {
+        arena->blocks =
+            g_slist_prepend (arena->blocks,
+                             g_malloc (sizeof (struct file_multi)
+                                       * FILE_MULTI_ARENA_BLOCK));
+        arena->block_used = 0;
+    }
+
+    return ((struct file_multi*) arena->blocks->data) + arena->block_used++;
+}
+
+/**
+ * Interns directory, files from the same directory share a single
+ * copy. Caller must hold the arena lock.
+ *
+ * @param arena Pointer to struct file_multi_arena.
+ * @param dir Directory, not necessarily NUL terminated.
+ * @param len Length of directory.
+ * @return Interned copy of directory.
+ */
+const gchar*
+file_multi_arena_intern_dir (struct file_multi_arena *arena,
+                             const gchar *dir, gsize len)
+{
+    gchar buf[BUF_PATH], *tmp;
+
+    /* Files are mostly scanned one directory at a time */
+    if (arena->dir_last && arena->dir_last_len == len
+        && ! memcmp (arena->dir_last, dir, len)) {
+        return arena->dir_last;
+    }
+
+    if (len < sizeof (buf)) {
+        memcpy (buf, dir, len);
+        buf[len] = '\0';
+        arena->dir_last = g_string_chunk_insert_const (arena->strings, buf);
+    } else {
+        tmp = g_strndup (dir, len);
+        arena->dir_last = g_string_chunk_insert_const (arena->strings, tmp);
+        g_free (tmp);
+    }
+    arena->dir_last_len = len;
+
+    return arena->dir_last;
+}
+
 /**
  * Open and create new struct file_multi.
  *
+ * @param arena Arena to allocate struct file_multi in.
  * @param path Path to file that is to be opened.
  */
 struct file_multi*
-file_multi_open (const gchar *path)
+file_multi_open (struct file_multi_arena *arena, const gchar *path)
 {
     struct file_multi *fm;
 
+    g_assert (arena);
     g_assert (path);
 
+    g_mutex_lock (&arena->mutex);
+
     /* Create new struct file_multi */
-    fm = g_malloc (sizeof (struct file_multi));
-    fm->name = NULL;
-    fm->ext = NULL;
-    fm->uri = NULL;
-    fm->dir = NULL;
-    fm->path = g_strdup (path);
+    fm = file_multi_arena_alloc (arena);
+    fm->arena = arena;
     fm->path_tmp = NULL;
+    fm->size = -1;
     fm->mtime = -1;
-    fm->method = FILE_MULTI_METHOD_PLAIN;
-    fm->need_fetch = FALSE;
+    fm->mtime_nsec = 0;
+    fm->ino = 0;
 
     /* Identify method to fetch file with (if needed) */
-    fm->method = file_multi_get_method (fm->path);
-    if (fm->method != FILE_MULTI_METHOD_PLAIN) {
-        fm->need_fetch = TRUE;
-    }
+    fm->method = file_multi_get_method (path);
+    fm->need_fetch = fm->method != FILE_MULTI_METHOD_PLAIN;
+
+    file_multi_set_path (fm, path);
+
+    g_mutex_unlock (&arena->mutex);
 
     return fm;
 }
 
 /**
- * Close file and clean up temporary file if any.
+ * Close file and clean up temporary file if any, the record itself is
+ * released with the arena.
  *
  * @param fm Pointer to struct file_multi
  */
@@ -115,10 +218,7 @@ file_multi_close (struct file_multi *fm)
 {
     g_assert (fm);
 
-    file_multi_free_strings (fm);
     file_multi_close_tmp (fm);
-
-    g_free (fm);
 }
 
 /**
@@ -139,36 +239,6 @@ file_multi_close_tmp (struct file_multi *fm)
     }
 }
 
-/**
- * Free resources used by parts of the name.
- *
- * @param fm struct file_multi to free resources in.
- */
-void
-file_multi_free_strings (struct file_multi *fm)
-{
-    if (fm->name) {
-        g_free (fm->name);
-        fm->name = NULL;
-    }
-    if (fm->ext) {
-        g_free (fm->ext);
-        fm->ext = NULL;
-    }
-    if (fm->uri) {
-        g_free (fm->uri);
-        fm->uri = NULL;
-    }
-    if (fm->dir) {
-        g_free (fm->dir);
-        fm->dir = NULL;
-    }
-    if (fm->path) {
-        g_free (fm->path);
-        fm->path = NULL;
-    }
-}
-
 /**
  * Save file (or temporary file) to path.
  *
@@ -179,38 +249,52 @@ file_multi_free_strings (struct file_multi *fm)
 gboolean
 file_multi_save (struct file_multi *fm, const gchar *path)
 {
-    gchar buf[BUF_SAVE];
-    size_t buf_read;
-    FILE *in, *out;
+    int out;
+    gboolean status;
 
-    /* Open input file */
-    in = g_fopen (file_multi_get_path (fm), "rb");
-    if (! in) {
+    /* Check input file */
+    if (g_access (file_multi_get_path (fm), R_OK)) {
         g_log (G_LOG_DOMAIN, G_LOG_LEVEL_WARNING,
                "Failed to open %s for reading.", file_multi_get_path (fm));
         return FALSE;
     }
 
     /* Create output file */
-    out = g_fopen (path, "wb");
-    if (! out) {
-        fclose (in);
-
+    out = g_open (path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (out == -1) {
         g_log (G_LOG_DOMAIN, G_LOG_LEVEL_WARNING,
                "Failed to open %s for writing.", path);
         return FALSE;
     }
 
-    /* Copy in to out */
-    while ((buf_read = fread (buf, sizeof (gchar), BUF_SAVE, in)) > 0) {
-        fwrite (buf, sizeof (gchar), buf_read, out);
+    /* Copy in to out, mapped input is written in one go */
+    status = file_map_feed (file_multi_get_path (fm),
+                            &file_multi_save_write, GINT_TO_POINTER (out));
+    if (! status) {
+        g_log (G_LOG_DOMAIN, G_LOG_LEVEL_WARNING,
+               "Failed to copy %s to %s.", file_multi_get_path (fm), path);
     }
 
     /* Close output */
-    fclose (in);
-    fclose (out);
+    if (close (out)) {
+        status = FALSE;
+    }
 
-    return TRUE;
+    return status;
+}
+
+/**
+ * Writes all of data to file descriptor.
+ *
+ * @param data Data to write.
+ * @param len Length of data.
+ * @param user_data File descriptor to write to.
+ * @return TRUE on success, else FALSE.
+ */
+gboolean
+file_multi_save_write (const guchar *data, gsize len, gpointer user_data)
+{
+    return util_write_all (GPOINTER_TO_INT (user_data), data, len);
 }
 
 /**
@@ -235,10 +319,11 @@ file_multi_rename (struct file_multi *fm, const gchar *name)
     if (! rename (file_multi_get_path (fm), path_new)) {
         status = TRUE;
 
-        /* Free uri etc, as it gets changed by rename */
-        file_multi_free_strings (fm);
+        /* Update uri etc, as it gets changed by rename */
+        g_mutex_lock (&fm->arena->mutex);
+        file_multi_set_path (fm, path_new);
+        g_mutex_unlock (&fm->arena->mutex);
 
-        fm->path = path_new;
         if (fm->path_tmp) {
             /* Keep temporary file, update with new path */
             g_free (fm->path_tmp);
@@ -249,6 +334,7 @@ file_multi_rename (struct file_multi *fm, const gchar *name)
         g_log (G_LOG_DOMAIN, G_LOG_LEVEL_WARNING,
                "Failed to rename %s to %s", file_multi_get_name (fm), name);
     }
+    g_free (path_new);
 
     return status;
 }
@@ -264,11 +350,14 @@ file_multi_get_name (struct file_multi *fm)
 {
     g_assert (fm);
 
-    if (! fm->name) {
-        fm->name = file_multi_create_name (fm->path, fm->method);
+    if (fm->method == FILE_MULTI_METHOD_STDIN) {
+        return "stdin";
+    } else if (fm->path[fm->name_off] == '\0') {
+        /* Path ending with /, use complete path */
+        return fm->path;
     }
 
-    return fm->name;
+    return fm->path + fm->name_off;
 }
 
 /**
@@ -282,11 +371,7 @@ file_multi_get_ext (struct file_multi *fm)
 {
     g_assert (fm);
 
-    if (! fm->ext) {
-        fm->ext = file_multi_create_ext (fm->path);
-    }
-
-    return fm->ext ? fm->ext : "";
+    return fm->ext_off ? fm->path + fm->ext_off : "";
 }
 
 /**
@@ -300,10 +385,6 @@ file_multi_get_uri (struct file_multi *fm)
 {
     g_assert (fm);
 
-    if (! fm->uri) {
-        fm->uri = file_multi_create_uri (fm->path, fm->method);
-    }
-
     return fm->uri;
 }
 
@@ -318,10 +399,6 @@ file_multi_get_dir (struct file_multi *fm)
 {
     g_assert (fm);
 
-    if (! fm->dir) {
-        fm->dir = file_multi_create_dir (fm->path);
-    }
-
     return fm->dir;
 }
 
@@ -344,7 +421,66 @@ file_multi_get_path (struct file_multi *fm)
 }
 
 /**
- * Returns the mtime of the file.
+ * Stats the file, filling in size, mtime and inode.
+ *
+ * @param fm Pointer to struct file_multi to stat.
+ * @return TRUE on success, else FALSE.
+ */
+gboolean
+file_multi_stat (struct file_multi *fm)
+{
+    struct stat buf;
+
+    g_assert (fm);
+
+    if (g_stat (file_multi_get_path (fm), &buf)) {
+        return FALSE;
+    }
+
+    file_multi_set_stat (fm, buf.st_size, buf.st_mtim.tv_sec,
+                         buf.st_mtim.tv_nsec, buf.st_ino);
+
+    return TRUE;
+}
+
+/**
+ * Sets file metadata collected elsewhere, used by the batched
+ * metadata collection in file_stat.
+ *
+ * @param fm Pointer to struct file_multi to set metadata on.
+ * @param size Size in bytes of file.
+ * @param mtime Time file was last modified in unix time.
+ * @param mtime_nsec Nanosecond part of mtime.
+ * @param ino Inode of file.
+ */
+void
+file_multi_set_stat (struct file_multi *fm, off_t size,
+                     time_t mtime, glong mtime_nsec, ino_t ino)
+{
+    g_assert (fm);
+
+    fm->size = size;
+    fm->mtime = mtime;
+    fm->mtime_nsec = mtime_nsec;
+    fm->ino = ino;
+}
+
+/**
+ * Returns whether or not metadata has been collected for the file.
+ *
+ * @param fm Pointer to struct file_multi to check.
+ * @return TRUE if size, mtime and inode are set, else FALSE.
+ */
+gboolean
+file_multi_has_stat (struct file_multi *fm)
+{
+    g_assert (fm);
+
+    return fm->size != -1 && fm->mtime != -1;
+}
+
+/**
+ * Returns the size of the file.
  *
  * @param fm Pointer to struct file_multi to get size for.
  * @return Size in bytes of file.
@@ -352,15 +488,11 @@ file_multi_get_path (struct file_multi *fm)
 off_t
 file_multi_get_size (struct file_multi *fm)
 {
-    struct stat buf;
-
     g_assert (fm);
 
     /* size not already set, try get to fetch it */
     if (fm->size == -1) {
-        if (g_stat (file_multi_get_path (fm), &buf)) {
-            fm->size = buf.st_size;
-        }
+        file_multi_stat (fm);
     }
 
     return fm->size;
@@ -369,26 +501,109 @@ file_multi_get_size (struct file_multi *fm)
 /**
  * Returns the mtime of the file.
  *
- * @param fm Pointer to struct file_multi to get size for.
+ * @param fm Pointer to struct file_multi to get mtime for.
  * @return Time file was last modified in unix time.
  */
 time_t
 file_multi_get_mtime (struct file_multi *fm)
 {
-    struct stat buf;
-
     g_assert (fm);
 
     /* mtime not already set, try get to fetch it */
     if (fm->mtime == -1) {
-        if (! g_stat (file_multi_get_path (fm), &buf)) {
-            fm->mtime = buf.st_mtime;
-        }
+        file_multi_stat (fm);
     }
 
     return fm->mtime;
 }
 
+/**
+ * Returns the nanosecond part of the mtime of the file.
+ *
+ * @param fm Pointer to struct file_multi to get mtime for.
+ * @return Nanosecond part of the time file was last modified.
+ */
+glong
+file_multi_get_mtime_nsec (struct file_multi *fm)
+{
+    g_assert (fm);
+
+    if (fm->mtime == -1) {
+        file_multi_stat (fm);
+    }
+
+    return fm->mtime_nsec;
+}
+
+/**
+ * Returns the inode of the file.
+ *
+ * @param fm Pointer to struct file_multi to get inode for.
+ * @return Inode of file, 0 if unknown.
+ */
+ino_t
+file_multi_get_ino (struct file_multi *fm)
+{
+    g_assert (fm);
+
+    if (fm->ino == 0) {
+        file_multi_stat (fm);
+    }
+
+    return fm->ino;
+}
+
+/**
+ * Returns the MD5 digest of the file URI, computed on first use.
+ *
+ * @param fm Pointer to struct file_multi to get digest for.
+ * @return Pointer to MD5_DIGEST_SIZE bytes of digest.
+ */
+const md5_byte_t*
+file_multi_get_digest (struct file_multi *fm)
+{
+    g_assert (fm);
+
+    if (! fm->digest_ok) {
+        md5_single (fm->uri, fm->digest);
+        fm->digest_ok = TRUE;
+    }
+
+    return fm->digest;
+}
+
+/**
+ * Computes URI digests for files in one go using the multi-buffer
+ * MD5, files that already have a digest are skipped.
+ *
+ * @param files Array of files to compute digest for.
+ * @param count Number of files in array.
+ */
+void
+file_multi_digest_batch (struct file_multi **files, guint count)
+{
+    guint i, num = 0;
+    const gchar *uris[MD5_MULTI_LANES];
+    struct file_multi *pending[MD5_MULTI_LANES];
+    md5_byte_t digests[MD5_MULTI_LANES][MD5_DIGEST_SIZE];
+
+    for (i = 0; i <= count; i++) {
+        if (num == MD5_MULTI_LANES || (i == count && num > 0)) {
+            md5_multi (uris, num, digests);
+            while (num > 0) {
+                num--;
+                memcpy (pending[num]->digest, digests[num], MD5_DIGEST_SIZE);
+                pending[num]->digest_ok = TRUE;
+            }
+        }
+
+        if (i < count && ! files[i]->digest_ok) {
+            uris[num] = files[i]->uri;
+            pending[num++] = files[i];
+        }
+    }
+}
+
 /**
  * Fetch file if needed.
  *
@@ -462,10 +677,10 @@ file_multi_get_method (const gchar *path)
 
     if ((path[0] == '-') && (path[1] == '\0')) {
         method = FILE_MULTI_METHOD_STDIN;
-    } else if ((util_stripos (path, "http://") == path)
-               || (util_stripos (path, "https://") == path)) {
+    } else if (util_str_has_prefix_casei (path, "http://")
+               || util_str_has_prefix_casei (path, "https://")) {
         method = FILE_MULTI_METHOD_HTTP;
-    } else if (util_stripos (path, "ftp://")) {
+    } else if (util_str_has_prefix_casei (path, "ftp://")) {
         method = FILE_MULTI_METHOD_FTP;
     } else {
         method = FILE_MULTI_METHOD_PLAIN;
@@ -475,97 +690,120 @@ file_multi_get_method (const gchar *path)
 }
 
 /**
- * Creates basename from path based on type.
+ * Sets path of file, deriving uri, name, extension and directory.
+ * Caller must hold the arena lock.
+ *
+ * Name and extension are offsets into the path and the directory is
+ * interned in the arena.
  *
+ * @param fm Pointer to struct file_multi to set path on.
  * @param path Path to file.
- * @param method Method of file.
- * @return pointer to name, needs freeing.
  */
-gchar*
-file_multi_create_name (const gchar *path, guint method)
+void
+file_multi_set_path (struct file_multi *fm, const gchar *path)
 {
-    gchar *name;
+    gsize dir_len;
+    const gchar *name, *ext;
 
-    if (method == FILE_MULTI_METHOD_STDIN) {
-        name = g_strdup ("stdin");
+    /* Digest is of the uri, recompute when needed */
+    fm->digest_ok = FALSE;
+
+    if (fm->method == FILE_MULTI_METHOD_PLAIN) {
+        file_multi_set_path_local (fm, path);
+    } else if (fm->method == FILE_MULTI_METHOD_STDIN) {
+        /* Stdin can not be URIified */
+        fm->uri = "stdin";
+        fm->path = "-";
     } else {
-        name = g_path_get_basename (path);
+        /* Already an URI for the other methods */
+        fm->uri = g_string_chunk_insert (fm->arena->strings, path);
+        fm->path = fm->uri;
     }
 
-    return name;
-}
+    name = strrchr (fm->path, '/');
+    name = name ? name + 1 : fm->path;
+    ext = strrchr (name, '.');
 
-/**
- * Creates extension from path.
- *
- * @param path Path to file.
- * @return pointer to extension, needs freeing.
- */
-gchar*
-file_multi_create_ext (const gchar *path)
-{
-    gchar *ext;
+    fm->name_off = name - fm->path;
+    fm->ext_off = ext ? ext + 1 - fm->path : 0;
 
-    ext = strrchr (path, '.');
-    if (ext) {
-        ext = g_strdup (ext + 1);
+    /* Directory is everything before the name, without trailing / unless
+       it is the root directory. */
+    dir_len = name - fm->path;
+    if (dir_len > 1) {
+        dir_len--;
+    }
+    if (dir_len > 0) {
+        fm->dir = file_multi_arena_intern_dir (fm->arena, fm->path, dir_len);
+    } else {
+        fm->dir = ".";
     }
-
-    return ext;
 }
 
 /**
- * Creates dir from path.
+ * Sets uri and absolute path of a local file, caller must hold the
+ * arena lock.
  *
- * @param path Path to file.
- * @return Directory of path.
- */
-gchar*
-file_multi_create_dir (const gchar *path)
-{
-    gchar *dir;
-
-    dir = g_strdup (path);
-    dir = dirname (dir);
-
-    return dir;
-}
-
-/**
- * Creates uri from path based on type.
+ * The file:// URI is built with escaping in a single pass into a
+ * buffer and stored in the arena. Unless escaping changed anything,
+ * which is the common case, the path points inside the URI and no
+ * separate copy is stored.
  *
+ * @param fm Pointer to struct file_multi to set uri and path on.
  * @param path Path to file.
- * @param method Method of file.
- * @return pointer to uri, needs freeing.
  */
-gchar*
-file_multi_create_uri (const gchar *path, guint method)
+void
+file_multi_set_path_local (struct file_multi *fm, const gchar *path)
 {
-    gchar *uri;
-
-    if (method == FILE_MULTI_METHOD_STDIN) {
-        /* Stdin can not be URIified */
-        uri = g_strdup ("stdin");
-
-    } else if (method == FILE_MULTI_METHOD_PLAIN) {
-        /* Standard file, make sure ~ is expanded and path is absolute */
-        if (path[0] == '~') {
-            uri = g_strjoin ("/", "file:/", g_get_home_dir (), path + 1, NULL);
-
-        } else if (path[0] == '/') {
-            /* Absolute path, append file:// */
-            uri = g_strjoin (NULL, "file://", path, NULL);
-        } else {
-            /* Relative path, append file:// + current directory */
-            uri = g_strjoin ("/", "file:/", g_get_current_dir (), path, NULL);
-        }
+    gsize len, raw_len, base_len, sep_len, path_len;
+    gchar buf[BUF_PATH], *uri, *end;
+    const gchar *base, *sep;
+
+    /* Make sure ~ is expanded and path is absolute */
+    if (path[0] == '~') {
+        base = g_get_home_dir ();
+        sep = "";
+        path++;
+    } else if (path[0] == '/') {
+        base = "";
+        sep = "";
+    } else {
+        /* Relative path, prepend current directory */
+        base = util_get_current_dir ();
+        sep = "/";
+    }
 
+    base_len = strlen (base);
+    sep_len = strlen (sep);
+    path_len = strlen (path);
+    raw_len = base_len + sep_len + path_len;
+    len = FILE_MULTI_URI_PREFIX_LEN
+        + util_uri_escape_len (base) + sep_len + util_uri_escape_len (path);
+
+    /* Build file:// + base + sep + path, escaped */
+    uri = len < sizeof (buf) ? buf : g_malloc (len + 1);
+    memcpy (uri, FILE_MULTI_URI_PREFIX, FILE_MULTI_URI_PREFIX_LEN);
+    end = util_uri_escape (uri + FILE_MULTI_URI_PREFIX_LEN, base);
+    memcpy (end, sep, sep_len);
+    util_uri_escape (end + sep_len, path);
+
+    fm->uri = g_string_chunk_insert_len (fm->arena->strings, uri, len);
+
+    if (len == FILE_MULTI_URI_PREFIX_LEN + raw_len) {
+        /* Nothing escaped, path is the URI without file:// */
+        fm->path = fm->uri + FILE_MULTI_URI_PREFIX_LEN;
     } else {
-        /* Already an URI for the other methods */
-        uri = g_strdup (path);
+        /* Re-use buffer for the plain path, it is never longer */
+        memcpy (uri, base, base_len);
+        memcpy (uri + base_len, sep, sep_len);
+        memcpy (uri + base_len + sep_len, path, path_len);
+        fm->path = g_string_chunk_insert_len (fm->arena->strings,
+                                              uri, raw_len);
     }
 
-    return uri;
+    if (uri != buf) {
+        g_free (uri);
+    }
 }
 
 /**
@@ -674,7 +912,7 @@ file_multi_fetch_wget (struct file_multi *fm, gboolean *stop)
     argv[0] = "wget";
     argv[1] = "-O";
     argv[2] = fm->path_tmp;
-    argv[3] = fm->path;
+    argv[3] = (gchar*) fm->path;
     argv[4] = NULL;
 
     if (g_spawn_async (NULL /* working_directory */, argv,
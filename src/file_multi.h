@@ -38,30 +38,62 @@
 
 #include <sys/types.h>
 
+#include "md5.h"
+#include "md5_multi.h"
+
 #define FILE_MULTI_METHOD_PLAIN 1
 #define FILE_MULTI_METHOD_STDIN 2
 #define FILE_MULTI_METHOD_HTTP 3
 #define FILE_MULTI_METHOD_FTP 4
 
+#define FILE_MULTI_ARENA_BLOCK 1024
+#define FILE_MULTI_ARENA_STRINGS 65536
+#define FILE_MULTI_URI_PREFIX "file://"
+#define FILE_MULTI_URI_PREFIX_LEN 7
+
+/**
+ * Arena holding file_multi records and their strings, all records of
+ * a scan are released at once when the arena is freed.
+ */
+struct file_multi_arena {
+    GSList *blocks; /**< Blocks of records, newest first. */
+    guint block_used; /**< Number of records used in newest block. */
+    GStringChunk *strings; /**< Path storage and interned directories. */
+    const gchar *dir_last; /**< Last interned directory. */
+    gsize dir_last_len; /**< Length of last interned directory. */
+    GMutex mutex; /**< Lock for arena, files are opened from many threads. */
+};
+
 /**
  * Main structure describing a multifile.
  */
 struct file_multi {
-    gchar *name; /**< (base)name of the file. */
-    gchar *ext; /**< extenstion of the file. */
-    gchar *uri; /**< URI to the file. */
-    gchar *dir; /**< directory of the file. */
-    gchar *path; /**< path to the file. */
+    struct file_multi_arena *arena; /**< Arena record is allocated in. */
+    const gchar *uri; /**< URI to the file. */
+    const gchar *path; /**< path to the file, inside uri for local files. */
+    const gchar *dir; /**< interned directory of the file. */
     gchar *path_tmp; /**< path to the temporary storage of the file if any. */
 
+    guint32 name_off; /**< Offset of (base)name in path. */
+    guint32 ext_off; /**< Offset of extension in path, 0 if none. */
+
     off_t size; /**< Size of file, -1 means not yet checked. */
     time_t mtime; /**< Mtime of file, -1 means not yet checked. */
+    glong mtime_nsec; /**< Nanosecond part of mtime. */
+    ino_t ino; /**< Inode of file, 0 means not yet checked. */
+
+    md5_byte_t digest[MD5_DIGEST_SIZE]; /**< MD5 of uri, see digest_ok. */
 
-    guint method; /**< Method needed for fetching the file. */
-    gboolean need_fetch; /**< flag indicating if fetching is needed. */
+    guint8 method; /**< Method needed for fetching the file. */
+    guint8 need_fetch; /**< flag indicating if fetching is needed. */
+    guint8 digest_ok; /**< flag indicating if digest is computed. */
 };
 
-extern struct file_multi *file_multi_open (const gchar *path);
+extern struct file_multi_arena *file_multi_arena_new (void);
+extern void file_multi_arena_free (struct file_multi_arena *arena);
+
+extern struct file_multi *file_multi_open (struct file_multi_arena *arena,
+                                           const gchar *path);
 extern void file_multi_close (struct file_multi *fm);
 extern void file_multi_close_tmp (struct file_multi *fm);
 extern gboolean file_multi_save (struct file_multi *fm, const gchar *path);
@@ -73,8 +105,18 @@ extern const gchar *file_multi_get_uri (struct file_multi *fm);
 extern const gchar *file_multi_get_dir (struct file_multi *fm);
 extern const gchar *file_multi_get_path (struct file_multi *fm);
 
+extern gboolean file_multi_stat (struct file_multi *fm);
+extern void file_multi_set_stat (struct file_multi *fm, off_t size,
+                                 time_t mtime, glong mtime_nsec, ino_t ino);
+extern gboolean file_multi_has_stat (struct file_multi *fm);
+
 extern off_t file_multi_get_size (struct file_multi *fm);
 extern time_t file_multi_get_mtime (struct file_multi *fm);
+extern glong file_multi_get_mtime_nsec (struct file_multi *fm);
+extern ino_t file_multi_get_ino (struct file_multi *fm);
+
+extern const md5_byte_t *file_multi_get_digest (struct file_multi *fm);
+extern void file_multi_digest_batch (struct file_multi **files, guint count);
 
 extern gboolean file_multi_fetch (struct file_multi *fm, gboolean *stop);
 extern gboolean file_multi_need_fetch (struct file_multi *fm);
@@ -47,9 +47,12 @@ file_queue_new (guint refs)
 
     queue = g_malloc (sizeof (struct file_queue));
 
-    queue->list = NULL;
-    g_mutex_init (&queue->list_mutex);
+    queue->arena = file_multi_arena_new ();
+
+    queue->files = g_ptr_array_new ();
+    g_mutex_init (&queue->files_mutex);
     queue->queue = g_async_queue_new ();
+    queue->popped = 0;
 
     queue->active = refs;
     g_mutex_init (&queue->active_mutex);
@@ -61,7 +64,7 @@ file_queue_new (guint refs)
 }
 
 /**
- * Frees resources used by queue.
+ * Frees resources used by queue, including all files in it.
  *
  * @param queue Pointer to struct file_queue to free.
  */
@@ -70,15 +73,15 @@ file_queue_free (struct file_queue *queue)
 {
     g_assert (queue);
 
-    if (queue->list) {
-        g_list_free (queue->list);
-    }
-    g_mutex_clear (&queue->list_mutex);
+    g_ptr_array_free (queue->files, TRUE /* free_segment */);
+    g_mutex_clear (&queue->files_mutex);
     g_async_queue_unref (queue->queue);
 
     g_mutex_clear (&queue->active_mutex);
     g_cond_clear (&queue->active_cond);
 
+    file_multi_arena_free (queue->arena);
+
     g_free (queue);
 }
 
@@ -93,10 +96,10 @@ file_queue_push (struct file_queue *queue, struct file_multi *file)
 {
     g_assert (queue);
 
-    /* Add file to list of known files */
-    g_mutex_lock (&queue->list_mutex);
-    queue->list = g_list_append (queue->list, file);
-    g_mutex_unlock (&queue->list_mutex);
+    /* Add file to array of known files */
+    g_mutex_lock (&queue->files_mutex);
+    g_ptr_array_add (queue->files, file);
+    g_mutex_unlock (&queue->files_mutex);
 
     /* Add active */
     g_mutex_lock (&queue->active_mutex);
@@ -127,22 +130,53 @@ file_queue_pop (struct file_queue *queue)
         g_cond_wait (&queue->active_cond, &queue->active_mutex);
         file = (struct file_multi*) g_async_queue_try_pop (queue->queue);
     }
+    if (file) {
+        g_atomic_int_inc (&queue->popped);
+    }
     g_mutex_unlock (&queue->active_mutex);
 
     return file;
 }
 
 /**
- * Returns the list of files that has been in the queue.
+ * Gets files next in queue without popping them, files are popped in
+ * the order they were pushed.
+ *
+ * @param queue struct file_queue to peek at.
+ * @param files Array of at least max files to fill in.
+ * @param max Maximum number of files to get.
+ * @return Number of files filled in.
+ */
+guint
+file_queue_peek (struct file_queue *queue, struct file_multi **files,
+                 guint max)
+{
+    guint i, popped;
+
+    g_assert (queue);
+
+    popped = g_atomic_int_get (&queue->popped);
+
+    g_mutex_lock (&queue->files_mutex);
+    for (i = 0; i < max && popped + i < queue->files->len; i++) {
+        files[i] = g_ptr_array_index (queue->files, popped + i);
+    }
+    g_mutex_unlock (&queue->files_mutex);
+
+    return i;
+}
+
+/**
+ * Returns the array of files that has been in the queue.
  *
- * @return GList of struct file_multi that has been in the queue.
+ * @return GPtrArray of struct file_multi that has been in the queue.
  */
-GList*
-file_queue_get_list (struct file_queue *queue)
+GPtrArray*
+file_queue_get_files (struct file_queue *queue)
 {
     g_assert (queue);
 
-    return queue->list;
+    return queue->files;
 }
 
 /**
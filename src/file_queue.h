@@ -41,10 +41,13 @@
  * Structure holding a thread safe file queue.
  */
 struct file_queue {
-    GList *list; /**< List of files */
-    GMutex list_mutex; /**< Lock for list of files */
+    struct file_multi_arena *arena; /**< Arena files are allocated in. */
+
+    GPtrArray *files; /**< Array of files */
+    GMutex files_mutex; /**< Lock for array of files */
 
     GAsyncQueue *queue; /**< Queue containing active files. */
+    gint popped; /**< Number of files popped from the queue. */
 
     gint active; /**< Count of active objects. */
     GMutex active_mutex; /**< Lock for active count. */
@@ -59,7 +62,9 @@ extern void file_queue_free (struct file_queue *queue);
 extern void file_queue_push (struct file_queue *queue, struct file_multi *file);
 extern struct file_multi *file_queue_pop (struct file_queue *queue);
 extern void file_queue_done (struct file_queue *queue);
+extern guint file_queue_peek (struct file_queue *queue,
+                              struct file_multi **files, guint max);
 
-extern GList *file_queue_get_list (struct file_queue *queue);
+extern GPtrArray *file_queue_get_files (struct file_queue *queue);
 
 #endif /* _FILE_QUEUE_H_ */
@@ -0,0 +1,283 @@
+/*
+ * Copyright (C) 2026 Claes Nästén <pekdon@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * Batched collection of file metadata.
+ *
+ * Size, mtime and inode are collected for batches of files up front
+ * so that thumbnail cache validation does not have to stat files one
+ * at a time. statx requests are submitted through io_uring when
+ * available, otherwise the files are stat'ed by a thread pool.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+/* struct statx */
+#define _GNU_SOURCE
+
+#include <glib.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#include "file_multi.h"
+#include "file_stat.h"
+
+#ifdef HAVE_LIBURING
+static gboolean file_stat_batch_uring (struct file_stat *fs,
+                                       struct file_multi **files,
+                                       guint count);
+#endif /* HAVE_LIBURING */
+static void file_stat_batch_pool (struct file_stat *fs,
+                                  struct file_multi **files, guint count);
+static void file_stat_worker (gpointer data, gpointer user_data);
+static gboolean file_stat_needed (struct file_multi *file);
+
+/**
+ * Creates new struct file_stat.
+ *
+ * @return Pointer to newly created struct file_stat.
+ */
+struct file_stat*
+file_stat_new (void)
+{
+    struct file_stat *fs;
+
+    fs = g_malloc (sizeof (struct file_stat));
+
+#ifdef HAVE_LIBURING
+    fs->ring_ok = io_uring_queue_init (FILE_STAT_BATCH, &fs->ring, 0) == 0;
+    if (! fs->ring_ok) {
+        g_log (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG,
+               "io_uring not available, using thread pool for stat");
+    }
+#endif /* HAVE_LIBURING */
+
+    fs->pool = NULL;
+    fs->pending = 0;
+    g_mutex_init (&fs->pending_mutex);
+    g_cond_init (&fs->pending_cond);
+
+    return fs;
+}
+
+/**
+ * Frees resources used by struct file_stat.
+ *
+ * @param fs Pointer to struct file_stat to free.
+ */
+void
+file_stat_free (struct file_stat *fs)
+{
+    g_assert (fs);
+
+#ifdef HAVE_LIBURING
+    if (fs->ring_ok) {
+        io_uring_queue_exit (&fs->ring);
+    }
+#endif /* HAVE_LIBURING */
+
+    if (fs->pool) {
+        g_thread_pool_free (fs->pool, FALSE /* immediate */, TRUE /* wait */);
+    }
+    g_mutex_clear (&fs->pending_mutex);
+    g_cond_clear (&fs->pending_cond);
+
+    g_free (fs);
+}
+
+/**
+ * Collects size, mtime and inode for a batch of files, returns when
+ * all files have been processed. Files needing fetching and files
+ * with metadata already set are skipped.
+ *
+ * @param fs Pointer to struct file_stat.
+ * @param files Array of struct file_multi to collect metadata for.
+ * @param count Number of files in array, at most FILE_STAT_BATCH.
+ */
+void
+file_stat_batch (struct file_stat *fs, struct file_multi **files,
+                 guint count)
+{
+    g_assert (fs);
+    g_assert (count <= FILE_STAT_BATCH);
+
+#ifdef HAVE_LIBURING
+    if (fs->ring_ok && file_stat_batch_uring (fs, files, count)) {
+        return;
+    }
+#endif /* HAVE_LIBURING */
+
+    file_stat_batch_pool (fs, files, count);
+}
+
+#ifdef HAVE_LIBURING
+/**
+ * Collects metadata by submitting one statx request per file to the
+ * io_uring and reaping all completions.
+ *
+ * @param fs Pointer to struct file_stat.
+ * @param files Array of struct file_multi to collect metadata for.
+ * @param count Number of files in array.
+ * @return FALSE if the ring is not usable, else TRUE.
+ */
+gboolean
+file_stat_batch_uring (struct file_stat *fs, struct file_multi **files,
+                       guint count)
+{
+    guint i, submitted = 0, reaped;
+    gint status;
+    gboolean unsupported = FALSE;
+    struct statx stx[FILE_STAT_BATCH];
+    struct io_uring_sqe *sqe;
+    struct io_uring_cqe *cqe;
+
+    for (i = 0; i < count; i++) {
+        if (! file_stat_needed (files[i])) {
+            continue;
+        }
+
+        sqe = io_uring_get_sqe (&fs->ring);
+        io_uring_prep_statx (sqe, AT_FDCWD, file_multi_get_path (files[i]),
+                             0 /* flags */,
+                             STATX_SIZE | STATX_MTIME | STATX_INO, &stx[i]);
+        io_uring_sqe_set_data (sqe, GUINT_TO_POINTER (i));
+        submitted++;
+    }
+
+    if (submitted == 0) {
+        return TRUE;
+    }
+
+    status = io_uring_submit_and_wait (&fs->ring, submitted);
+    if (status < 0) {
+        /* Nothing submitted, drop the queued entries and give up on
+           the ring for the rest of the scan. */
+        g_log (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG,
+               "io_uring submit failed, using thread pool for stat");
+        io_uring_queue_exit (&fs->ring);
+        fs->ring_ok = FALSE;
+        return FALSE;
+    }
+
+    for (reaped = 0; reaped < (guint) status; reaped++) {
+        if (io_uring_wait_cqe (&fs->ring, &cqe)) {
+            break;
+        }
+
+        i = GPOINTER_TO_UINT (io_uring_cqe_get_data (cqe));
+        if (cqe->res == 0) {
+            file_multi_set_stat (files[i], stx[i].stx_size,
+                                 stx[i].stx_mtime.tv_sec,
+                                 stx[i].stx_mtime.tv_nsec, stx[i].stx_ino);
+        } else if (cqe->res == -EINVAL) {
+            /* Kernel without IORING_OP_STATX, stop using the ring.
+               Remaining files are picked up by the thread pool. */
+            unsupported = TRUE;
+        }
+        io_uring_cqe_seen (&fs->ring, cqe);
+    }
+
+    if (unsupported) {
+        g_log (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG,
+               "io_uring statx not supported, using thread pool for stat");
+        io_uring_queue_exit (&fs->ring);
+        fs->ring_ok = FALSE;
+    }
+
+    return fs->ring_ok;
+}
+#endif /* HAVE_LIBURING */
+
+/**
+ * Collects metadata by pushing files onto a thread pool and waiting
+ * for all of them to finish.
+ *
+ * @param fs Pointer to struct file_stat.
+ * @param files Array of struct file_multi to collect metadata for.
+ * @param count Number of files in array.
+ */
+void
+file_stat_batch_pool (struct file_stat *fs, struct file_multi **files,
+                      guint count)
+{
+    guint i;
+
+    if (! fs->pool) {
+        fs->pool = g_thread_pool_new ((GFunc) &file_stat_worker,
+                                      fs /* user data */,
+                                      FILE_STAT_THREADS /* max threads */,
+                                      FALSE /* exclusive */, NULL);
+    }
+
+    g_mutex_lock (&fs->pending_mutex);
+    for (i = 0; i < count; i++) {
+        if (file_stat_needed (files[i])) {
+            fs->pending++;
+            g_thread_pool_push (fs->pool, files[i], NULL);
+        }
+    }
+
+    while (fs->pending > 0) {
+        g_cond_wait (&fs->pending_cond, &fs->pending_mutex);
+    }
+    g_mutex_unlock (&fs->pending_mutex);
+}
+
+/**
+ * Thread pool worker collecting metadata for a single file.
+ *
+ * @param data Pointer to struct file_multi.
+ * @param user_data Pointer to struct file_stat.
+ */
+void
+file_stat_worker (gpointer data, gpointer user_data)
+{
+    struct file_stat *fs = (struct file_stat*) user_data;
+
+    file_multi_stat ((struct file_multi*) data);
+
+    g_mutex_lock (&fs->pending_mutex);
+    if (--fs->pending == 0) {
+        g_cond_signal (&fs->pending_cond);
+    }
+    g_mutex_unlock (&fs->pending_mutex);
+}
+
+/**
+ * Checks if file needs metadata collected, only local files not
+ * already stat'ed are processed.
+ *
+ * @param file Pointer to struct file_multi.
+ * @return TRUE if file should be stat'ed, else FALSE.
+ */
+gboolean
+file_stat_needed (struct file_multi *file)
+{
+    return ! file_multi_need_fetch (file) && ! file_multi_has_stat (file);
+}
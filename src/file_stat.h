@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2026 Claes Nästén <pekdon@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * Batched collection of file metadata.
+ */
+
+#ifndef _FILE_STAT_H_
+#define _FILE_STAT_H_
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <glib.h>
+
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif /* HAVE_LIBURING */
+
+#include "file_multi.h"
+
+#define FILE_STAT_BATCH 64
+#define FILE_STAT_THREADS 4
+
+/**
+ * Metadata collector, statx through io_uring or a thread pool.
+ */
+struct file_stat {
+#ifdef HAVE_LIBURING
+    struct io_uring ring; /**< Ring used for batched statx requests. */
+    gboolean ring_ok; /**< Set to TRUE if ring is usable. */
+#endif /* HAVE_LIBURING */
+
+    GThreadPool *pool; /**< Fallback pool, created on demand. */
+    guint pending; /**< Number of files pending in pool. */
+    GMutex pending_mutex; /**< Lock for pending count. */
+    GCond pending_cond; /**< Cond for pending count. */
+};
+
+extern struct file_stat *file_stat_new (void);
+extern void file_stat_free (struct file_stat *fs);
+
+extern void file_stat_batch (struct file_stat *fs,
+                             struct file_multi **files, guint count);
+
+#endif /* _FILE_STAT_H_ */
@@ -51,6 +51,14 @@ struct _options {
 
     gboolean keep_size; /**< If true, do not zoom image to fit when changing. */
     guint thumb_side; /**< Maximum size of thumbnail in pixels. */
+    gboolean purge_failed; /**< Remove failed thumbnail entries and exit. */
+    gboolean thumb_pack; /**< Use packed thumbnail store. */
+    gboolean thumb_compress; /**< Compress off-screen thumbnails. */
+    gboolean thumb_stats; /**< Print memory used by thumbnails on exit. */
+    gboolean prewarm; /**< Generate thumbnails without UI and exit. */
+    gchar *shard_str; /**< Shard to prewarm, i/N. */
+    guint shard_index; /**< Index of shard to prewarm. */
+    guint shard_count; /**< Number of shards files are split into. */
 
     gboolean recursive; /**< Recursive directory scanning. */
     guint levels; /**< Level of recursion. */
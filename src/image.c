@@ -35,57 +35,367 @@
 #include <glib/gstdio.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
 
+#include "file_map.h"
 #include "image.h"
+#include "jpeg.h"
 #include "orientation.h"
+#include "surface.h"
 
+/**
+ * Loader state while feeding file data.
+ */
+struct image_load {
+    GdkPixbufLoader *loader; /**< Loader to write data to. */
+    GCancellable *cancellable; /**< Stops loading when cancelled. */
+    image_progress_func progress; /**< Progress callback, may be NULL. */
+    gpointer progress_data; /**< User data for progress callback. */
+    gint64 progress_time; /**< Monotonic time of last progress callback. */
+};
+
+static gboolean image_load_full (struct image *im, GCancellable *cancellable,
+                                 image_progress_func progress, gpointer data);
+static gboolean image_load_write (const guchar *data, gsize len,
+                                  gpointer user_data);
+static void callback_area_prepared (GdkPixbufLoader *loader, gpointer data);
+static void callback_area_updated (GdkPixbufLoader *loader, gint x, gint y,
+                                   gint width, gint height, gpointer data);
+static gboolean image_set_orig (struct image *im, GdkPixbuf *pix);
+static void image_init (struct image *im);
 static void image_update (struct image *im);
+static guint image_zoom_max (struct image *im);
+static guint image_scale_min (guint width, guint height);
 
 /**
  * Creates new struct image populated with image from file.
  *
  * @param path Path to image.
+ * @param cancellable Stops loading when cancelled, may be NULL.
+ * @param progress Called with partial image data, may be NULL.
+ * @param data User data for progress.
  * @return struct image on success, else NULL.
  */
 struct image*
-image_open (const gchar *path)
+image_open (const gchar *path, GCancellable *cancellable,
+            image_progress_func progress, gpointer data)
 {
     struct image *im;
-    GError *err = NULL;
 
     im = g_malloc (sizeof (struct image));
+    im->path = g_strdup (path);
+    im->surface_orig = NULL;
 
     /* Load original file */
-    im->pix_orig = gdk_pixbuf_new_from_file (path, &err);
-    if (err || !im->pix_orig) {
+    if (! image_load_full (im, cancellable, progress, data)) {
+        /* Free image resources */
+        g_free (im->path);
+        g_free (im);
+        return NULL;
+    }
+
+    image_init (im);
+
+    return im;
+}
+
+/**
+ * Creates new struct image for displaying fitted to width x height.
+ * JPEG files are decoded downscaled to the smallest DCT scale still
+ * covering the fitted size, see image_need_full for when to load the
+ * full image.
+ *
+ * @param path Path to image.
+ * @param width Available width.
+ * @param height Available height.
+ * @param cancellable Stops loading when cancelled, may be NULL.
+ * @param progress Called with partial image data when not decoded with
+ *        libjpeg, may be NULL.
+ * @param data User data for progress.
+ * @return struct image on success, else NULL.
+ */
+struct image*
+image_open_fit (const gchar *path, guint width, guint height,
+                GCancellable *cancellable,
+                image_progress_func progress, gpointer data)
+{
+#ifdef HAVE_LIBJPEG
+    guint denom, tmp;
+    GdkPixbuf *pix;
+    struct image *im;
+    struct jpeg_info jpeg;
+
+    if (g_cancellable_is_cancelled (cancellable)) {
+        return NULL;
+    }
+
+    if (jpeg_info_read (path, G_MAXUINT, &jpeg)) {
+        /* Fit in the unrotated frame */
+        if (jpeg.orientation >= LEFT_SIDE_TOP) {
+            tmp = width;
+            width = height;
+            height = tmp;
+        }
+
+        if ((guint64) jpeg.width * height > (guint64) jpeg.height * width) {
+            height = MAX (1, (guint64) jpeg.height * width / jpeg.width);
+        } else {
+            width = MAX (1, (guint64) jpeg.width * height / jpeg.height);
+        }
+
+        pix = jpeg_load_scaled (path, width, height, FALSE, &denom,
+                                cancellable);
+        if (g_cancellable_is_cancelled (cancellable)) {
+            if (pix) {
+                g_object_unref (pix);
+            }
+            return NULL;
+        }
+        if (pix) {
+            im = g_malloc (sizeof (struct image));
+            im->path = g_strdup (path);
+            im->scale = denom;
+            im->surface_orig = NULL;
+            im->width_orig = jpeg.width;
+            im->height_orig = jpeg.height;
+
+            /* Update for orientation, swaps the original size */
+            if (jpeg.orientation > 0) {
+                orientation_apply (&pix, &im->width_orig, &im->height_orig,
+                                   jpeg.orientation);
+            }
+
+            if (! image_set_orig (im, pix)) {
+                g_free (im->path);
+                g_free (im);
+                return NULL;
+            }
+
+            image_init (im);
+
+            return im;
+        }
+    }
+#endif /* HAVE_LIBJPEG */
+
+    return image_open (path, cancellable, progress, data);
+}
+
+/**
+ * Loads the original image at full size, replacing surface_orig.
+ *
+ * @param im Pointer to struct image.
+ * @param cancellable Stops loading when cancelled, may be NULL.
+ * @param progress Called with partial image data, may be NULL.
+ * @param data User data for progress.
+ * @return TRUE on success, else FALSE.
+ */
+gboolean
+image_load_full (struct image *im, GCancellable *cancellable,
+                 image_progress_func progress, gpointer data)
+{
+    GdkPixbuf *pix = NULL;
+    GdkPixbufLoader *loader;
+    GError *err = NULL;
+    struct image_load load;
+
+    /* Feed all of file to loader, mapped in one go when possible */
+    loader = gdk_pixbuf_loader_new ();
+    load.loader = loader;
+    load.cancellable = cancellable;
+    load.progress = progress;
+    load.progress_data = data;
+    load.progress_time = 0;
+    if (progress) {
+        g_signal_connect (loader, "area-prepared",
+                          G_CALLBACK (callback_area_prepared), &load);
+        g_signal_connect (loader, "area-updated",
+                          G_CALLBACK (callback_area_updated), &load);
+    }
+    if (file_map_feed (im->path, &image_load_write, &load)
+        && gdk_pixbuf_loader_close (loader, &err)) {
+        pix = gdk_pixbuf_loader_get_pixbuf (loader);
+    } else {
+        gdk_pixbuf_loader_close (loader, NULL);
+    }
+
+    if (err || !pix) {
         /* Print error message */
         if (err) {
             g_fprintf (stderr, "%s\n", err->message);
             g_error_free (err);
         }
-
-        /* Free image resources */
-        g_free (im);
-        return NULL;
+        g_object_unref (loader);
+        return FALSE;
     }
-    
-    im->width_orig = im->width_r_orig = gdk_pixbuf_get_width (im->pix_orig);
-    im->height_orig = im->height_r_orig = gdk_pixbuf_get_height (im->pix_orig);
+
+    g_object_ref (pix);
+    g_object_unref (loader);
+
+    im->width_orig = gdk_pixbuf_get_width (pix);
+    im->height_orig = gdk_pixbuf_get_height (pix);
 
     /* Update for orientation */
-    const gchar *orientation = gdk_pixbuf_get_option(im->pix_orig, "orientation");
+    const gchar *orientation = gdk_pixbuf_get_option(pix, "orientation");
     if (orientation != NULL) {
-        orientation_transform (&im->pix_orig, &im->width_orig, &im->height_orig,
+        orientation_transform (&pix, &im->width_orig, &im->height_orig,
                                orientation);
     }
 
-    /* Setup current representation */
-    im->pix_curr = gdk_pixbuf_copy (im->pix_orig);
-    im->width_curr = im->width_orig;
-    im->height_curr = im->height_orig;
-    im->zoom = 100;
+    im->scale = 1;
+    if (! image_set_orig (im, pix)) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ * Replaces the original image with pix converted to a surface, done
+ * once per load so that drawing needs no conversion. Images larger
+ * than a surface can hold are downscaled, multiplying im->scale.
+ *
+ * @param im Pointer to struct image, scale set for pix.
+ * @param pix Loaded image, reference is taken over.
+ * @return TRUE on success, else FALSE.
+ */
+gboolean
+image_set_orig (struct image *im, GdkPixbuf *pix)
+{
+    cairo_surface_t *surface;
+    GdkPixbuf *scaled;
+    gint width, height;
+    guint factor;
+
+    width = gdk_pixbuf_get_width (pix);
+    height = gdk_pixbuf_get_height (pix);
+    factor = image_scale_min (width, height);
+    if (factor > 1) {
+        scaled = gdk_pixbuf_scale_simple (pix, MAX (1, width / factor),
+                                          MAX (1, height / factor),
+                                          GDK_INTERP_BILINEAR);
+        g_object_unref (pix);
+        if (! scaled) {
+            g_log (G_LOG_DOMAIN, G_LOG_LEVEL_WARNING,
+                   "Failed to downscale %s", im->path);
+            return FALSE;
+        }
+        pix = scaled;
+        im->scale *= factor;
+    }
+
+    surface = surface_from_pixbuf (pix);
+    g_object_unref (pix);
+    if (! surface) {
+        g_log (G_LOG_DOMAIN, G_LOG_LEVEL_WARNING,
+               "Failed to create surface for %s", im->path);
+        return FALSE;
+    }
+
+    if (im->surface_orig) {
+        cairo_surface_destroy (im->surface_orig);
+    }
+    im->surface_orig = surface;
+
+    return TRUE;
+}
+
+/**
+ * Writes file data to loader, in slices so that loading stops soon
+ * after being cancelled.
+ *
+ * @param data File data.
+ * @param len Length of data.
+ * @param user_data Pointer to struct image_load.
+ * @return TRUE on success, else FALSE.
+ */
+gboolean
+image_load_write (const guchar *data, gsize len, gpointer user_data)
+{
+    struct image_load *load = (struct image_load*) user_data;
+    GError *err = NULL;
+    gsize slice;
+
+    while (len > 0) {
+        if (g_cancellable_is_cancelled (load->cancellable)) {
+            return FALSE;
+        }
+
+        slice = MIN (len, IMAGE_LOAD_SLICE);
+        if (! gdk_pixbuf_loader_write (load->loader, data, slice, &err)) {
+            if (err) {
+                g_fprintf (stderr, "%s\n", err->message);
+                g_error_free (err);
+            }
+            return FALSE;
+        }
+        data += slice;
+        len -= slice;
+    }
+
+    return TRUE;
+}
+
+/**
+ * Clears the newly allocated image before handing it to the progress
+ * callback, so that no uninitialized memory is displayed.
+ *
+ * @param loader Loader that allocated the image.
+ * @param data Pointer to struct image_load.
+ */
+void
+callback_area_prepared (GdkPixbufLoader *loader, gpointer data)
+{
+    struct image_load *load = (struct image_load*) data;
+    GdkPixbuf *pix = gdk_pixbuf_loader_get_pixbuf (loader);
+
+    gdk_pixbuf_fill (pix, 0);
+    load->progress (pix, TRUE, load->progress_data);
+    load->progress_time = g_get_monotonic_time ();
+}
+
+/**
+ * Hands partially loaded image to the progress callback, limited to
+ * once every IMAGE_PROGRESS_INTERVAL ms.
+ *
+ * @param loader Loader that updated the image.
+ * @param x Not used.
+ * @param y Not used.
+ * @param width Not used.
+ * @param height Not used.
+ * @param data Pointer to struct image_load.
+ */
+void
+callback_area_updated (GdkPixbufLoader *loader, gint x, gint y,
+                       gint width, gint height, gpointer data)
+{
+    struct image_load *load = (struct image_load*) data;
+    gint64 now = g_get_monotonic_time ();
+
+    if (now - load->progress_time < IMAGE_PROGRESS_INTERVAL * 1000
+        || g_cancellable_is_cancelled (load->cancellable)) {
+        return;
+    }
+
+    load->progress (gdk_pixbuf_loader_get_pixbuf (loader), FALSE,
+                    load->progress_data);
+    load->progress_time = g_get_monotonic_time ();
+}
+
+/**
+ * Sets up current representation of a newly loaded image.
+ *
+ * @param im Pointer to struct image.
+ */
+void
+image_init (struct image *im)
+{
+    im->width_r_orig = im->width_orig;
+    im->height_r_orig = im->height_orig;
+
+    im->surface_curr = cairo_surface_reference (im->surface_orig);
+    im->width_curr = cairo_image_surface_get_width (im->surface_curr);
+    im->height_curr = cairo_image_surface_get_height (im->surface_curr);
+    im->zoom = MIN (100, image_zoom_max (im));
     im->rotation = 0;
-    
-    return im;
 }
 
 /**
@@ -98,24 +408,26 @@ image_close (struct image *im)
 {
     g_assert (im);
 
-    g_object_unref (im->pix_orig);
-    g_object_unref (im->pix_curr);
+    cairo_surface_destroy (im->surface_orig);
+    cairo_surface_destroy (im->surface_curr);
 
+    g_free (im->path);
     g_free (im);
 }
 
 /**
- * Returns the current representation of the image.
+ * Returns the current representation of the image, painted as is
+ * without scaling.
  *
  * @param im Pointer to struct image.
- * @return Pointer to GdkPixbuf.
+ * @return Pointer to cairo_surface_t, owned by the image.
  */
-GdkPixbuf*
-image_get_curr (struct image *im)
+cairo_surface_t*
+image_get_surface (struct image *im)
 {
     g_assert (im);
 
-    return im->pix_curr;
+    return im->surface_curr;
 }
 
 /**
@@ -147,10 +459,11 @@ image_zoom_set (struct image *im, guint zoom)
 {
     g_assert (im);
 
-    /* Sanity check */
+    /* Sanity check, the zoomed image has to fit in a surface */
     if (zoom < 10) {
         zoom = 10;
     }
+    zoom = MIN (zoom, image_zoom_max (im));
 
     if (im->zoom != zoom) {
         im->zoom = zoom;
@@ -255,54 +568,129 @@ image_rotate_set (struct image *im, guint rotation)
 }
 
 /**
- * Updates current image by scaling and rotating.
+ * Copies zoom and rotation from another image of the same file, used
+ * when replacing a downscaled decode with the full size image.
+ *
+ * @param im Pointer to struct image to update.
+ * @param from Pointer to struct image to copy zoom and rotation from.
+ */
+void
+image_set_view (struct image *im, struct image *from)
+{
+    g_assert (im);
+    g_assert (from);
+
+    im->zoom = from->zoom;
+    image_rotate_set (im, from->rotation);
+}
+
+/**
+ * Checks if the image is zoomed in past the downscaled decode, the
+ * image should then be reloaded at full size with image_open.
+ *
+ * @param im Pointer to struct image.
+ * @return TRUE if displayed larger than decoded, else FALSE.
+ */
+gboolean
+image_need_full (struct image *im)
+{
+    g_assert (im);
+
+    return im->scale > image_scale_min (im->width_orig, im->height_orig)
+        && im->zoom * im->scale > 100;
+}
+
+/**
+ * Gets the largest zoom keeping the zoomed image within the size of a
+ * cairo image surface.
+ *
+ * @param im Pointer to struct image.
+ * @return Zoom percentage, at least 1.
+ */
+guint
+image_zoom_max (struct image *im)
+{
+    guint side = MAX (im->width_orig, im->height_orig);
+
+    return MAX (1, (guint64) SURFACE_MAX_SIDE * 100 / MAX (1, side));
+}
+
+/**
+ * Gets the smallest integer downscale fitting an image in a cairo
+ * image surface.
+ *
+ * @param width Width of image.
+ * @param height Height of image.
+ * @return Scale denominator, 1 if the image fits as is.
+ */
+guint
+image_scale_min (guint width, guint height)
+{
+    return (MAX (width, height) + SURFACE_MAX_SIDE - 1) / SURFACE_MAX_SIDE;
+}
+
+/**
+ * Updates current image by scaling and rotating, done in a single pass
+ * with cairo.
  *
  * @param im Pointer to struct image to update.
  */
 void
 image_update (struct image *im)
 {
-    GdkPixbuf *pix_tmp;
-    guint width, height;
+    cairo_t *cr;
+    gint width, height;
+    gboolean swap;
 
     /* Clean old resources */
-    g_object_unref (im->pix_curr);
+    cairo_surface_destroy (im->surface_curr);
 
-    if (!im->rotation && (im->zoom == 100)) {
-        /* No modifications, use original */
-        im->pix_curr = gdk_pixbuf_copy (im->pix_orig);
+    width = cairo_image_surface_get_width (im->surface_orig);
+    height = cairo_image_surface_get_height (im->surface_orig);
 
-    } else {
-        /* Rotate */
-        if (im->rotation != 0) {
-            im->pix_curr = gdk_pixbuf_rotate_simple (im->pix_orig, 
-                                                     im->rotation);
-        } else {
-            im->pix_curr = im->pix_orig;
-        }
+    if (!im->rotation && (im->zoom == 100) && (im->scale == 1)) {
+        /* No modifications, use original */
+        im->surface_curr = cairo_surface_reference (im->surface_orig);
+        im->width_curr = width;
+        im->height_curr = height;
+        return;
+    }
 
-        /* Zoom */
-        if (im->zoom != 100) {
-            width = gdk_pixbuf_get_width (im->pix_curr);
-            height = gdk_pixbuf_get_height (im->pix_curr);
-            im->width_curr =  width * (im->zoom * 0.01);
-            im->height_curr = height * (im->zoom * 0.01);
-
-            /* Scale */
-            pix_tmp = im->pix_curr;
-            im->pix_curr = gdk_pixbuf_scale_simple (im->pix_curr,
-                                                    im->width_curr,
-                                                    im->height_curr,
-                                                    GDK_INTERP_BILINEAR);
-
-            /* Clean resources */
-            if (pix_tmp != im->pix_orig) {
-                g_object_unref (pix_tmp);
-            }
-        }
+    /* Zoom, relative to the original size as surface_orig might be
+       downscaled */
+    im->width_curr = MAX (1, im->width_r_orig * (im->zoom * 0.01));
+    im->height_curr = MAX (1, im->height_r_orig * (im->zoom * 0.01));
+    swap = (im->rotation == 90) || (im->rotation == 270);
+
+    im->surface_curr = cairo_image_surface_create (
+        cairo_image_surface_get_format (im->surface_orig),
+        im->width_curr, im->height_curr);
+    if (cairo_surface_status (im->surface_curr) != CAIRO_STATUS_SUCCESS) {
+        /* Out of memory, show the original instead */
+        g_log (G_LOG_DOMAIN, G_LOG_LEVEL_WARNING,
+               "Failed to create %ux%u surface for %s",
+               im->width_curr, im->height_curr, im->path);
+        cairo_surface_destroy (im->surface_curr);
+        im->surface_curr = cairo_surface_reference (im->surface_orig);
+        im->width_curr = width;
+        im->height_curr = height;
+        return;
     }
 
-    /* Update size */
-    im->width_curr = gdk_pixbuf_get_width (im->pix_curr);
-    im->height_curr = gdk_pixbuf_get_height (im->pix_curr);
+    /* Rotate counter clockwise around the center, as
+       gdk_pixbuf_rotate_simple, and scale to the current size */
+    cr = cairo_create (im->surface_curr);
+    cairo_translate (cr, im->width_curr / 2.0, im->height_curr / 2.0);
+    cairo_rotate (cr, -(gdouble) im->rotation * G_PI / 180.0);
+    cairo_scale (cr,
+                 (gdouble) (swap ? im->height_curr : im->width_curr) / width,
+                 (gdouble) (swap ? im->width_curr : im->height_curr) / height);
+    cairo_translate (cr, -width / 2.0, -height / 2.0);
+
+    cairo_set_source_surface (cr, im->surface_orig, 0.0, 0.0);
+    cairo_pattern_set_filter (cairo_get_source (cr), CAIRO_FILTER_GOOD);
+    cairo_pattern_set_extend (cairo_get_source (cr), CAIRO_EXTEND_PAD);
+    cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+    cairo_paint (cr);
+    cairo_destroy (cr);
 }
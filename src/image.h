@@ -34,12 +34,33 @@
 #include "config.h"
 #endif /* HAVE_CONFIG_H */
 
+#include <cairo.h>
+#include <gio/gio.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#define IMAGE_LOAD_SLICE (256 * 1024)
+#define IMAGE_PROGRESS_INTERVAL 100
+
+/**
+ * Called from the loading thread as image data arrives, at most every
+ * IMAGE_PROGRESS_INTERVAL ms. pix is the partially loaded image before
+ * orientation is applied and is only valid during the call. prepared is
+ * TRUE on the first call, before any data is loaded, pix may then be
+ * filled with a placeholder.
+ */
+typedef void (*image_progress_func) (GdkPixbuf *pix, gboolean prepared,
+                                     gpointer data);
+
 /**
  * Main structure reprsenting modifiable image.
  */
 struct image {
-    GdkPixbuf *pix_orig; /**< Original image */
-    GdkPixbuf *pix_curr; /**< Current image */
+    gchar *path; /**< Path to image. */
+    guint scale; /**< surface_orig is 1/scale of the original size. */
+
+    cairo_surface_t *surface_orig; /**< Original image */
+    cairo_surface_t *surface_curr; /**< Current image, shares original
+                                        when not rotated or zoomed. */
 
     guint width_orig; /**< Original width */
     guint height_orig; /**< Original height */
@@ -52,10 +73,14 @@ struct image {
     guint rotation; /**< Rotation degrees. */
 };
 
-struct image *image_open (const gchar *path);
+struct image *image_open (const gchar *path, GCancellable *cancellable,
+                          image_progress_func progress, gpointer data);
+struct image *image_open_fit (const gchar *path, guint width, guint height,
+                              GCancellable *cancellable,
+                              image_progress_func progress, gpointer data);
 void image_close (struct image *im);
 
-GdkPixbuf *image_get_curr (struct image *im);
+cairo_surface_t *image_get_surface (struct image *im);
 
 guint image_zoom (struct image *im, gint zoom);
 void image_zoom_set (struct image *im, guint zoom);
@@ -64,4 +89,7 @@ void image_zoom_fit (struct image *im, guint width, guint height);
 guint image_rotate (struct image *im, gint rotation);
 void image_rotate_set (struct image *im, guint rotation);
 
+void image_set_view (struct image *im, struct image *from);
+gboolean image_need_full (struct image *im);
+
 #endif /* _IMAGE_H_ */
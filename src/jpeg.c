@@ -0,0 +1,693 @@
+/*
+ * Copyright (C) 2026 Claes Nästén <pekdon@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * JPEG marker parsing, finds image dimensions, EXIF orientation and
+ * embedded preview images without decoding.
+ *
+ * Previews are looked for in two places, the thumbnail in IFD1 of the
+ * EXIF APP1 segment (usually 160x120) and the additional images listed
+ * in the MPF APP2 segment (usually a screen sized preview).
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+/* fseeko with 64-bit offsets */
+#define _FILE_OFFSET_BITS 64
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef HAVE_LIBJPEG
+#include <setjmp.h>
+#include <jpeglib.h>
+#endif /* HAVE_LIBJPEG */
+
+#include "jpeg.h"
+#include "scale.h"
+
+#define JPEG_MARKER_SOI 0xd8
+#define JPEG_MARKER_EOI 0xd9
+#define JPEG_MARKER_SOS 0xda
+#define JPEG_MARKER_APP1 0xe1
+#define JPEG_MARKER_APP2 0xe2
+
+#define JPEG_IS_SOF(m) ((m) >= 0xc0 && (m) <= 0xcf                      \
+                        && (m) != 0xc4 && (m) != 0xc8 && (m) != 0xcc)
+#define JPEG_IS_STANDALONE(m) ((m) == 0x01 || ((m) >= 0xd0 && (m) <= 0xd7))
+
+#define JPEG_TAG_ORIENTATION 0x0112
+#define JPEG_TAG_THUMB_OFFSET 0x0201
+#define JPEG_TAG_THUMB_LENGTH 0x0202
+#define JPEG_TAG_MP_ENTRY 0xb002
+
+#define JPEG_MP_ENTRY_SIZE 16
+
+/* Previews with an aspect more than 1/50 off are letterboxed */
+#define JPEG_ASPECT_TOLERANCE 50
+
+#define JPEG_SCALE_DENOM_MAX 8
+
+#ifdef HAVE_LIBJPEG
+/**
+ * libjpeg error manager returning to jpeg_load_scaled on errors.
+ */
+struct jpeg_load_error {
+    struct jpeg_error_mgr mgr; /**< libjpeg error manager. */
+    jmp_buf jmp; /**< Where to return on errors. */
+};
+#endif /* HAVE_LIBJPEG */
+
+/**
+ * Candidate preview image found while parsing.
+ */
+struct jpeg_candidate {
+    goffset offset; /**< File offset of candidate. */
+    gsize len; /**< Length of candidate. */
+};
+
+/**
+ * State while parsing the segments of the primary image.
+ */
+struct jpeg_parse {
+    struct jpeg_info *info; /**< Info being filled in. */
+    struct jpeg_candidate candidates[JPEG_PREVIEW_CANDIDATES]; /**< Previews */
+    guint num; /**< Number of candidates. */
+};
+
+static gboolean jpeg_walk (FILE *fp, goffset start, struct jpeg_parse *parse,
+                           gint *width, gint *height);
+static void jpeg_parse_exif (const guchar *tiff, gsize len, goffset offset,
+                             struct jpeg_parse *parse);
+static void jpeg_parse_mpf (const guchar *tiff, gsize len, goffset offset,
+                            struct jpeg_parse *parse);
+static void jpeg_parse_add (struct jpeg_parse *parse, goffset offset,
+                            gsize len);
+static gboolean jpeg_preview_ok (struct jpeg_info *info, guint side,
+                                 gint width, gint height);
+
+static gboolean jpeg_tiff_header (const guchar *tiff, gsize len,
+                                  gboolean *be, guint32 *ifd);
+static gboolean jpeg_tiff_find (const guchar *tiff, gsize len, guint32 ifd,
+                                gboolean be, guint16 tag,
+                                guint32 *count, guint32 *value);
+static guint32 jpeg_tiff_next (const guchar *tiff, gsize len, guint32 ifd,
+                               gboolean be);
+#ifdef HAVE_LIBJPEG
+static void jpeg_load_error_exit (j_common_ptr cinfo);
+static void jpeg_load_output_message (j_common_ptr cinfo);
+static void jpeg_load_check_cancelled (struct jpeg_load_error *err,
+                                       GCancellable *cancellable);
+#endif /* HAVE_LIBJPEG */
+
+static guint16 jpeg_get16 (const guchar *buf, gboolean be);
+static guint32 jpeg_get32 (const guchar *buf, gboolean be);
+
+/**
+ * Reads JPEG headers finding the dimensions, orientation and the
+ * smallest embedded preview with a side of at least side pixels.
+ *
+ * @param path Path to file.
+ * @param side Minimum side of preview.
+ * @param info Pointer to struct jpeg_info to fill in.
+ * @return TRUE if file is a JPEG file, else FALSE.
+ */
+gboolean
+jpeg_info_read (const gchar *path, guint side, struct jpeg_info *info)
+{
+    FILE *fp;
+    guint i;
+    gint width, height;
+    struct jpeg_parse parse;
+
+    memset (info, 0, sizeof (struct jpeg_info));
+    parse.info = info;
+    parse.num = 0;
+
+    fp = g_fopen (path, "rb");
+    if (! fp) {
+        return FALSE;
+    }
+
+    if (! jpeg_walk (fp, 0, &parse, &info->width, &info->height)) {
+        fclose (fp);
+        return FALSE;
+    }
+
+    /* Pick the smallest preview that is large enough */
+    for (i = 0; i < parse.num; i++) {
+        if (parse.candidates[i].len > JPEG_PREVIEW_MAX
+            || ! jpeg_walk (fp, parse.candidates[i].offset, NULL,
+                            &width, &height)
+            || ! jpeg_preview_ok (info, side, width, height)) {
+            continue;
+        }
+
+        if (info->preview_len == 0
+            || (width * height
+                < info->preview_width * info->preview_height)) {
+            info->preview_offset = parse.candidates[i].offset;
+            info->preview_len = parse.candidates[i].len;
+            info->preview_width = width;
+            info->preview_height = height;
+        }
+    }
+
+    fclose (fp);
+
+    return TRUE;
+}
+
+/**
+ * Reads preview found by jpeg_info_read into memory.
+ *
+ * @param path Path to file.
+ * @param info Pointer to struct jpeg_info with preview.
+ * @return Preview data of info->preview_len bytes, needs freeing.
+ */
+guchar*
+jpeg_preview_read (const gchar *path, const struct jpeg_info *info)
+{
+    FILE *fp;
+    guchar *data;
+
+    g_assert (info->preview_len > 0);
+
+    fp = g_fopen (path, "rb");
+    if (! fp) {
+        return NULL;
+    }
+
+    data = g_malloc (info->preview_len);
+    if (fseeko (fp, info->preview_offset, SEEK_SET)
+        || fread (data, 1, info->preview_len, fp) != info->preview_len) {
+        g_free (data);
+        data = NULL;
+    }
+
+    fclose (fp);
+
+    return data;
+}
+
+#ifdef HAVE_LIBJPEG
+/**
+ * Decodes JPEG file downscaled in the DCT domain, using the largest
+ * of the 1/2, 1/4 and 1/8 scales that still gives an image of at
+ * least width x height. With exact set the decoded rows are streamed
+ * through a box filter giving an image of width x height without
+ * keeping the decoded image in memory.
+ *
+ * @param path Path to file.
+ * @param width Minimum width of decoded image.
+ * @param height Minimum height of decoded image.
+ * @param exact Resample to width x height.
+ * @param denom Set to the scale denominator used, may be NULL.
+ * @param cancellable Stops decoding between rows when cancelled, may
+ *        be NULL.
+ * @return Pointer to GdkPixbuf or NULL if fails or is cancelled.
+ */
+GdkPixbuf*
+jpeg_load_scaled (const gchar *path, guint width, guint height,
+                  gboolean exact, guint *denom, GCancellable *cancellable)
+{
+    FILE *fp;
+    guchar *row;
+    gint rowstride;
+    GdkPixbuf * volatile pix = NULL;
+    struct scale * volatile sc = NULL;
+    guchar * volatile row_buf = NULL;
+    struct jpeg_decompress_struct cinfo;
+    struct jpeg_load_error err;
+
+    fp = g_fopen (path, "rb");
+    if (! fp) {
+        return NULL;
+    }
+
+    cinfo.err = jpeg_std_error (&err.mgr);
+    err.mgr.error_exit = jpeg_load_error_exit;
+    err.mgr.output_message = jpeg_load_output_message;
+    if (setjmp (err.jmp)) {
+        /* Corrupt or unsupported image, or cancelled */
+        jpeg_destroy_decompress (&cinfo);
+        fclose (fp);
+        if (pix) {
+            g_object_unref (pix);
+        }
+        if (sc) {
+            scale_free (sc);
+        }
+        g_free (row_buf);
+        return NULL;
+    }
+
+    jpeg_create_decompress (&cinfo);
+    jpeg_stdio_src (&cinfo, fp);
+    jpeg_read_header (&cinfo, TRUE);
+
+    /* CMYK can not be converted to RGB by libjpeg */
+    if (cinfo.jpeg_color_space == JCS_CMYK
+        || cinfo.jpeg_color_space == JCS_YCCK) {
+        jpeg_destroy_decompress (&cinfo);
+        fclose (fp);
+        return NULL;
+    }
+
+    cinfo.out_color_space = JCS_RGB;
+    cinfo.scale_num = 1;
+    for (cinfo.scale_denom = JPEG_SCALE_DENOM_MAX; cinfo.scale_denom > 1;
+         cinfo.scale_denom /= 2) {
+        jpeg_calc_output_dimensions (&cinfo);
+        if (cinfo.output_width >= width && cinfo.output_height >= height) {
+            break;
+        }
+    }
+
+    jpeg_start_decompress (&cinfo);
+
+    if (exact) {
+        sc = scale_new (cinfo.output_width, cinfo.output_height,
+                        width, height, 3);
+    } else {
+        pix = gdk_pixbuf_new (GDK_COLORSPACE_RGB, FALSE, 8,
+                              cinfo.output_width, cinfo.output_height);
+    }
+    if (! sc && ! pix) {
+        jpeg_destroy_decompress (&cinfo);
+        fclose (fp);
+        return NULL;
+    }
+
+    if (sc) {
+        /* Decode a row at a time into the scaler */
+        row_buf = g_malloc (cinfo.output_width * 3);
+        row = row_buf;
+        while (cinfo.output_scanline < cinfo.output_height) {
+            jpeg_load_check_cancelled (&err, cancellable);
+            jpeg_read_scanlines (&cinfo, &row, 1);
+            scale_push_row (sc, row);
+        }
+        pix = scale_finish (sc);
+        sc = NULL;
+        g_free (row_buf);
+        row_buf = NULL;
+    } else {
+        /* Decode straight into the pixbuf */
+        row = gdk_pixbuf_get_pixels (pix);
+        rowstride = gdk_pixbuf_get_rowstride (pix);
+        while (cinfo.output_scanline < cinfo.output_height) {
+            jpeg_load_check_cancelled (&err, cancellable);
+            jpeg_read_scanlines (&cinfo, &row, 1);
+            row += rowstride;
+        }
+    }
+
+    if (denom) {
+        *denom = cinfo.scale_denom;
+    }
+
+    jpeg_finish_decompress (&cinfo);
+    jpeg_destroy_decompress (&cinfo);
+    fclose (fp);
+
+    return pix;
+}
+
+/**
+ * libjpeg fatal error handler, returns to jpeg_load_scaled.
+ */
+void
+jpeg_load_error_exit (j_common_ptr cinfo)
+{
+    longjmp (((struct jpeg_load_error*) cinfo->err)->jmp, 1);
+}
+
+/**
+ * Returns to jpeg_load_scaled through the error path if cancelled.
+ *
+ * @param err Error manager of the decode.
+ * @param cancellable Cancellable of the decode, may be NULL.
+ */
+void
+jpeg_load_check_cancelled (struct jpeg_load_error *err,
+                           GCancellable *cancellable)
+{
+    if (g_cancellable_is_cancelled (cancellable)) {
+        longjmp (err->jmp, 1);
+    }
+}
+
+/**
+ * libjpeg message handler, warnings about corrupt data are ignored as
+ * the image is still displayed.
+ */
+void
+jpeg_load_output_message (j_common_ptr cinfo)
+{
+}
+#endif /* HAVE_LIBJPEG */
+
+/**
+ * Walks JPEG markers until the frame header.
+ *
+ * @param fp File to read from.
+ * @param start Offset of SOI marker.
+ * @param parse State for collecting EXIF and MPF data, NULL to only
+ * look for the frame header.
+ * @param width Set to width from frame header.
+ * @param height Set to height from frame header.
+ * @return TRUE if frame header was found, else FALSE.
+ */
+gboolean
+jpeg_walk (FILE *fp, goffset start, struct jpeg_parse *parse,
+           gint *width, gint *height)
+{
+    guint len;
+    goffset pos;
+    guchar marker[4], sof[5], *seg;
+
+    if (fseeko (fp, start, SEEK_SET)
+        || fread (marker, 1, 2, fp) != 2
+        || marker[0] != 0xff || marker[1] != JPEG_MARKER_SOI) {
+        return FALSE;
+    }
+
+    for (;;) {
+        if (fread (marker, 1, 2, fp) != 2 || marker[0] != 0xff) {
+            return FALSE;
+        }
+
+        /* Skip fill bytes */
+        while (marker[1] == 0xff) {
+            if (fread (marker + 1, 1, 1, fp) != 1) {
+                return FALSE;
+            }
+        }
+
+        if (marker[1] == JPEG_MARKER_EOI || marker[1] == JPEG_MARKER_SOS) {
+            return FALSE;
+        } else if (JPEG_IS_STANDALONE (marker[1])) {
+            continue;
+        }
+
+        if (fread (marker + 2, 1, 2, fp) != 2) {
+            return FALSE;
+        }
+        len = (marker[2] << 8) | marker[3];
+        if (len < 2) {
+            return FALSE;
+        }
+        len -= 2;
+        pos = ftello (fp);
+
+        if (JPEG_IS_SOF (marker[1])) {
+            /* precision, height and width */
+            if (len < sizeof (sof) || fread (sof, 1, sizeof (sof), fp)
+                != sizeof (sof)) {
+                return FALSE;
+            }
+            *height = (sof[1] << 8) | sof[2];
+            *width = (sof[3] << 8) | sof[4];
+            return *width > 0 && *height > 0;
+
+        } else if (parse && (marker[1] == JPEG_MARKER_APP1
+                             || marker[1] == JPEG_MARKER_APP2)) {
+            seg = g_malloc (len);
+            if (fread (seg, 1, len, fp) != len) {
+                g_free (seg);
+                return FALSE;
+            }
+
+            if (marker[1] == JPEG_MARKER_APP1 && len > 6
+                && ! memcmp (seg, "Exif\0\0", 6)) {
+                jpeg_parse_exif (seg + 6, len - 6, pos + 6, parse);
+            } else if (marker[1] == JPEG_MARKER_APP2 && len > 4
+                       && ! memcmp (seg, "MPF\0", 4)) {
+                jpeg_parse_mpf (seg + 4, len - 4, pos + 4, parse);
+            }
+            g_free (seg);
+        }
+
+        if (fseeko (fp, pos + len, SEEK_SET)) {
+            return FALSE;
+        }
+    }
+}
+
+/**
+ * Parses EXIF data for orientation and IFD1 thumbnail.
+ *
+ * @param tiff Start of TIFF header.
+ * @param len Length of data.
+ * @param offset File offset of TIFF header.
+ * @param parse Parse state.
+ */
+void
+jpeg_parse_exif (const guchar *tiff, gsize len, goffset offset,
+                 struct jpeg_parse *parse)
+{
+    gboolean be;
+    guint32 ifd, count, value, thumb_offset, thumb_len;
+
+    if (! jpeg_tiff_header (tiff, len, &be, &ifd)) {
+        return;
+    }
+
+    if (jpeg_tiff_find (tiff, len, ifd, be, JPEG_TAG_ORIENTATION,
+                        &count, &value)) {
+        parse->info->orientation = value;
+    }
+
+    ifd = jpeg_tiff_next (tiff, len, ifd, be);
+    if (ifd
+        && jpeg_tiff_find (tiff, len, ifd, be, JPEG_TAG_THUMB_OFFSET,
+                           &count, &thumb_offset)
+        && jpeg_tiff_find (tiff, len, ifd, be, JPEG_TAG_THUMB_LENGTH,
+                           &count, &thumb_len)) {
+        jpeg_parse_add (parse, offset + thumb_offset, thumb_len);
+    }
+}
+
+/**
+ * Parses MPF data for additional images, the first entry is the
+ * primary image and skipped.
+ *
+ * @param tiff Start of MPF TIFF header.
+ * @param len Length of data.
+ * @param offset File offset of TIFF header, image offsets are relative
+ * to this.
+ * @param parse Parse state.
+ */
+void
+jpeg_parse_mpf (const guchar *tiff, gsize len, goffset offset,
+                struct jpeg_parse *parse)
+{
+    gboolean be;
+    guint32 i, ifd, count, value, entry_len, entry_offset;
+    const guchar *entry;
+
+    if (! jpeg_tiff_header (tiff, len, &be, &ifd)
+        || ! jpeg_tiff_find (tiff, len, ifd, be, JPEG_TAG_MP_ENTRY,
+                             &count, &value)
+        || value > len || count > len - value) {
+        return;
+    }
+
+    for (i = 1; i < count / JPEG_MP_ENTRY_SIZE; i++) {
+        entry = tiff + value + i * JPEG_MP_ENTRY_SIZE;
+        entry_len = jpeg_get32 (entry + 4, be);
+        entry_offset = jpeg_get32 (entry + 8, be);
+        if (entry_offset > 0) {
+            jpeg_parse_add (parse, offset + entry_offset, entry_len);
+        }
+    }
+}
+
+/**
+ * Adds candidate preview.
+ */
+void
+jpeg_parse_add (struct jpeg_parse *parse, goffset offset, gsize len)
+{
+    if (parse->num < JPEG_PREVIEW_CANDIDATES && len > 0) {
+        parse->candidates[parse->num].offset = offset;
+        parse->candidates[parse->num].len = len;
+        parse->num++;
+    }
+}
+
+/**
+ * Checks if preview can be used instead of the primary image, it must
+ * be large enough, smaller than the primary image and have the same
+ * aspect (no letterboxing).
+ *
+ * @param info Info with primary image dimensions.
+ * @param side Minimum side of preview.
+ * @param width Width of preview.
+ * @param height Height of preview.
+ * @return TRUE if preview can be used, else FALSE.
+ */
+gboolean
+jpeg_preview_ok (struct jpeg_info *info, guint side, gint width, gint height)
+{
+    gint64 diff;
+
+    if ((guint) MAX (width, height) < side
+        || MAX (width, height) >= MAX (info->width, info->height)) {
+        return FALSE;
+    }
+
+    diff = (gint64) width * info->height - (gint64) height * info->width;
+    if (diff < 0) {
+        diff = -diff;
+    }
+
+    return diff * JPEG_ASPECT_TOLERANCE <= (gint64) height * info->width;
+}
+
+/**
+ * Reads TIFF header.
+ *
+ * @param tiff Start of TIFF header.
+ * @param len Length of data.
+ * @param be Set to TRUE if data is big endian.
+ * @param ifd Set to offset of first IFD.
+ * @return TRUE if header is valid, else FALSE.
+ */
+gboolean
+jpeg_tiff_header (const guchar *tiff, gsize len, gboolean *be, guint32 *ifd)
+{
+    if (len < 8) {
+        return FALSE;
+    }
+
+    if (! memcmp (tiff, "MM\0*", 4)) {
+        *be = TRUE;
+    } else if (! memcmp (tiff, "II*\0", 4)) {
+        *be = FALSE;
+    } else {
+        return FALSE;
+    }
+
+    *ifd = jpeg_get32 (tiff + 4, *be);
+
+    return TRUE;
+}
+
+/**
+ * Finds tag in IFD. Values of type SHORT and LONG are returned as
+ * value, for other types value is the offset of the data.
+ *
+ * @param tiff Start of TIFF header.
+ * @param len Length of data.
+ * @param ifd Offset of IFD.
+ * @param be TRUE if data is big endian.
+ * @param tag Tag to find.
+ * @param count Set to count of tag.
+ * @param value Set to value of tag.
+ * @return TRUE if tag was found, else FALSE.
+ */
+gboolean
+jpeg_tiff_find (const guchar *tiff, gsize len, guint32 ifd, gboolean be,
+                guint16 tag, guint32 *count, guint32 *value)
+{
+    guint i, entries;
+    const guchar *entry;
+
+    if (ifd > len - 2) {
+        return FALSE;
+    }
+
+    entries = jpeg_get16 (tiff + ifd, be);
+    if (entries > (len - ifd - 2) / 12) {
+        return FALSE;
+    }
+
+    for (i = 0; i < entries; i++) {
+        entry = tiff + ifd + 2 + i * 12;
+        if (jpeg_get16 (entry, be) == tag) {
+            *count = jpeg_get32 (entry + 4, be);
+            if (jpeg_get16 (entry + 2, be) == 3) {
+                *value = jpeg_get16 (entry + 8, be);
+            } else {
+                *value = jpeg_get32 (entry + 8, be);
+            }
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ * Returns offset of the IFD following ifd, 0 if none.
+ */
+guint32
+jpeg_tiff_next (const guchar *tiff, gsize len, guint32 ifd, gboolean be)
+{
+    guint32 entries;
+
+    if (ifd > len - 6) {
+        return 0;
+    }
+
+    entries = jpeg_get16 (tiff + ifd, be);
+    if (entries > (len - ifd - 6) / 12) {
+        return 0;
+    }
+
+    return jpeg_get32 (tiff + ifd + 2 + entries * 12, be);
+}
+
+/**
+ * Reads 16-bit integer in given byte order.
+ */
+guint16
+jpeg_get16 (const guchar *buf, gboolean be)
+{
+    if (be) {
+        return (buf[0] << 8) | buf[1];
+    }
+    return buf[0] | (buf[1] << 8);
+}
+
+/**
+ * Reads 32-bit integer in given byte order.
+ */
+guint32
+jpeg_get32 (const guchar *buf, gboolean be)
+{
+    if (be) {
+        return ((guint32) buf[0] << 24) | ((guint32) buf[1] << 16)
+            | ((guint32) buf[2] << 8) | (guint32) buf[3];
+    }
+    return (guint32) buf[0] | ((guint32) buf[1] << 8)
+        | ((guint32) buf[2] << 16) | ((guint32) buf[3] << 24);
+}
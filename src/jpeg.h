@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2026 Claes Nästén <pekdon@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * JPEG marker parsing, finds image dimensions, EXIF orientation and
+ * embedded preview images without decoding.
+ */
+
+#ifndef _JPEG_H_
+#define _JPEG_H_
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <glib.h>
+#include <gio/gio.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#define JPEG_PREVIEW_MAX (4 * 1024 * 1024)
+#define JPEG_PREVIEW_CANDIDATES 4
+
+/**
+ * Information about a JPEG file and its best embedded preview.
+ */
+struct jpeg_info {
+    gint width; /**< Width of primary image. */
+    gint height; /**< Height of primary image. */
+    gint orientation; /**< EXIF orientation, 0 if not set. */
+
+    goffset preview_offset; /**< File offset of preview. */
+    gsize preview_len; /**< Length of preview, 0 if there is none. */
+    gint preview_width; /**< Width of preview. */
+    gint preview_height; /**< Height of preview. */
+};
+
+extern gboolean jpeg_info_read (const gchar *path, guint side,
+                                struct jpeg_info *info);
+extern guchar *jpeg_preview_read (const gchar *path,
+                                  const struct jpeg_info *info);
+
+#ifdef HAVE_LIBJPEG
+extern GdkPixbuf *jpeg_load_scaled (const gchar *path,
+                                    guint width, guint height,
+                                    gboolean exact, guint *denom,
+                                    GCancellable *cancellable);
+#endif /* HAVE_LIBJPEG */
+
+#endif /* _JPEG_H_ */
@@ -32,6 +32,7 @@
 
 #include <glib.h>
 #include <glib/gstdio.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <locale.h>
 
@@ -41,6 +42,7 @@
 #include "file_fetch.h"
 #include "file_multi.h"
 #include "file_queue.h"
+#include "thumb.h"
 #include "ui_window.h"
 
 /* Initialize options */
@@ -54,6 +56,14 @@ struct _options options = {
     740 /* win_height */,
     FALSE /* keep_size */,
     128 /* thumb_side */,
+    FALSE /* purge_failed */,
+    FALSE /* thumb_pack */,
+    FALSE /* thumb_compress */,
+    FALSE /* thumb_stats */,
+    FALSE /* prewarm */,
+    NULL /* shard_str */,
+    0 /* shard_index */,
+    1 /* shard_count */,
     FALSE /* recursive */,
     -1 /* levels */,
     NULL /* files */
@@ -63,10 +73,16 @@ struct _options options = {
  * Command line parsing structure.
  */
 static GOptionEntry cmdopt[] = {
+    {"compress-thumbs", 0, 0, G_OPTION_ARG_NONE, &options.thumb_compress, "Compress off-screen thumbnails"},
     {"height", 'H', 0, G_OPTION_ARG_INT, &options.win_height, "Window height"},
     {"levels", 'l', 0, G_OPTION_ARG_INT, &options.levels, "Levels of recursion"},
     {"mode", 'm', 0, G_OPTION_ARG_STRING, &options.mode_str, "Image display mode"},
     {"nodecor", 'n', 0, G_OPTION_ARG_NONE, &options.win_nodecor, "No decor for window"},
+    {"pack", 0, 0, G_OPTION_ARG_NONE, &options.thumb_pack, "Use packed thumbnail store"},
+    {"prewarm", 0, 0, G_OPTION_ARG_NONE, &options.prewarm, "Generate thumbnails without UI and exit, directories need -r"},
+    {"purge-failed", 0, 0, G_OPTION_ARG_NONE, &options.purge_failed, "Remove failed thumbnail entries and exit"},
+    {"stats", 0, 0, G_OPTION_ARG_NONE, &options.thumb_stats, "Print memory used by thumbnails on exit"},
+    {"shard", 0, 0, G_OPTION_ARG_STRING, &options.shard_str, "Prewarm only shard i/N of the files"},
     {"recursive", 'r', 0, G_OPTION_ARG_NONE, &options.recursive, "Recursive directory scanning"},
     {"keep", 'k', 0, G_OPTION_ARG_NONE, &options.keep_size, "Keep image size"},
     {"thumbside", 't', 0, G_OPTION_ARG_INT, &options.thumb_side, "Thumbnail size in pixels"},
@@ -78,6 +94,8 @@ static GOptionEntry cmdopt[] = {
 
 static void main_print_usage (void);
 static gboolean main_timeout_quit (gpointer data);
+static int main_prewarm (void);
+static void main_print_thumb_stats (struct thumb_atlas *atlas);
 
 /**
  * Parse mode _str options into their corresponding int value.
@@ -99,6 +117,19 @@ parse_str_options (void)
         }
     }
 
+    /* Get shard to prewarm, implies prewarm */
+    if (options.shard_str) {
+        if (sscanf (options.shard_str, "%u/%u",
+                    &options.shard_index, &options.shard_count) != 2
+            || options.shard_count == 0
+            || options.shard_index >= options.shard_count) {
+            g_warning ("invalid shard %s, expected i/N with i < N",
+                       options.shard_str);
+            return 1;
+        }
+        options.prewarm = TRUE;
+    }
+
     return 0;
 }
 
@@ -125,6 +156,98 @@ main_timeout_quit(gpointer data)
     return FALSE;
 }
 
+/**
+ * Generates thumbnails for all files without UI. Files with a valid
+ * cached thumbnail, or that failed on an earlier run, are skipped, an
+ * interrupted run is resumed by running it again. Directories are
+ * scanned as when displaying, only with -r and down to -l levels.
+ *
+ * @return Exit status, 1 if thumbnails failed in this run.
+ */
+int
+main_prewarm (void)
+{
+    GTimer *timer;
+    GPtrArray *files;
+    guint i, cached, generated, failed, failed_before, total;
+    gdouble elapsed;
+
+    struct dir_scan *dir_scan;
+    struct file_fetch *file_fetch;
+    struct file_queue *file_queue;
+
+    /* Every generated thumbnail has to reach the cache */
+    thumb_init ((options.thumb_pack ? THUMB_FLAG_PACK : 0)
+                | THUMB_FLAG_WAIT_WRITES);
+
+    timer = g_timer_new ();
+
+    if (! options.recursive) {
+        for (i = 0; options.files[i] != NULL; i++) {
+            if (g_file_test (options.files[i], G_FILE_TEST_IS_DIR)) {
+                g_warning ("skipping directory %s, use -r to prewarm it",
+                           options.files[i]);
+            }
+        }
+    }
+
+    file_queue = file_queue_new (1);
+    dir_scan = dir_scan_start (file_queue, options.files, NULL, NULL);
+    file_fetch = file_fetch_start (file_queue, options.file_list, NULL);
+
+    file_fetch_wait (file_fetch);
+    dir_scan_stop (dir_scan);
+
+    /* Include pending cache writes in the elapsed time */
+    thumb_shutdown ();
+    elapsed = g_timer_elapsed (timer, NULL);
+    g_timer_destroy (timer);
+
+    cached = file_fetch->stat_cached;
+    generated = file_fetch->stat_generated;
+    failed = file_fetch->stat_failed;
+    failed_before = file_fetch->stat_failed_before;
+    total = cached + generated + failed + failed_before;
+
+    g_fprintf (stdout, "prewarm: %u files in %.1f s, %.1f files/s\n",
+               total, elapsed, elapsed > 0 ? total / elapsed : 0.0);
+    g_fprintf (stdout,
+               "prewarm: %u cached (%.1f%%), %u generated, %u failed, "
+               "%u failed before\n",
+               cached, total ? 100.0 * cached / total : 0.0,
+               generated, failed, failed_before);
+
+    files = file_queue_get_files (file_queue);
+    for (i = 0; i < files->len; i++) {
+        file_multi_close ((struct file_multi*) g_ptr_array_index (files, i));
+    }
+    file_queue_free (file_queue);
+
+    return failed ? 1 : 0;
+}
+
+/**
+ * Prints memory used by the thumbnails stored when exiting, compared
+ * to keeping them as RGBA pixbufs.
+ *
+ * @param atlas Atlas of the thumbnail view.
+ */
+void
+main_print_thumb_stats (struct thumb_atlas *atlas)
+{
+    g_fprintf (stdout,
+               "thumbnails: %u stored, %u compressed\n", atlas->stat_entries,
+               atlas->stat_compressed);
+    g_fprintf (stdout,
+               "thumbnails: %" G_GUINT64_FORMAT " KiB stored (%.1f%%), %"
+               G_GUINT64_FORMAT " KiB in pages, %" G_GUINT64_FORMAT
+               " KiB as RGBA pixbufs\n",
+               atlas->stat_packed / 1024,
+               atlas->stat_rgba
+               ? 100.0 * atlas->stat_packed / atlas->stat_rgba : 0.0,
+               atlas->stat_pages / 1024, atlas->stat_rgba / 1024);
+}
+
 /**
  * Main routine
  */
@@ -132,8 +255,9 @@ int
 main (int argc, char *argv[])
 {
     gint file_count = 0;
+    guint i;
 
-    GList *it;
+    GPtrArray *files;
     GOptionContext *context;
 
     struct ui_window *ui;
@@ -146,7 +270,8 @@ main (int argc, char *argv[])
     /* Parse command line options */
     context = g_option_context_new ("");
     g_option_context_add_main_entries (context, cmdopt, NULL);
-    g_option_context_add_group (context, gtk_get_option_group (TRUE));
+    /* Display is opened by ui_init, not needed when prewarming */
+    g_option_context_add_group (context, gtk_get_option_group (FALSE));
     g_option_context_parse (context, &argc, &argv, NULL);
     g_option_context_free (context);
 
@@ -155,6 +280,12 @@ main (int argc, char *argv[])
         exit (1);
     }
 
+    if (options.purge_failed) {
+        g_fprintf (stdout, "removed %u failed thumbnail entries\n",
+                   thumb_purge_failed ());
+        exit (0);
+    }
+
     /* Make sure there is something to do (need input files) */
     if (options.files) {
         /* Count entries in order to determine mode */
@@ -165,8 +296,15 @@ main (int argc, char *argv[])
         exit (1);
     }
 
+    if (options.prewarm) {
+        exit (main_prewarm ());
+    }
+
     ui_init (&argc, &argv);
 
+    /* Start reading thumbnail cache index while the UI is set up */
+    thumb_init (options.thumb_pack ? THUMB_FLAG_PACK : 0);
+
     /* Create UI window */
     ui = ui_window_new ();
     ui->zoom_fit = !options.keep_size;
@@ -200,13 +338,20 @@ main (int argc, char *argv[])
     dir_scan_stop (dir_scan);
     file_fetch_stop (file_fetch);
 
+    if (options.thumb_stats) {
+        main_print_thumb_stats (ui->thumb_grid->atlas);
+    }
+
     /* Free UI after stopping of scanning as it uses UI */
     ui_window_free (ui);
 
-    for (it = file_queue_get_list (file_queue); it; it = g_list_next (it)) {
-        file_multi_close ((struct file_multi*) it->data);
+    files = file_queue_get_files (file_queue);
+    for (i = 0; i < files->len; i++) {
+        file_multi_close ((struct file_multi*) g_ptr_array_index (files, i));
     }
     file_queue_free (file_queue);
 
+    thumb_shutdown ();
+
     return 0;
 }
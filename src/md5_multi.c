@@ -0,0 +1,313 @@
+/*
+ * Copyright (C) 2026 Claes Nästén <pekdon@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * Multi-buffer MD5, hashes several short messages at once using one
+ * SIMD lane per message.
+ *
+ * Messages are padded and transposed so that word i of block b for
+ * all lanes is stored next to each other, the rounds then run on
+ * vectors of MD5_MULTI_LANES words. On x86-64 the transform is built
+ * both for AVX2 (all 8 lanes in one register) and baseline SSE2 (two
+ * registers of 4 lanes), the best one is picked at load time. Messages
+ * longer than MD5_MULTI_MAX_BLOCKS blocks use the scalar md5.c.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <glib.h>
+#include <string.h>
+
+#include "md5.h"
+#include "md5_multi.h"
+
+#if defined(__GNUC__) && defined(__x86_64__) && defined(__linux__)
+#define MD5_MULTI_CLONES __attribute__ ((target_clones ("avx2", "default")))
+#else /* ! __GNUC__ || ! __x86_64__ || ! __linux__ */
+#define MD5_MULTI_CLONES
+#endif /* __GNUC__ && __x86_64__ && __linux__ */
+
+#define MD5_BLOCK_SIZE 64
+#define MD5_BLOCK_WORDS 16
+
+#define MD5_F(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+#define MD5_G(x, y, z) ((y) ^ ((z) & ((x) ^ (y))))
+#define MD5_H(x, y, z) ((x) ^ (y) ^ (z))
+#define MD5_I(x, y, z) ((y) ^ ((x) | ~(z)))
+#define MD5_ROTL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+#define MD5_STEP(f, a, b, c, d, x, t, s)        \
+    (a) += f ((b), (c), (d)) + (x) + (t);       \
+    (a) = MD5_ROTL ((a), (s));                  \
+    (a) += (b)
+
+typedef md5_word_t md5_vec __attribute__ ((vector_size (sizeof (md5_word_t)
+                                                        * MD5_MULTI_LANES)));
+
+/**
+ * Padded and transposed messages, one per lane.
+ */
+struct md5_multi_lanes {
+    md5_vec words[MD5_MULTI_MAX_BLOCKS][MD5_BLOCK_WORDS]; /**< Message words */
+    md5_vec blocks; /**< Number of blocks for each lane, 0 if unused. */
+    guint blocks_max; /**< Maximum number of blocks in any lane. */
+};
+
+static gboolean md5_multi_lane_add (struct md5_multi_lanes *lanes,
+                                    guint lane, const gchar *data);
+static void md5_multi_transform (const struct md5_multi_lanes *lanes,
+                                 md5_vec *state) MD5_MULTI_CLONES;
+
+/**
+ * Computes MD5 digest for count NUL terminated strings.
+ *
+ * @param data Array of strings to hash.
+ * @param count Number of strings in array.
+ * @param digest Array of count digests to write result to.
+ */
+void
+md5_multi (const gchar **data, guint count,
+           md5_byte_t (*digest)[MD5_DIGEST_SIZE])
+{
+    guint i, lane, lanes_used, word;
+    md5_vec state[4];
+    struct md5_multi_lanes lanes;
+
+    for (i = 0; i < count; i += lanes_used) {
+        lanes_used = MIN (count - i, MD5_MULTI_LANES);
+        if (lanes_used == 1) {
+            md5_single (data[i], digest[i]);
+            continue;
+        }
+
+        memset (&lanes, 0, sizeof (lanes));
+        for (lane = 0; lane < lanes_used; lane++) {
+            if (! md5_multi_lane_add (&lanes, lane, data[i + lane])) {
+                /* Too long for the lanes, leave lane unused */
+                md5_single (data[i + lane], digest[i + lane]);
+            }
+        }
+
+        md5_multi_transform (&lanes, state);
+
+        /* Store digest, words are little endian */
+        for (lane = 0; lane < lanes_used; lane++) {
+            if (lanes.blocks[lane] == 0) {
+                continue;
+            }
+            for (word = 0; word < 4; word++) {
+                digest[i + lane][word * 4] = state[word][lane];
+                digest[i + lane][word * 4 + 1] = state[word][lane] >> 8;
+                digest[i + lane][word * 4 + 2] = state[word][lane] >> 16;
+                digest[i + lane][word * 4 + 3] = state[word][lane] >> 24;
+            }
+        }
+    }
+}
+
+/**
+ * Computes MD5 digest for a single NUL terminated string.
+ *
+ * @param data String to hash.
+ * @param digest Buffer of MD5_DIGEST_SIZE bytes to write digest to.
+ */
+void
+md5_single (const gchar *data, md5_byte_t *digest)
+{
+    md5_state_t pms;
+
+    md5_init (&pms);
+    md5_append (&pms, (const md5_byte_t*) data, strlen (data));
+    md5_finish (&pms, digest);
+}
+
+/**
+ * Formats digest as lower case hex.
+ *
+ * @param digest Digest to format.
+ * @param hex Buffer of MD5_HEX_SIZE bytes to write hex string to.
+ */
+void
+md5_hex (const md5_byte_t *digest, gchar *hex)
+{
+    static const gchar chars[] = "0123456789abcdef";
+    guint i;
+
+    for (i = 0; i < MD5_DIGEST_SIZE; i++) {
+        hex[i * 2] = chars[digest[i] >> 4];
+        hex[i * 2 + 1] = chars[digest[i] & 0xf];
+    }
+    hex[MD5_DIGEST_SIZE * 2] = '\0';
+}
+
+/**
+ * Pads message and stores it transposed in lane.
+ *
+ * @param lanes Lanes to add message to, must be zeroed.
+ * @param lane Lane to use.
+ * @param data NUL terminated message.
+ * @return FALSE if the message does not fit, else TRUE.
+ */
+gboolean
+md5_multi_lane_add (struct md5_multi_lanes *lanes, guint lane,
+                    const gchar *data)
+{
+    gsize i, len = strlen (data);
+    guint64 bits = (guint64) len * 8;
+    guint blocks = (len + 8) / MD5_BLOCK_SIZE + 1;
+    md5_word_t *words;
+
+    if (blocks > MD5_MULTI_MAX_BLOCKS) {
+        return FALSE;
+    }
+
+#define MD5_MULTI_BYTE(pos, byte)                                       \
+    words = (md5_word_t*) &lanes->words[(pos) / MD5_BLOCK_SIZE]         \
+        [((pos) % MD5_BLOCK_SIZE) / 4];                                 \
+    words[lane] |= ((md5_word_t) (byte)) << (((pos) % 4) * 8)
+
+    for (i = 0; i < len; i++) {
+        MD5_MULTI_BYTE (i, (guchar) data[i]);
+    }
+    MD5_MULTI_BYTE (len, 0x80);
+    for (i = 0; i < 8; i++) {
+        MD5_MULTI_BYTE (blocks * MD5_BLOCK_SIZE - 8 + i,
+                        (guchar) (bits >> (i * 8)));
+    }
+
+#undef MD5_MULTI_BYTE
+
+    lanes->blocks[lane] = blocks;
+    lanes->blocks_max = MAX (lanes->blocks_max, blocks);
+
+    return TRUE;
+}
+
+/**
+ * Runs the MD5 transform over all blocks of all lanes. Lanes with
+ * fewer blocks keep their state once their last block is done.
+ *
+ * @param lanes Padded and transposed messages.
+ * @param state Resulting A, B, C and D words for all lanes.
+ */
+void
+md5_multi_transform (const struct md5_multi_lanes *lanes, md5_vec *state)
+{
+    guint block;
+    md5_vec a, b, c, d, active, zero = { 0 };
+    const md5_vec *x;
+
+    state[0] = zero + 0x67452301;
+    state[1] = zero + 0xefcdab89;
+    state[2] = zero + 0x98badcfe;
+    state[3] = zero + 0x10325476;
+
+    for (block = 0; block < lanes->blocks_max; block++) {
+        x = lanes->words[block];
+        a = state[0];
+        b = state[1];
+        c = state[2];
+        d = state[3];
+
+        /* Round 1 */
+        MD5_STEP (MD5_F, a, b, c, d, x[0], 0xd76aa478, 7);
+        MD5_STEP (MD5_F, d, a, b, c, x[1], 0xe8c7b756, 12);
+        MD5_STEP (MD5_F, c, d, a, b, x[2], 0x242070db, 17);
+        MD5_STEP (MD5_F, b, c, d, a, x[3], 0xc1bdceee, 22);
+        MD5_STEP (MD5_F, a, b, c, d, x[4], 0xf57c0faf, 7);
+        MD5_STEP (MD5_F, d, a, b, c, x[5], 0x4787c62a, 12);
+        MD5_STEP (MD5_F, c, d, a, b, x[6], 0xa8304613, 17);
+        MD5_STEP (MD5_F, b, c, d, a, x[7], 0xfd469501, 22);
+        MD5_STEP (MD5_F, a, b, c, d, x[8], 0x698098d8, 7);
+        MD5_STEP (MD5_F, d, a, b, c, x[9], 0x8b44f7af, 12);
+        MD5_STEP (MD5_F, c, d, a, b, x[10], 0xffff5bb1, 17);
+        MD5_STEP (MD5_F, b, c, d, a, x[11], 0x895cd7be, 22);
+        MD5_STEP (MD5_F, a, b, c, d, x[12], 0x6b901122, 7);
+        MD5_STEP (MD5_F, d, a, b, c, x[13], 0xfd987193, 12);
+        MD5_STEP (MD5_F, c, d, a, b, x[14], 0xa679438e, 17);
+        MD5_STEP (MD5_F, b, c, d, a, x[15], 0x49b40821, 22);
+
+        /* Round 2 */
+        MD5_STEP (MD5_G, a, b, c, d, x[1], 0xf61e2562, 5);
+        MD5_STEP (MD5_G, d, a, b, c, x[6], 0xc040b340, 9);
+        MD5_STEP (MD5_G, c, d, a, b, x[11], 0x265e5a51, 14);
+        MD5_STEP (MD5_G, b, c, d, a, x[0], 0xe9b6c7aa, 20);
+        MD5_STEP (MD5_G, a, b, c, d, x[5], 0xd62f105d, 5);
+        MD5_STEP (MD5_G, d, a, b, c, x[10], 0x02441453, 9);
+        MD5_STEP (MD5_G, c, d, a, b, x[15], 0xd8a1e681, 14);
+        MD5_STEP (MD5_G, b, c, d, a, x[4], 0xe7d3fbc8, 20);
+        MD5_STEP (MD5_G, a, b, c, d, x[9], 0x21e1cde6, 5);
+        MD5_STEP (MD5_G, d, a, b, c, x[14], 0xc33707d6, 9);
+        MD5_STEP (MD5_G, c, d, a, b, x[3], 0xf4d50d87, 14);
+        MD5_STEP (MD5_G, b, c, d, a, x[8], 0x455a14ed, 20);
+        MD5_STEP (MD5_G, a, b, c, d, x[13], 0xa9e3e905, 5);
+        MD5_STEP (MD5_G, d, a, b, c, x[2], 0xfcefa3f8, 9);
+        MD5_STEP (MD5_G, c, d, a, b, x[7], 0x676f02d9, 14);
+        MD5_STEP (MD5_G, b, c, d, a, x[12], 0x8d2a4c8a, 20);
+
+        /* Round 3 */
+        MD5_STEP (MD5_H, a, b, c, d, x[5], 0xfffa3942, 4);
+        MD5_STEP (MD5_H, d, a, b, c, x[8], 0x8771f681, 11);
+        MD5_STEP (MD5_H, c, d, a, b, x[11], 0x6d9d6122, 16);
+        MD5_STEP (MD5_H, b, c, d, a, x[14], 0xfde5380c, 23);
+        MD5_STEP (MD5_H, a, b, c, d, x[1], 0xa4beea44, 4);
+        MD5_STEP (MD5_H, d, a, b, c, x[4], 0x4bdecfa9, 11);
+        MD5_STEP (MD5_H, c, d, a, b, x[7], 0xf6bb4b60, 16);
+        MD5_STEP (MD5_H, b, c, d, a, x[10], 0xbebfbc70, 23);
+        MD5_STEP (MD5_H, a, b, c, d, x[13], 0x289b7ec6, 4);
+        MD5_STEP (MD5_H, d, a, b, c, x[0], 0xeaa127fa, 11);
+        MD5_STEP (MD5_H, c, d, a, b, x[3], 0xd4ef3085, 16);
+        MD5_STEP (MD5_H, b, c, d, a, x[6], 0x04881d05, 23);
+        MD5_STEP (MD5_H, a, b, c, d, x[9], 0xd9d4d039, 4);
+        MD5_STEP (MD5_H, d, a, b, c, x[12], 0xe6db99e5, 11);
+        MD5_STEP (MD5_H, c, d, a, b, x[15], 0x1fa27cf8, 16);
+        MD5_STEP (MD5_H, b, c, d, a, x[2], 0xc4ac5665, 23);
+
+        /* Round 4 */
+        MD5_STEP (MD5_I, a, b, c, d, x[0], 0xf4292244, 6);
+        MD5_STEP (MD5_I, d, a, b, c, x[7], 0x432aff97, 10);
+        MD5_STEP (MD5_I, c, d, a, b, x[14], 0xab9423a7, 15);
+        MD5_STEP (MD5_I, b, c, d, a, x[5], 0xfc93a039, 21);
+        MD5_STEP (MD5_I, a, b, c, d, x[12], 0x655b59c3, 6);
+        MD5_STEP (MD5_I, d, a, b, c, x[3], 0x8f0ccc92, 10);
+        MD5_STEP (MD5_I, c, d, a, b, x[10], 0xffeff47d, 15);
+        MD5_STEP (MD5_I, b, c, d, a, x[1], 0x85845dd1, 21);
+        MD5_STEP (MD5_I, a, b, c, d, x[8], 0x6fa87e4f, 6);
+        MD5_STEP (MD5_I, d, a, b, c, x[15], 0xfe2ce6e0, 10);
+        MD5_STEP (MD5_I, c, d, a, b, x[6], 0xa3014314, 15);
+        MD5_STEP (MD5_I, b, c, d, a, x[13], 0x4e0811a1, 21);
+        MD5_STEP (MD5_I, a, b, c, d, x[4], 0xf7537e82, 6);
+        MD5_STEP (MD5_I, d, a, b, c, x[11], 0xbd3af235, 10);
+        MD5_STEP (MD5_I, c, d, a, b, x[2], 0x2ad7d2bb, 15);
+        MD5_STEP (MD5_I, b, c, d, a, x[9], 0xeb86d391, 21);
+
+        /* Only update lanes that still have blocks left */
+        active = (md5_vec) (lanes->blocks > block);
+        state[0] += a & active;
+        state[1] += b & active;
+        state[2] += c & active;
+        state[3] += d & active;
+    }
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2026 Claes Nästén <pekdon@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * Multi-buffer MD5, hashes several short messages at once using one
+ * SIMD lane per message.
+ */
+
+#ifndef _MD5_MULTI_H_
+#define _MD5_MULTI_H_
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <glib.h>
+
+#include "md5.h"
+
+#define MD5_MULTI_LANES 8
+#define MD5_MULTI_MAX_BLOCKS 8
+#define MD5_DIGEST_SIZE 16
+#define MD5_HEX_SIZE 33
+
+extern void md5_multi (const gchar **data, guint count,
+                       md5_byte_t (*digest)[MD5_DIGEST_SIZE]);
+extern void md5_single (const gchar *data, md5_byte_t *digest);
+extern void md5_hex (const md5_byte_t *digest, gchar *hex);
+
+#endif /* _MD5_MULTI_H_ */
@@ -14,10 +14,21 @@ orientation_transform (GdkPixbuf **pix_ret, guint *width, guint *height,
         return;
     }
 
+    orientation_apply (pix_ret, width, height, orientation_ll);
+}
+
+/**
+ * Update *pix_ret for the specified numeric orientation, as found in
+ * the EXIF Orientation tag.
+ */
+void
+orientation_apply (GdkPixbuf **pix_ret, guint *width, guint *height,
+                   gint orientation)
+{
     GdkPixbuf *pix = NULL;
     gint tmp;
     
-    switch (orientation_ll) {
+    switch (orientation) {
     case TOP_LEFT_SIDE:
     case TOP_RIGHT_SIDE:
         break;
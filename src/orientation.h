@@ -25,5 +25,7 @@ enum orientation {
 
 void orientation_transform (GdkPixbuf **pix_ret, guint *width, guint *height,
                             const gchar *orientation);
+void orientation_apply (GdkPixbuf **pix_ret, guint *width, guint *height,
+                        gint orientation);
 
 #endif /* _ORIENTATION_H_ */
@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2026 Claes Nästén <pekdon@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * Minimal PNG chunk walker reading text chunks without decoding pixels.
+ *
+ * Chunks are walked from the start of the file until the first IDAT
+ * chunk, which is where writers put the tEXt chunks of thumbnails.
+ * Uncompressed tEXt and iTXt chunks are read, all other chunks are
+ * skipped over without reading their data. CRCs are not verified,
+ * the pixel decoder does that for entries that are used.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include "png_text.h"
+
+#define PNG_SIGNATURE "\211PNG\r\n\032\n"
+#define PNG_SIGNATURE_LEN 8
+#define PNG_CHUNK_HEADER_LEN 8
+#define PNG_CHUNK_CRC_LEN 4
+
+static void png_text_parse (const gchar *type, gchar *data, guint32 len,
+                            const gchar **keys, gchar **values,
+                            guint count);
+static guint32 png_text_uint32 (const guchar *buf);
+
+/**
+ * Reads text chunks from PNG file. Values for keys not found are set
+ * to NULL.
+ *
+ * @param path Path to PNG file.
+ * @param keys Keywords to read values for.
+ * @param values Array of count values to set, values need freeing.
+ * @param count Number of keys.
+ * @return TRUE if file is a PNG file, else FALSE.
+ */
+gboolean
+png_text_read (const gchar *path, const gchar **keys, gchar **values,
+               guint count)
+{
+    FILE *fp;
+    guint32 len;
+    gboolean status = FALSE;
+    guchar header[PNG_CHUNK_HEADER_LEN];
+    gchar type[5], data[PNG_TEXT_KEY_MAX + PNG_TEXT_VALUE_MAX + 8];
+
+    memset (values, 0, sizeof (gchar*) * count);
+
+    fp = g_fopen (path, "rb");
+    if (! fp) {
+        return FALSE;
+    }
+
+    if (fread (header, 1, PNG_SIGNATURE_LEN, fp) != PNG_SIGNATURE_LEN
+        || memcmp (header, PNG_SIGNATURE, PNG_SIGNATURE_LEN)) {
+        fclose (fp);
+        return FALSE;
+    }
+
+    type[4] = '\0';
+    while (fread (header, 1, PNG_CHUNK_HEADER_LEN, fp)
+           == PNG_CHUNK_HEADER_LEN) {
+        len = png_text_uint32 (header);
+        memcpy (type, header + 4, 4);
+
+        if (! strcmp (type, "IDAT") || ! strcmp (type, "IEND")) {
+            /* Text after the pixel data is not looked for */
+            status = TRUE;
+            break;
+        }
+
+        if ((! strcmp (type, "tEXt") || ! strcmp (type, "iTXt"))
+            && len < sizeof (data)) {
+            if (fread (data, 1, len, fp) != len) {
+                break;
+            }
+            data[len] = '\0';
+            png_text_parse (type, data, len, keys, values, count);
+            len = 0;
+        }
+
+        if (fseek (fp, len + PNG_CHUNK_CRC_LEN, SEEK_CUR)) {
+            break;
+        }
+    }
+
+    fclose (fp);
+
+    return status;
+}
+
+/**
+ * Parses tEXt or iTXt chunk, storing the value if keyword is wanted.
+ *
+ * @param type Chunk type.
+ * @param data NUL terminated chunk data.
+ * @param len Length of chunk data.
+ * @param keys Keywords to read values for.
+ * @param values Array of count values to set.
+ * @param count Number of keys.
+ */
+void
+png_text_parse (const gchar *type, gchar *data, guint32 len,
+                const gchar **keys, gchar **values, guint count)
+{
+    guint i;
+    gchar *value, *end = data + len;
+
+    /* keyword \0 text for tEXt */
+    value = memchr (data, '\0', len);
+    if (! value) {
+        return;
+    }
+    value++;
+
+    if (type[0] == 'i') {
+        /* keyword \0 compressed method language \0 translated \0 text,
+           compressed values are skipped. */
+        if (end - value < 2 || value[0] != 0) {
+            return;
+        }
+        value += 2;
+        value = memchr (value, '\0', end - value);
+        if (! value) {
+            return;
+        }
+        value = memchr (value + 1, '\0', end - value - 1);
+        if (! value) {
+            return;
+        }
+        value++;
+    }
+
+    for (i = 0; i < count; i++) {
+        if (! values[i] && ! strcmp (data, keys[i])) {
+            values[i] = g_strndup (value, end - value);
+            break;
+        }
+    }
+}
+
+/**
+ * Reads big endian 32-bit integer.
+ */
+guint32
+png_text_uint32 (const guchar *buf)
+{
+    return ((guint32) buf[0] << 24) | ((guint32) buf[1] << 16)
+        | ((guint32) buf[2] << 8) | (guint32) buf[3];
+}
@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) 2026 Claes Nästén <pekdon@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * Readahead hints for files that are about to be read.
+ *
+ * Callers hint the next files in the order they will be read, the
+ * hints are issued with posix_fadvise WILLNEED from a separate thread
+ * as it can block on metadata lookups. Hinted bytes not yet read are
+ * kept within a budget, the oldest hints are evicted first. Reads are
+ * reported back to count hits and misses, logged at debug level when
+ * freed.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "readahead.h"
+
+static void readahead_worker (gpointer data, gpointer user_data);
+static void readahead_evict (struct readahead *ra);
+
+/**
+ * Creates new readahead scheduler.
+ *
+ * @param count Number of files to hint ahead, used by callers.
+ * @param budget Maximum bytes hinted and not yet read.
+ * @return Pointer to struct readahead.
+ */
+struct readahead*
+readahead_new (guint count, guint64 budget)
+{
+    struct readahead *ra;
+
+    ra = g_malloc (sizeof (struct readahead));
+    ra->count = count;
+    ra->budget = budget;
+    ra->pending_bytes = 0;
+    ra->pending = g_queue_new ();
+    ra->pool = g_thread_pool_new (&readahead_worker, ra,
+                                  1 /* max threads */,
+                                  FALSE /* exclusive */, NULL);
+    ra->hits = 0;
+    ra->misses = 0;
+    ra->unused = 0;
+    g_mutex_init (&ra->mutex);
+
+    return ra;
+}
+
+/**
+ * Frees readahead scheduler, hints not yet issued are dropped.
+ *
+ * @param ra Pointer to struct readahead to free.
+ */
+void
+readahead_free (struct readahead *ra)
+{
+    g_assert (ra);
+
+    g_thread_pool_free (ra->pool, TRUE /* immediate */, TRUE /* wait */);
+
+    g_log (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG,
+           "readahead: %u hits, %u misses, %u unused",
+           ra->hits, ra->misses, ra->unused + g_queue_get_length (ra->pending));
+
+    g_queue_free (ra->pending);
+    g_mutex_clear (&ra->mutex);
+    g_free (ra);
+}
+
+/**
+ * Hints that file is about to be read. Remote files and files already
+ * hinted are ignored.
+ *
+ * @param ra Pointer to struct readahead.
+ * @param file File to hint.
+ */
+void
+readahead_hint (struct readahead *ra, struct file_multi *file)
+{
+    off_t size;
+
+    if (file_multi_need_fetch (file)) {
+        return;
+    }
+
+    size = file_multi_get_size (file);
+    if (size <= 0 || (guint64) size > ra->budget) {
+        return;
+    }
+
+    g_mutex_lock (&ra->mutex);
+    if (g_queue_find (ra->pending, file)) {
+        g_mutex_unlock (&ra->mutex);
+        return;
+    }
+
+    /* Newer hints are more relevant, make room for them */
+    while (ra->pending_bytes + size > ra->budget) {
+        readahead_evict (ra);
+    }
+
+    g_queue_push_tail (ra->pending, file);
+    ra->pending_bytes += size;
+    g_mutex_unlock (&ra->mutex);
+
+    g_thread_pool_push (ra->pool, file, NULL);
+}
+
+/**
+ * Reports that file is being read, updating statistics.
+ *
+ * @param ra Pointer to struct readahead.
+ * @param file File being read.
+ */
+void
+readahead_read (struct readahead *ra, struct file_multi *file)
+{
+    g_mutex_lock (&ra->mutex);
+    if (g_queue_remove (ra->pending, file)) {
+        ra->pending_bytes -= file_multi_get_size (file);
+        ra->hits++;
+    } else {
+        ra->misses++;
+    }
+    g_mutex_unlock (&ra->mutex);
+}
+
+/**
+ * Drops all pending hints, used when the read direction changes.
+ *
+ * @param ra Pointer to struct readahead.
+ */
+void
+readahead_reset (struct readahead *ra)
+{
+    g_mutex_lock (&ra->mutex);
+    while (! g_queue_is_empty (ra->pending)) {
+        readahead_evict (ra);
+    }
+    g_mutex_unlock (&ra->mutex);
+}
+
+/**
+ * Issues hint for file.
+ *
+ * @param data struct file_multi to hint.
+ * @param user_data Pointer to struct readahead.
+ */
+void
+readahead_worker (gpointer data, gpointer user_data)
+{
+    int fd;
+    struct file_multi *file = (struct file_multi*) data;
+    struct readahead *ra = (struct readahead*) user_data;
+
+    /* Already read or evicted */
+    g_mutex_lock (&ra->mutex);
+    if (! g_queue_find (ra->pending, file)) {
+        g_mutex_unlock (&ra->mutex);
+        return;
+    }
+    g_mutex_unlock (&ra->mutex);
+
+    fd = g_open (file_multi_get_path (file), O_RDONLY, 0);
+    if (fd != -1) {
+        posix_fadvise (fd, 0, 0, POSIX_FADV_WILLNEED);
+        close (fd);
+    }
+}
+
+/**
+ * Evicts oldest pending hint, caller must hold the lock.
+ *
+ * @param ra Pointer to struct readahead.
+ */
+void
+readahead_evict (struct readahead *ra)
+{
+    struct file_multi *file;
+
+    file = (struct file_multi*) g_queue_pop_head (ra->pending);
+    ra->pending_bytes -= file_multi_get_size (file);
+    ra->unused++;
+}
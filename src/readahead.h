@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2026 Claes Nästén <pekdon@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * Readahead hints for files that are about to be read.
+ */
+
+#ifndef _READAHEAD_H_
+#define _READAHEAD_H_
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <glib.h>
+
+#include "file_multi.h"
+
+#define READAHEAD_BUDGET (64 * 1024 * 1024)
+
+/**
+ * Readahead scheduler, keeps track of hinted files that have not yet
+ * been read within a byte budget.
+ */
+struct readahead {
+    guint count; /**< Number of files to hint ahead. */
+    guint64 budget; /**< Maximum bytes hinted and not yet read. */
+    guint64 pending_bytes; /**< Bytes hinted and not yet read. */
+    GQueue *pending; /**< Files hinted and not yet read, oldest first. */
+    GThreadPool *pool; /**< Thread issuing the hints. */
+
+    guint hits; /**< Files read after being hinted. */
+    guint misses; /**< Files read without being hinted. */
+    guint unused; /**< Files hinted but evicted before being read. */
+
+    GMutex mutex; /**< Lock for pending files and statistics. */
+};
+
+extern struct readahead *readahead_new (guint count, guint64 budget);
+extern void readahead_free (struct readahead *ra);
+
+extern void readahead_hint (struct readahead *ra, struct file_multi *file);
+extern void readahead_read (struct readahead *ra, struct file_multi *file);
+extern void readahead_reset (struct readahead *ra);
+
+#endif /* _READAHEAD_H_ */
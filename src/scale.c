@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2026 Claes Nästén <pekdon@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * Streaming row-wise downscaling with a box filter.
+ *
+ * Each destination pixel is the average of the block of source pixels
+ * mapping to it. Source rows are added to a row of sums as they are
+ * decoded and the destination row is written out once all source rows
+ * for it have been seen, so peak memory is the destination image plus
+ * O(width) instead of the full source image.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <glib.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <string.h>
+
+#include "scale.h"
+
+static void scale_emit_row (struct scale *sc);
+
+/**
+ * Creates new downscaler, the destination size is limited to the
+ * source size as only downscaling is done.
+ *
+ * @param src_width Width of source.
+ * @param src_height Height of source.
+ * @param dst_width Width of destination.
+ * @param dst_height Height of destination.
+ * @param channels 3 for RGB and 4 for RGBA rows.
+ * @return Pointer to struct scale or NULL if the destination can not
+ * be allocated.
+ */
+struct scale*
+scale_new (guint src_width, guint src_height,
+           guint dst_width, guint dst_height, guint channels)
+{
+    guint x;
+    struct scale *sc;
+
+    g_assert (src_width > 0 && src_height > 0);
+    g_assert (channels == 3 || channels == 4);
+
+    dst_width = CLAMP (dst_width, 1, src_width);
+    dst_height = CLAMP (dst_height, 1, src_height);
+
+    sc = g_malloc (sizeof (struct scale));
+    sc->dst = gdk_pixbuf_new (GDK_COLORSPACE_RGB, channels == 4, 8,
+                              dst_width, dst_height);
+    if (! sc->dst) {
+        g_free (sc);
+        return NULL;
+    }
+
+    sc->src_width = src_width;
+    sc->src_height = src_height;
+    sc->dst_width = dst_width;
+    sc->dst_height = dst_height;
+    sc->channels = channels;
+
+    sc->x_map = g_malloc (sizeof (guint) * src_width);
+    sc->x_count = g_malloc0 (sizeof (guint) * dst_width);
+    for (x = 0; x < src_width; x++) {
+        sc->x_map[x] = (guint64) x * dst_width / src_width;
+        sc->x_count[sc->x_map[x]]++;
+    }
+
+    sc->sums = g_malloc0 (sizeof (guint64) * dst_width * channels);
+    sc->src_y = 0;
+    sc->dst_y = 0;
+    sc->y_count = 0;
+
+    return sc;
+}
+
+/**
+ * Frees downscaler and destination image.
+ *
+ * @param sc Pointer to struct scale to free.
+ */
+void
+scale_free (struct scale *sc)
+{
+    g_assert (sc);
+
+    if (sc->dst) {
+        g_object_unref (sc->dst);
+    }
+    g_free (sc->x_map);
+    g_free (sc->x_count);
+    g_free (sc->sums);
+    g_free (sc);
+}
+
+/**
+ * Adds next source row.
+ *
+ * @param sc Pointer to struct scale.
+ * @param row Row of src_width pixels of channels bytes.
+ */
+void
+scale_push_row (struct scale *sc, const guchar *row)
+{
+    guint x, c, dst_y;
+    guint64 *sum;
+
+    if (sc->src_y == sc->src_height) {
+        return;
+    }
+
+    /* Emit previous row when moving on to the next destination row */
+    dst_y = (guint64) sc->src_y * sc->dst_height / sc->src_height;
+    if (dst_y != sc->dst_y) {
+        scale_emit_row (sc);
+        sc->dst_y = dst_y;
+    }
+
+    for (x = 0; x < sc->src_width; x++) {
+        sum = sc->sums + sc->x_map[x] * sc->channels;
+        for (c = 0; c < sc->channels; c++) {
+            sum[c] += *row++;
+        }
+    }
+    sc->y_count++;
+    sc->src_y++;
+}
+
+/**
+ * Finishes scaling, rows not pushed are left black.
+ *
+ * @param sc Pointer to struct scale, is freed.
+ * @return Pointer to downscaled GdkPixbuf.
+ */
+GdkPixbuf*
+scale_finish (struct scale *sc)
+{
+    GdkPixbuf *dst;
+
+    if (sc->y_count > 0) {
+        scale_emit_row (sc);
+    }
+
+    dst = sc->dst;
+    sc->dst = NULL;
+    scale_free (sc);
+
+    return dst;
+}
+
+/**
+ * Writes averages of the summed rows to destination row dst_y and
+ * resets sums.
+ *
+ * @param sc Pointer to struct scale.
+ */
+void
+scale_emit_row (struct scale *sc)
+{
+    guint x, c, count;
+    guchar *dst;
+    guint64 *sum = sc->sums;
+
+    dst = gdk_pixbuf_get_pixels (sc->dst)
+        + sc->dst_y * gdk_pixbuf_get_rowstride (sc->dst);
+    for (x = 0; x < sc->dst_width; x++) {
+        count = sc->x_count[x] * sc->y_count;
+        for (c = 0; c < sc->channels; c++) {
+            *dst++ = (*sum++ + count / 2) / count;
+        }
+    }
+
+    memset (sc->sums, 0, sizeof (guint64) * sc->dst_width * sc->channels);
+    sc->y_count = 0;
+}
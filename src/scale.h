@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2026 Claes Nästén <pekdon@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * Streaming row-wise downscaling with a box filter.
+ */
+
+#ifndef _SCALE_H_
+#define _SCALE_H_
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <glib.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+/**
+ * Downscaler consuming source rows top to bottom, only the
+ * destination image and one row of sums are kept in memory.
+ */
+struct scale {
+    GdkPixbuf *dst; /**< Destination image. */
+    guint src_width; /**< Width of source rows. */
+    guint src_height; /**< Number of source rows. */
+    guint dst_width; /**< Width of destination. */
+    guint dst_height; /**< Height of destination. */
+    guint channels; /**< Bytes per pixel, 3 for RGB and 4 for RGBA. */
+
+    guint *x_map; /**< Destination column of each source column. */
+    guint *x_count; /**< Number of source columns per destination column. */
+    guint64 *sums; /**< Sums for the destination row being built. */
+    guint src_y; /**< Next source row. */
+    guint dst_y; /**< Destination row being built. */
+    guint y_count; /**< Number of source rows summed for dst_y. */
+};
+
+extern struct scale *scale_new (guint src_width, guint src_height,
+                                guint dst_width, guint dst_height,
+                                guint channels);
+extern void scale_free (struct scale *sc);
+
+extern void scale_push_row (struct scale *sc, const guchar *row);
+extern GdkPixbuf *scale_finish (struct scale *sc);
+
+#endif /* _SCALE_H_ */
@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2026 Claes Nästén <pekdon@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * Conversion of pixbufs to cairo image surfaces.
+ *
+ * Pixbufs store RGB or non-premultiplied RGBA bytes while cairo image
+ * surfaces store native endian 32-bit words with premultiplied alpha.
+ * Converting once when an image is loaded lets it be painted without
+ * conversion every time it is drawn. RGBA pixels are converted
+ * SURFACE_LANES at a time using vector extensions.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <glib.h>
+#include <string.h>
+
+#include "surface.h"
+
+#if defined(__GNUC__) && defined(__x86_64__) && defined(__linux__)
+#define SURFACE_CLONES __attribute__ ((target_clones ("avx2", "default")))
+#else /* ! __GNUC__ || ! __x86_64__ || ! __linux__ */
+#define SURFACE_CLONES
+#endif /* __GNUC__ && __x86_64__ && __linux__ */
+
+/* Shift of channel in a 32-bit word loaded from pixbuf bytes */
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+#define SURFACE_SHIFT(channel) ((channel) * 8)
+#else /* G_BYTE_ORDER != G_LITTLE_ENDIAN */
+#define SURFACE_SHIFT(channel) (24 - (channel) * 8)
+#endif /* G_BYTE_ORDER == G_LITTLE_ENDIAN */
+
+/* Divides x, at most 255 * 255, by 255 rounding to nearest */
+#define SURFACE_DIV255(x) (((x) + 128 + (((x) + 128) >> 8)) >> 8)
+
+typedef guint32 surface_vec __attribute__ ((vector_size (sizeof (guint32)
+                                                         * SURFACE_LANES)));
+
+static void surface_convert_rgb (const guchar *src, guint32 *dst,
+                                 guint width) SURFACE_CLONES;
+static void surface_convert_rgba (const guchar *src, guint32 *dst,
+                                  guint width) SURFACE_CLONES;
+
+/**
+ * Creates image surface with the contents of pix, RGB24 for opaque
+ * pixbufs and ARGB32 for pixbufs with alpha.
+ *
+ * @param pix Pixbuf with 8 bits per sample, at most SURFACE_MAX_SIDE
+ *        pixels wide and high.
+ * @return New surface, NULL if it could not be created.
+ */
+cairo_surface_t*
+surface_from_pixbuf (GdkPixbuf *pix)
+{
+    cairo_surface_t *surface;
+    const guchar *src;
+    guchar *dst;
+    gint y, width, height, src_stride, dst_stride;
+    gboolean has_alpha;
+
+    g_assert (gdk_pixbuf_get_bits_per_sample (pix) == 8);
+
+    width = gdk_pixbuf_get_width (pix);
+    height = gdk_pixbuf_get_height (pix);
+    has_alpha = gdk_pixbuf_get_has_alpha (pix);
+
+    surface = cairo_image_surface_create (has_alpha
+                                          ? CAIRO_FORMAT_ARGB32
+                                          : CAIRO_FORMAT_RGB24,
+                                          width, height);
+    if (cairo_surface_status (surface) != CAIRO_STATUS_SUCCESS) {
+        cairo_surface_destroy (surface);
+        return NULL;
+    }
+
+    cairo_surface_flush (surface);
+    src = gdk_pixbuf_get_pixels (pix);
+    src_stride = gdk_pixbuf_get_rowstride (pix);
+    dst = cairo_image_surface_get_data (surface);
+    dst_stride = cairo_image_surface_get_stride (surface);
+    for (y = 0; y < height; y++) {
+        if (has_alpha) {
+            surface_convert_rgba (src, (guint32*) dst, width);
+        } else {
+            surface_convert_rgb (src, (guint32*) dst, width);
+        }
+        src += src_stride;
+        dst += dst_stride;
+    }
+    cairo_surface_mark_dirty (surface);
+
+    return surface;
+}
+
+/**
+ * Converts row of RGB pixels to RGB24.
+ *
+ * @param src Source pixels, 3 bytes per pixel.
+ * @param dst Destination pixels.
+ * @param width Number of pixels.
+ */
+void
+surface_convert_rgb (const guchar *src, guint32 *dst, guint width)
+{
+    guint x;
+
+    for (x = 0; x < width; x++, src += 3) {
+        dst[x] = 0xff000000 | (src[0] << 16) | (src[1] << 8) | src[2];
+    }
+}
+
+/**
+ * Converts row of RGBA pixels to premultiplied ARGB32.
+ *
+ * @param src Source pixels, 4 bytes per pixel.
+ * @param dst Destination pixels.
+ * @param width Number of pixels.
+ */
+void
+surface_convert_rgba (const guchar *src, guint32 *dst, guint width)
+{
+    surface_vec px, r, g, b, a;
+    guint x, count;
+
+    for (x = 0; x < width; x += SURFACE_LANES) {
+        /* Partial last vector is padded with transparent pixels */
+        count = MIN (width - x, SURFACE_LANES);
+        if (count < SURFACE_LANES) {
+            memset (&px, 0, sizeof (px));
+        }
+        memcpy (&px, src + x * 4, count * 4);
+
+        r = (px >> SURFACE_SHIFT (0)) & 0xff;
+        g = (px >> SURFACE_SHIFT (1)) & 0xff;
+        b = (px >> SURFACE_SHIFT (2)) & 0xff;
+        a = (px >> SURFACE_SHIFT (3)) & 0xff;
+
+        r = SURFACE_DIV255 (r * a);
+        g = SURFACE_DIV255 (g * a);
+        b = SURFACE_DIV255 (b * a);
+
+        px = (a << 24) | (r << 16) | (g << 8) | b;
+        memcpy (dst + x, &px, count * 4);
+    }
+}
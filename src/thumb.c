@@ -30,7 +30,16 @@
 #include "config.h"
 #endif /* HAVE_CONFIG_H */
 
-#define THUMB_LOAD_CHUNK_SIZE 8192
+#define THUMB_PATH_MAX 4096
+#define THUMB_NUM_SIZE 32
+#define THUMB_TIERS 4
+#define THUMB_TIER_FAIL THUMB_TIERS
+#define THUMB_CACHE_DIRS (THUMB_TIERS + 1)
+
+/* Failures are cached per version, see thumb_tiers */
+#ifndef GEH_VERSION
+#error "GEH_VERSION must be defined"
+#endif /* GEH_VERSION */
 
 #include <glib.h>
 #include <glib/gstdio.h>
@@ -42,10 +51,18 @@
 #include <stdlib.h>
 #include <unistd.h>
 
+#include "file_map.h"
 #include "file_multi.h"
-#include "md5.h"
+#include "jpeg.h"
+#include "md5_multi.h"
 #include "orientation.h"
+#include "png_text.h"
 #include "thumb.h"
+#include "thumb_index.h"
+#include "thumb_lru.h"
+#include "thumb_pack.h"
+#include "thumb_writer.h"
+#include "tiff_load.h"
 
 /**
  * Struct used to feed information back to function generating thumbnail.
@@ -54,25 +71,157 @@ struct thumb_image_info {
     guint side; /**< Side size to generate */
     gint width; /**< Original image width */
     gint height; /**< Original image height */
+    gboolean read_failed; /**< Reading failed, not a decoder rejection */
+};
+
+/**
+ * Loader fed from file data.
+ */
+struct thumb_load {
+    GdkPixbufLoader *loader; /**< Loader to write data to. */
+    gboolean rejected; /**< Loader rejected the data written. */
+};
+
+/**
+ * Cache tier, thumbnails of each size are stored in a separate
+ * directory. The last tier records files that failed to load.
+ */
+struct thumb_tier {
+    const gchar *name; /**< Directory name in the cache. */
+    guint side; /**< Maximum side of thumbnails in tier. */
+};
+
+static const struct thumb_tier thumb_tiers[THUMB_CACHE_DIRS] = {
+    { "normal", THUMB_DEFAULT_SIDE },
+    { "large", THUMB_LARGE_SIDE },
+    { "x-large", THUMB_XLARGE_SIDE },
+    { "xx-large", THUMB_XXLARGE_SIDE },
+    { THUMB_CACHE_FAIL G_DIR_SEPARATOR_S "geh-" GEH_VERSION, 0 }
 };
 
+static struct thumb_index *thumb_cache_index[THUMB_CACHE_DIRS] = { NULL };
+static struct thumb_writer *thumb_cache_writer = NULL;
+static struct thumb_lru *thumb_cache_lru = NULL;
+static struct thumb_pack *thumb_cache_pack = NULL;
+
 static GdkPixbuf *thumb_load (const gchar *path,
                               struct thumb_image_info *info);
-
-static GdkPixbuf *thumb_cache_load (struct file_multi *file);
-static void thumb_cache_save (struct file_multi *file, GdkPixbuf *thumb,
+#ifdef HAVE_LIBJPEG
+static GdkPixbuf *thumb_load_jpeg (const gchar *path,
+                                   struct thumb_image_info *info,
+                                   struct jpeg_info *jpeg);
+#endif /* HAVE_LIBJPEG */
+static GdkPixbuf *thumb_load_file (const gchar *path,
+                                   struct thumb_image_info *info);
+static gboolean thumb_load_write (const guchar *data, gsize len,
+                                  gpointer user_data);
+static GdkPixbuf *thumb_load_data (const guchar *data, gsize len,
+                                   struct thumb_image_info *info,
+                                   gint orientation);
+static GdkPixbufLoader *thumb_load_loader (struct thumb_image_info *info);
+static GdkPixbuf *thumb_load_finish (GdkPixbufLoader *loader,
+                                     gint orientation);
+
+static gint thumb_cache_tier (guint side);
+static GdkPixbuf *thumb_cache_load (struct file_multi *file, gint tier,
+                                    struct thumb_image_info *info);
+static GdkPixbuf *thumb_cache_derive (struct file_multi *file, gint tier,
+                                      struct thumb_image_info *info);
+static gboolean thumb_cache_check (struct file_multi *file, gint tier,
+                                   gchar *thumb_path,
+                                   struct thumb_image_info *info);
+static void thumb_cache_save (struct file_multi *file, gint tier,
+                              GdkPixbuf *thumb,
                               struct thumb_image_info *info);
-static gboolean thumb_cache_save_create_directory (void);
+static void thumb_cache_save_fail (struct file_multi *file);
+static void thumb_cache_save_push (struct file_multi *file, gint tier,
+                                   GdkPixbuf *thumb, gchar **keys,
+                                   gchar **values);
+static gboolean thumb_cache_save_create_directory (gint tier);
 
-static gchar *thumb_cache_path (struct file_multi *file);
-static gchar *thumb_cache_md5_uri (const gchar *uri);
+static const gchar *thumb_cache_dir (gint tier);
+static void thumb_cache_path (struct file_multi *file, gint tier,
+                              gchar *path);
 
 static void thumb_callback_size_prepared (GdkPixbufLoader *loader,
                                           gint width, gint height,
                                           gpointer user_data);
 
 /**
- * Gets thumbnail for file at size.
+ * Initializes thumbnail caching, starts reading the cache directories
+ * into the in-memory indexes.
+ *
+ * @param flags THUMB_FLAG_PACK to serve thumbnails from the packed store
+ *              as well, THUMB_FLAG_WAIT_WRITES to wait for pending
+ *              cache writes instead of dropping them.
+ */
+void
+thumb_init (guint flags)
+{
+    gchar *path;
+    gint tier;
+
+    for (tier = 0; tier < THUMB_CACHE_DIRS; tier++) {
+        if (! thumb_cache_index[tier]) {
+            thumb_cache_index[tier] = thumb_index_new (thumb_cache_dir (tier));
+        }
+    }
+    if (! thumb_cache_writer) {
+        thumb_cache_writer =
+            thumb_writer_new (THUMB_WRITER_PENDING_MAX,
+                              (flags & THUMB_FLAG_WAIT_WRITES) != 0);
+    }
+    if (! thumb_cache_lru) {
+        thumb_cache_lru = thumb_lru_new (THUMB_LRU_BUDGET);
+    }
+#ifdef HAVE_LIBTIFF
+    tiff_load_init ();
+#endif /* HAVE_LIBTIFF */
+    if ((flags & THUMB_FLAG_PACK) && ! thumb_cache_pack) {
+        path = g_build_filename (g_get_user_cache_dir (), THUMB_PACK_DIR,
+                                 THUMB_PACK_NAME, NULL);
+        thumb_cache_pack = thumb_pack_open (path);
+        g_free (path);
+    }
+}
+
+/**
+ * Stops thumbnail caching, waits for pending writes and frees the cache
+ * indexes.
+ */
+void
+thumb_shutdown (void)
+{
+    gint tier;
+
+    /* Writer adds entries to the indexes, free first */
+    if (thumb_cache_writer) {
+        thumb_writer_free (thumb_cache_writer);
+        thumb_cache_writer = NULL;
+    }
+
+    for (tier = 0; tier < THUMB_CACHE_DIRS; tier++) {
+        if (thumb_cache_index[tier]) {
+            thumb_index_free (thumb_cache_index[tier]);
+            thumb_cache_index[tier] = NULL;
+        }
+    }
+
+    if (thumb_cache_lru) {
+        thumb_lru_free (thumb_cache_lru);
+        thumb_cache_lru = NULL;
+    }
+
+    /* Pixbufs reference the packed store, close last */
+    if (thumb_cache_pack) {
+        thumb_pack_close (thumb_cache_pack);
+        thumb_cache_pack = NULL;
+    }
+}
+
+/**
+ * Gets thumbnail for file at size, recently used thumbnails are kept in
+ * memory.
  *
  * @param file struct file_multi to create thumbnail for.
  * @param side Maximum side in pixels for thumbnail
@@ -83,31 +232,211 @@ GdkPixbuf*
 thumb_get (struct file_multi *file, guint side, gboolean cache)
 {
     GdkPixbuf *thumb = NULL;
-    gboolean cache_ok = ((side == THUMB_DEFAULT_SIDE)
-                         || (side == THUMB_LARGE_SIDE));
+    gchar thumb_path[THUMB_PATH_MAX];
+    gint tier = thumb_cache_tier (side);
     struct thumb_image_info info = {0 /* Side */,
-                                    0 /* Width */, 0 /* Height */};
+                                    0 /* Width */, 0 /* Height */,
+                                    FALSE /* Read failed */};
+    struct thumb_lru_key key;
+    struct thumb_pack_key pack_key;
+
+    if (thumb_cache_lru) {
+        memcpy (key.digest, file_multi_get_digest (file), MD5_DIGEST_SIZE);
+        key.mtime = file_multi_get_mtime (file);
+        key.side = side;
+
+        thumb = thumb_lru_get (thumb_cache_lru, &key);
+        if (thumb) {
+            return thumb;
+        }
+    }
 
-    /* Try load cached version */
-    if (cache_ok) {
-        thumb = thumb_cache_load (file);
+    info.side = side;
+
+    /* Packed store serves without decoding */
+    if (thumb_cache_pack) {
+        memset (&pack_key, 0, sizeof (pack_key));
+        memcpy (pack_key.digest, file_multi_get_digest (file),
+                MD5_DIGEST_SIZE);
+        pack_key.mtime = file_multi_get_mtime (file);
+        pack_key.size = file_multi_get_size (file);
+        pack_key.side = side;
+
+        thumb = thumb_pack_get (thumb_cache_pack, &pack_key);
+        if (thumb) {
+            if (thumb_cache_lru) {
+                thumb_lru_put (thumb_cache_lru, &key, thumb);
+            }
+            return thumb;
+        }
     }
 
-    /* Generate thumbnail */
-    if (! thumb) {
-        info.side = side;
+    /* Try load cached version, scaling down a larger one is cheaper
+       than decoding the original. */
+    if (tier != -1) {
+        thumb = thumb_cache_load (file, tier, &info);
+        if (! thumb) {
+            thumb = thumb_cache_derive (file, tier, &info);
+            if (thumb && cache) {
+                thumb_cache_save (file, tier, thumb, &info);
+            }
+        }
+    }
 
+    /* Generate thumbnail, unless it failed before for this version.
+       Failures are only recorded when the file could be read, an I/O
+       error may be gone on the next attempt. */
+    if (! thumb
+        && ! thumb_cache_check (file, THUMB_TIER_FAIL, thumb_path, NULL)) {
         thumb = thumb_load (file_multi_get_path (file), &info);
-        if (thumb && cache && cache_ok) {
-            thumb_cache_save (file, thumb, &info);
+        if (thumb && cache && tier != -1) {
+            thumb_cache_save (file, tier, thumb, &info);
+        } else if (! thumb && cache && ! info.read_failed) {
+            thumb_cache_save_fail (file);
         }
     }
 
+    if (thumb && thumb_cache_pack && cache) {
+        thumb_pack_put (thumb_cache_pack, &pack_key, thumb);
+    }
+    if (thumb && thumb_cache_lru) {
+        thumb_lru_put (thumb_cache_lru, &key, thumb);
+    }
+
     return thumb;
 }
 
 /**
- * Loads file at size.
+ * Checks if file has a valid cached thumbnail at size without decoding
+ * it, used to defer decoding until the thumbnail is needed.
+ *
+ * @param file struct file_multi to check thumbnail for.
+ * @param side Maximum side in pixels for thumbnail
+ * @return TRUE if thumb_get will load the thumbnail from cache.
+ */
+gboolean
+thumb_is_cached (struct file_multi *file, guint side)
+{
+    gchar thumb_path[THUMB_PATH_MAX];
+    gint tier = thumb_cache_tier (side);
+
+    if (tier == -1) {
+        return FALSE;
+    }
+
+    return thumb_cache_check (file, tier, thumb_path, NULL);
+}
+
+/**
+ * Checks if generating a thumbnail for this version of file failed
+ * before, thumb_get then returns NULL without loading the file.
+ *
+ * @param file struct file_multi to check.
+ * @return TRUE if a failure is recorded for file.
+ */
+gboolean
+thumb_is_failed (struct file_multi *file)
+{
+    gchar thumb_path[THUMB_PATH_MAX];
+
+    return thumb_cache_check (file, THUMB_TIER_FAIL, thumb_path, NULL);
+}
+
+/**
+ * Returns number of thumbnails waiting to be written to the cache.
+ *
+ * @return Number of pending writes.
+ */
+gint
+thumb_pending_writes (void)
+{
+    return thumb_cache_writer ? thumb_writer_pending (thumb_cache_writer) : 0;
+}
+
+/**
+ * Checks if getting the thumbnail for file is likely to read the image
+ * file, only the cache index is consulted so no I/O is done.
+ *
+ * @param file struct file_multi to check thumbnail for.
+ * @param side Maximum side in pixels for thumbnail
+ * @return FALSE if a cached thumbnail is likely to be used.
+ */
+gboolean
+thumb_need_read (struct file_multi *file, guint side)
+{
+    gint tier = thumb_cache_tier (side);
+
+    if (tier == -1) {
+        return TRUE;
+    }
+
+    /* Smaller tiers are derived from larger ones */
+    for (; tier < THUMB_TIERS; tier++) {
+        if (thumb_cache_index[tier]
+            && thumb_index_lookup (thumb_cache_index[tier],
+                                   file_multi_get_digest (file))
+            == THUMB_INDEX_EXISTS) {
+            return FALSE;
+        }
+    }
+
+    /* Known failures are not loaded again */
+    return ! thumb_cache_index[THUMB_TIER_FAIL]
+        || thumb_index_lookup (thumb_cache_index[THUMB_TIER_FAIL],
+                               file_multi_get_digest (file))
+        != THUMB_INDEX_EXISTS;
+}
+
+/**
+ * Removes failed thumbnail entries recorded by all versions of geh,
+ * must be called before thumb_init.
+ *
+ * @return Number of removed entries.
+ */
+guint
+thumb_purge_failed (void)
+{
+    GDir *dir, *version_dir;
+    const gchar *name, *entry;
+    gchar *fail_path, *version_path, *path;
+    guint removed = 0;
+
+    fail_path = g_build_filename (g_get_user_cache_dir (),
+                                  THUMB_CACHE_PATH_BASE, THUMB_CACHE_FAIL,
+                                  NULL);
+    dir = g_dir_open (fail_path, 0, NULL);
+    while (dir && (name = g_dir_read_name (dir)) != NULL) {
+        if (! g_str_has_prefix (name, "geh-")) {
+            continue;
+        }
+
+        version_path = g_build_filename (fail_path, name, NULL);
+        version_dir = g_dir_open (version_path, 0, NULL);
+        while (version_dir
+               && (entry = g_dir_read_name (version_dir)) != NULL) {
+            path = g_build_filename (version_path, entry, NULL);
+            if (g_unlink (path) == 0) {
+                removed++;
+            }
+            g_free (path);
+        }
+        if (version_dir) {
+            g_dir_close (version_dir);
+        }
+        g_rmdir (version_path);
+        g_free (version_path);
+    }
+    if (dir) {
+        g_dir_close (dir);
+    }
+    g_free (fail_path);
+
+    return removed;
+}
+
+/**
+ * Loads file at size, JPEG files with a large enough embedded preview
+ * are loaded from the preview.
  *
  * @param path File to load.
  * @param side Size in pixels max size of thumbnail.
@@ -117,47 +446,217 @@ GdkPixbuf*
 thumb_load (const gchar *path, struct thumb_image_info *info)
 {
     GdkPixbuf *thumb;
-    GdkPixbufLoader *loader;
-    GError *err = NULL;
+    struct jpeg_info jpeg;
+    guchar *data;
+
+    if (! jpeg_info_read (path, info->side, &jpeg)) {
+#ifdef HAVE_LIBTIFF
+        thumb = tiff_load_thumb (path, info->side,
+                                 &info->width, &info->height);
+        if (thumb) {
+            return thumb;
+        }
+#endif /* HAVE_LIBTIFF */
+        return thumb_load_file (path, info);
+    }
 
-    int fd;
-    guchar buf[THUMB_LOAD_CHUNK_SIZE];
-    size_t buf_read;
+    if (jpeg.preview_len > 0) {
+        data = jpeg_preview_read (path, &jpeg);
+        if (data) {
+            thumb = thumb_load_data (data, jpeg.preview_len, info,
+                                     jpeg.orientation);
+            g_free (data);
+
+            if (thumb) {
+                /* Report size of the original, not the preview */
+                info->width = jpeg.width;
+                info->height = jpeg.height;
+                return thumb;
+            }
+        }
+    }
 
-    /* Create pixbuf loader */
-    loader = gdk_pixbuf_loader_new ();
+#ifdef HAVE_LIBJPEG
+    thumb = thumb_load_jpeg (path, info, &jpeg);
+    if (thumb) {
+        return thumb;
+    }
+#endif /* HAVE_LIBJPEG */
 
-    /* Set callback so the image can be loaded at prefered size with
-       aspect preserved. */
-    g_signal_connect (G_OBJECT (loader), "size-prepared",
-                      G_CALLBACK (thumb_callback_size_prepared), info);
+    return thumb_load_file (path, info);
+}
+
+#ifdef HAVE_LIBJPEG
+/**
+ * Loads JPEG file at size, decoding it downscaled in the DCT domain
+ * and box filtering the (at most twice as large) rows as they are
+ * decoded.
+ *
+ * @param path File to load.
+ * @param info Pointer to struct thumb_image_info.
+ * @param jpeg Pointer to struct jpeg_info read from file.
+ * @return Pointer to GdkPixbuf or NULL if fails.
+ */
+GdkPixbuf*
+thumb_load_jpeg (const gchar *path, struct thumb_image_info *info,
+                 struct jpeg_info *jpeg)
+{
+    guint width, height;
+    GdkPixbuf *thumb;
 
-    /* Open file for reading */
-    fd = open (path, O_RDONLY);
-    if (fd == -1) {
-        g_warning ("failed to open %s for reading", path);
+    /* Nothing to gain for images already at thumbnail size */
+    if ((guint) jpeg->width <= info->side * 2
+        && (guint) jpeg->height <= info->side * 2) {
         return NULL;
     }
 
-    /* Read all of file and write to loader */
-    while ((buf_read = read (fd, buf, THUMB_LOAD_CHUNK_SIZE)) > 0) {
-        if (! gdk_pixbuf_loader_write (loader, buf, buf_read, &err)) {
-            /* Clean resources */
-            gdk_pixbuf_loader_close (loader, NULL);
-            g_object_unref (loader);
-            close (fd);
+    if (jpeg->width > jpeg->height) {
+        width = info->side;
+        height = MAX (1, (guint) ((guint64) info->side * jpeg->height
+                                  / jpeg->width));
+    } else {
+        width = MAX (1, (guint) ((guint64) info->side * jpeg->width
+                                 / jpeg->height));
+        height = info->side;
+    }
 
-            if (err) {
-                g_fprintf (stderr, "%s\n", err->message);
-                g_error_free (err);
-            }
+    thumb = jpeg_load_scaled (path, width, height, TRUE, NULL, NULL);
+    if (! thumb) {
+        return NULL;
+    }
+
+    if (jpeg->orientation > 0) {
+        orientation_apply (&thumb, &width, &height, jpeg->orientation);
+    }
 
-            return NULL;
+    info->width = jpeg->width;
+    info->height = jpeg->height;
+
+    return thumb;
+}
+#endif /* HAVE_LIBJPEG */
+
+/**
+ * Loads file at size by decoding all of it, sets read_failed of info if
+ * the file could not be read.
+ *
+ * @param path File to load.
+ * @param info Pointer to struct thumb_image_info.
+ * @return Pointer to GdkPixbuf or NULL if fails.
+ */
+GdkPixbuf*
+thumb_load_file (const gchar *path, struct thumb_image_info *info)
+{
+    struct thumb_load load;
+
+    load.loader = thumb_load_loader (info);
+    load.rejected = FALSE;
+
+    /* Feed all of file to loader, mapped in one go when possible */
+    if (! file_map_feed (path, &thumb_load_write, &load)) {
+        if (! load.rejected) {
+            g_warning ("failed to read %s", path);
+            info->read_failed = TRUE;
         }
+
+        /* Clean resources */
+        gdk_pixbuf_loader_close (load.loader, NULL);
+        g_object_unref (load.loader);
+
+        return NULL;
     }
 
-    /* Close file after reading */
-    close (fd);
+    return thumb_load_finish (load.loader, 0);
+}
+
+/**
+ * Writes file data to loader.
+ *
+ * @param data File data.
+ * @param len Length of data.
+ * @param user_data Pointer to struct thumb_load.
+ * @return TRUE on success, else FALSE.
+ */
+gboolean
+thumb_load_write (const guchar *data, gsize len, gpointer user_data)
+{
+    struct thumb_load *load = (struct thumb_load*) user_data;
+    GError *err = NULL;
+
+    if (! gdk_pixbuf_loader_write (load->loader, data, len, &err)) {
+        load->rejected = TRUE;
+        if (err) {
+            g_fprintf (stderr, "%s\n", err->message);
+            g_error_free (err);
+        }
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ * Loads image in memory at size.
+ *
+ * @param data Image data.
+ * @param len Length of image data.
+ * @param info Pointer to struct thumb_image_info.
+ * @param orientation EXIF orientation to apply if the image data has
+ * none, 0 for none.
+ * @return Pointer to GdkPixbuf or NULL if fails.
+ */
+GdkPixbuf*
+thumb_load_data (const guchar *data, gsize len,
+                 struct thumb_image_info *info, gint orientation)
+{
+    GdkPixbufLoader *loader;
+
+    loader = thumb_load_loader (info);
+    if (! gdk_pixbuf_loader_write (loader, data, len, NULL)) {
+        gdk_pixbuf_loader_close (loader, NULL);
+        g_object_unref (loader);
+        return NULL;
+    }
+
+    return thumb_load_finish (loader, orientation);
+}
+
+/**
+ * Creates pixbuf loader loading images at thumbnail size.
+ *
+ * @param info Pointer to struct thumb_image_info.
+ * @return New GdkPixbufLoader.
+ */
+GdkPixbufLoader*
+thumb_load_loader (struct thumb_image_info *info)
+{
+    GdkPixbufLoader *loader;
+
+    /* Create pixbuf loader */
+    loader = gdk_pixbuf_loader_new ();
+
+    /* Set callback so the image can be loaded at prefered size with
+       aspect preserved. */
+    g_signal_connect (G_OBJECT (loader), "size-prepared",
+                      G_CALLBACK (thumb_callback_size_prepared), info);
+
+    return loader;
+}
+
+/**
+ * Finishes loading, gets the pixbuf and applies orientation.
+ *
+ * @param loader Loader with all data written, is freed.
+ * @param orientation EXIF orientation to apply if the image has none,
+ * 0 for none.
+ * @return Pointer to GdkPixbuf or NULL if fails.
+ */
+GdkPixbuf*
+thumb_load_finish (GdkPixbufLoader *loader, gint orientation)
+{
+    GdkPixbuf *thumb;
+    GError *err = NULL;
+    guint width, height;
 
     /* Finalize loading of image */
     if (! gdk_pixbuf_loader_close (loader, &err)) {
@@ -175,11 +674,13 @@ thumb_load (const gchar *path, struct thumb_image_info *info)
     thumb = gdk_pixbuf_loader_get_pixbuf (loader);
     g_object_ref (thumb);
 
-    const gchar *orientation = gdk_pixbuf_get_option(thumb, "orientation");
-    if (orientation != NULL) {
-        guint width = gdk_pixbuf_get_width (thumb);
-        guint height = gdk_pixbuf_get_height (thumb);
-        orientation_transform (&thumb, &width, &height, orientation);
+    width = gdk_pixbuf_get_width (thumb);
+    height = gdk_pixbuf_get_height (thumb);
+    const gchar *orientation_str = gdk_pixbuf_get_option(thumb, "orientation");
+    if (orientation_str != NULL) {
+        orientation_transform (&thumb, &width, &height, orientation_str);
+    } else if (orientation > 0) {
+        orientation_apply (&thumb, &width, &height, orientation);
     }
 
     /* Clean resources */
@@ -189,190 +690,315 @@ thumb_load (const gchar *path, struct thumb_image_info *info)
 }
 
 /**
- * Load thumbnail from cache.
+ * Gets the cache tier thumbnails of size are stored in.
+ *
+ * @param side Maximum side in pixels for thumbnail.
+ * @return Index of tier, -1 if thumbnails of size are not cached.
+ */
+gint
+thumb_cache_tier (guint side)
+{
+    gint tier;
+
+    for (tier = 0; tier < THUMB_TIERS; tier++) {
+        if (thumb_tiers[tier].side == side) {
+            return tier;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Load thumbnail from cache, pixels are only decoded for entries that
+ * are valid.
  *
  * @param file Original file.
+ * @param tier Cache tier to load from.
+ * @param info Pointer to struct thumb_image_info to set original size in.
  * @return GdkPixbuf representation of cached image, if none NULL.
  */
 GdkPixbuf*
-thumb_cache_load (struct file_multi *file)
+thumb_cache_load (struct file_multi *file, gint tier,
+                  struct thumb_image_info *info)
 {
-    time_t mtime;
-    gchar *thumb_path;
-    const gchar *mtime_str;
-    GdkPixbuf *thumb = NULL;
+    gchar thumb_path[THUMB_PATH_MAX];
+    GdkPixbuf *thumb;
 
-    /* Get thumbnail file */
-    thumb_path = thumb_cache_path (file);
-    if (g_file_test (thumb_path, G_FILE_TEST_IS_REGULAR)) {
-        thumb = gdk_pixbuf_new_from_file (thumb_path, NULL);
-
-        /* Check mtime */
-        mtime_str = gdk_pixbuf_get_option (thumb, "tEXt::Thumb::MTime");
-        if (mtime_str) {
-            mtime = strtol (mtime_str, NULL, 10);
-            if (mtime != file_multi_get_mtime (file)) {
-                /* mtime does not match, treat as invalid */
-                g_object_unref (thumb);
-                thumb = NULL;
-            }
-        } else {
-            /* No mtime to check against, treat as invalid */
-            g_object_unref (thumb);
-            thumb = NULL;
-        }
+    if (! thumb_cache_check (file, tier, thumb_path, info)) {
+        return NULL;
     }
 
-    /* Cleanup */
-    g_free (thumb_path);
+    thumb = gdk_pixbuf_new_from_file (thumb_path, NULL);
+    if (! thumb && thumb_cache_index[tier]) {
+        /* Removed or unreadable, do not try again */
+        thumb_index_remove (thumb_cache_index[tier],
+                            file_multi_get_digest (file));
+    }
 
     return thumb;
 }
 
 /**
- * Save thumbnail to cache.
+ * Derives thumbnail from the closest larger cache tier with a valid
+ * entry.
  *
  * @param file Original file.
- * @param thumb Pointer GdkPixbuf thumbnail to save.
- * @param info Pointer to struct thumb_image_info.
+ * @param tier Cache tier to derive thumbnail for.
+ * @param info Pointer to struct thumb_image_info with side to scale to.
+ * @return GdkPixbuf scaled from larger cached image, if none NULL.
  */
-void
-thumb_cache_save (struct file_multi *file, GdkPixbuf *thumb,
-                  struct thumb_image_info *info)
+GdkPixbuf*
+thumb_cache_derive (struct file_multi *file, gint tier,
+                    struct thumb_image_info *info)
 {
-    gchar *thumb_path;
-    gchar *size, *mtime, *width, *height;
+    GdkPixbuf *thumb = NULL, *large;
+    gint width, height;
 
-    /* Make sure directory for saving exists */
-    if (! thumb_cache_save_create_directory ()) {
-        return;
-    }
+    for (tier++; ! thumb && tier < THUMB_TIERS; tier++) {
+        large = thumb_cache_load (file, tier, info);
+        if (! large) {
+            continue;
+        }
 
-    /* Get string representation for file info */
-    size = g_strdup_printf ("%li", file_multi_get_size (file));
-    mtime = g_strdup_printf ("%li", file_multi_get_mtime (file));
-    width = g_strdup_printf ("%d", info->width);
-    height = g_strdup_printf ("%d", info->height);
+        width = gdk_pixbuf_get_width (large);
+        height = gdk_pixbuf_get_height (large);
+        if (width <= info->side && height <= info->side) {
+            /* Original smaller than thumbnail, already the same */
+            thumb = large;
+        } else {
+            if (width > height) {
+                height = MAX (1, height * info->side / width);
+                width = info->side;
+            } else {
+                width = MAX (1, width * info->side / height);
+                height = info->side;
+            }
+            thumb = gdk_pixbuf_scale_simple (large, width, height,
+                                             GDK_INTERP_BILINEAR);
+            g_object_unref (large);
+        }
+    }
 
-    /* Get thumbnail file */
-    thumb_path = thumb_cache_path (file);
-
-    if (!  gdk_pixbuf_save (thumb, thumb_path, "png", NULL,
-                            "tEXt::Thumb::URI", file_multi_get_uri (file),
-                            "tEXt::Thumb::Size", size,
-                            "tEXt::Thumb::MTime", mtime,
-                            "tEXt::Thumb::Image::Width", width,
-                            "tEXt::Thumb::Image::Height", height,
-                            NULL)) {
-        g_warning ("failed to save thumbnail for %s",
-                   file_multi_get_path (file));
-    }
-
-    /* Cleanup */
-    g_free (size);
-    g_free (mtime);
-    g_free (width);
-    g_free (height);
-    g_free (thumb_path);
+    return thumb;
 }
 
 /**
- * Makes sure thumbnail directory exists.
+ * Checks if there is a valid cache entry for file, only the text
+ * chunks at the head of the cached PNG are read.
  *
- * @return Returns TRUE if it exists (or has been created), else FALSE.
+ * @param file Original file.
+ * @param tier Cache tier to check.
+ * @param thumb_path Buffer of THUMB_PATH_MAX bytes to write path to.
+ * @param info Pointer to struct thumb_image_info to set original size
+ *             in, or NULL.
+ * @return TRUE if entry exists and matches file, else FALSE.
  */
 gboolean
-thumb_cache_save_create_directory (void)
+thumb_cache_check (struct file_multi *file, gint tier, gchar *thumb_path,
+                   struct thumb_image_info *info)
 {
-    static gboolean tried = FALSE;
-    static gboolean status = FALSE;
-
-    gchar *path, *path_base;
+    static const gchar *keys[] = { "Thumb::URI", "Thumb::MTime",
+                                   "Thumb::Size", "Thumb::Image::Width",
+                                   "Thumb::Image::Height" };
+
+    gchar size[THUMB_NUM_SIZE], *values[G_N_ELEMENTS (keys)];
+    gboolean valid;
+    guint i, status = THUMB_INDEX_UNKNOWN;
+    struct thumb_index *index = thumb_cache_index[tier];
+
+    /* Entries not in the index are not on disk either, once the index
+       is complete. */
+    if (index) {
+        status = thumb_index_lookup (index, file_multi_get_digest (file));
+        if (status == THUMB_INDEX_MISSING) {
+            return FALSE;
+        }
+    }
 
-    if (! tried ) {
-        /* Set tried flag */
-        tried = TRUE;
-
-        /* Check base thumbnail dir */
-        path_base = g_strjoin (NULL, g_get_home_dir (),
-                               THUMB_CACHE_PATH_BASE, NULL);
-        if (g_file_test (path_base, G_FILE_TEST_IS_DIR)
-            || (g_mkdir (path_base, 0700) != -1)) {
-            /* Check thumbnail dir */
-            path =  g_strjoin (NULL, g_get_home_dir (),
-                               THUMB_CACHE_PATH, NULL);
-
-            if (g_file_test (path, G_FILE_TEST_IS_DIR)
-                || (g_mkdir (path, 0700) != -1)) {
-                status = TRUE;
-            }
+    /* Get thumbnail file */
+    thumb_cache_path (file, tier, thumb_path);
+    if (status != THUMB_INDEX_EXISTS
+        && ! g_file_test (thumb_path, G_FILE_TEST_IS_REGULAR)) {
+        return FALSE;
+    }
 
-            g_free (path);
+    if (! png_text_read (thumb_path, keys, values, G_N_ELEMENTS (keys))) {
+        if (index) {
+            thumb_index_remove (index, file_multi_get_digest (file));
         }
+        return FALSE;
+    }
+
+    /* MTime is required, URI and Size are checked if present */
+    g_snprintf (size, sizeof (size), "%li", file_multi_get_size (file));
+    valid = values[1]
+        && strtol (values[1], NULL, 10) == file_multi_get_mtime (file)
+        && (! values[0] || ! strcmp (values[0], file_multi_get_uri (file)))
+        && (! values[2] || ! strcmp (values[2], size));
+
+    /* Original size is kept when deriving smaller tiers */
+    if (valid && info) {
+        info->width = values[3] ? strtol (values[3], NULL, 10) : 0;
+        info->height = values[4] ? strtol (values[4], NULL, 10) : 0;
+    }
 
-        g_free (path_base);
+    for (i = 0; i < G_N_ELEMENTS (keys); i++) {
+        g_free (values[i]);
     }
 
-    return status;
+    return valid;
 }
 
 /**
- * Builds path to thumbnail file for file.
+ * Queues thumbnail for saving to cache, the entry is written in the
+ * background and skipped if too many writes are pending.
  *
- * @param file File to get thumbnail file for.
- * @return Path to thumbnail file for file, needs freeing.
+ * @param file Original file.
+ * @param tier Cache tier to save to.
+ * @param thumb Pointer GdkPixbuf thumbnail to save.
+ * @param info Pointer to struct thumb_image_info.
  */
-gchar*
-thumb_cache_path (struct file_multi *file)
+void
+thumb_cache_save (struct file_multi *file, gint tier, GdkPixbuf *thumb,
+                  struct thumb_image_info *info)
 {
-    gchar *md5, *md5_path;
+    gchar size[THUMB_NUM_SIZE], mtime[THUMB_NUM_SIZE];
+    gchar width[THUMB_NUM_SIZE], height[THUMB_NUM_SIZE];
+    gchar *keys[] = { "tEXt::Thumb::URI", "tEXt::Thumb::Size",
+                      "tEXt::Thumb::MTime", "tEXt::Thumb::Image::Width",
+                      "tEXt::Thumb::Image::Height", "compression", NULL };
+    gchar *values[] = { (gchar*) file_multi_get_uri (file), size, mtime,
+                        width, height, THUMB_WRITER_COMPRESSION, NULL };
 
-    /* Get md5 representation of path */
-    md5 = thumb_cache_md5_uri (file_multi_get_uri (file));
+    /* Get string representation for file info */
+    g_snprintf (size, sizeof (size), "%li", file_multi_get_size (file));
+    g_snprintf (mtime, sizeof (mtime), "%li", file_multi_get_mtime (file));
+    g_snprintf (width, sizeof (width), "%d", info->width);
+    g_snprintf (height, sizeof (height), "%d", info->height);
 
-    /* Build path to thumb file */
-    md5_path = g_strjoin (NULL, g_get_home_dir (),
-                          THUMB_CACHE_PATH, md5, ".png", NULL);
+    thumb_cache_save_push (file, tier, thumb, keys, values);
+}
+
+/**
+ * Records that file failed to load, an empty image with the URI and
+ * mtime of the file is saved in the failure tier.
+ *
+ * @param file Original file.
+ */
+void
+thumb_cache_save_fail (struct file_multi *file)
+{
+    GdkPixbuf *empty;
+    gchar mtime[THUMB_NUM_SIZE];
+    gchar *keys[] = { "tEXt::Thumb::URI", "tEXt::Thumb::MTime",
+                      "compression", NULL };
+    gchar *values[] = { (gchar*) file_multi_get_uri (file), mtime,
+                        THUMB_WRITER_COMPRESSION, NULL };
+
+    g_snprintf (mtime, sizeof (mtime), "%li", file_multi_get_mtime (file));
+
+    empty = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8, 1, 1);
+    gdk_pixbuf_fill (empty, 0);
+    thumb_cache_save_push (file, THUMB_TIER_FAIL, empty, keys, values);
+    g_object_unref (empty);
+}
+
+/**
+ * Queues cache entry for writing.
+ *
+ * @param file Original file.
+ * @param tier Cache tier to save to.
+ * @param thumb Pointer GdkPixbuf to save.
+ * @param keys NULL terminated array of PNG save option keys.
+ * @param values NULL terminated array of PNG save option values.
+ */
+void
+thumb_cache_save_push (struct file_multi *file, gint tier, GdkPixbuf *thumb,
+                       gchar **keys, gchar **values)
+{
+    gchar thumb_path[THUMB_PATH_MAX];
+
+    if (! thumb_cache_writer) {
+        return;
+    }
 
+    /* Make sure directory for saving exists */
+    if (! thumb_cache_save_create_directory (tier)) {
+        return;
+    }
 
-    /* Clean up */
-    g_free (md5);
+    /* Get thumbnail file */
+    thumb_cache_path (file, tier, thumb_path);
 
-    return md5_path;
+    thumb_writer_push (thumb_cache_writer, thumb_path, thumb, keys, values,
+                       thumb_cache_index[tier], file_multi_get_digest (file));
 }
 
 /**
- * Creates HEX string representation of md5 value for uri.
+ * Makes sure thumbnail directory for tier exists.
  *
- * @param uri URI to MD5ify
- * @return String representation of MD5.
+ * @param tier Cache tier to create directory for.
+ * @return Returns TRUE if it exists (or has been created), else FALSE.
  */
-gchar*
-thumb_cache_md5_uri (const gchar *uri)
+gboolean
+thumb_cache_save_create_directory (gint tier)
 {
-    gint i;
-    gchar *md5;
+    static gboolean tried[THUMB_CACHE_DIRS] = { FALSE };
+    static gboolean status[THUMB_CACHE_DIRS] = { FALSE };
 
-    md5_state_t pms;
-    md5_byte_t digest[16];
+    if (! tried[tier]) {
+        /* Set tried flag */
+        tried[tier] = TRUE;
 
-    /* Generate md5 sum. */
-    md5_init (&pms);
-    md5_append (&pms, (guchar*) uri, strlen (uri));
-    md5_finish (&pms, digest);
+        /* Creates the base thumbnail dir as well */
+        status[tier] = g_mkdir_with_parents (thumb_cache_dir (tier),
+                                             0700) != -1;
+    }
 
-    /* Print md5 hex. */
-    md5 = g_malloc (sizeof (char) * 33);
+    return status[tier];
+}
 
-    for (i = 0; i < 16; i++) {
-        g_sprintf (md5 + i * 2, "%02x", digest[i]);
+/**
+ * Returns the thumbnail cache directory for tier, built once.
+ *
+ * @param tier Cache tier to get directory for.
+ * @return Path to thumbnail cache directory, must not be freed.
+ */
+const gchar*
+thumb_cache_dir (gint tier)
+{
+    static gsize dirs[THUMB_CACHE_DIRS] = { 0 };
+
+    if (g_once_init_enter (&dirs[tier])) {
+        g_once_init_leave (&dirs[tier],
+                           (gsize) g_build_filename (g_get_user_cache_dir (),
+                                                     THUMB_CACHE_PATH_BASE,
+                                                     thumb_tiers[tier].name,
+                                                     NULL));
     }
 
-    /* Terminate string */
-    md5[32] = '\0';
-  
-    return md5;
-} 
+    return (const gchar*) dirs[tier];
+}
+
+/**
+ * Builds path to thumbnail file for file.
+ *
+ * @param file File to get thumbnail file for.
+ * @param tier Cache tier to get thumbnail file in.
+ * @param path Buffer of THUMB_PATH_MAX bytes to write path to.
+ */
+void
+thumb_cache_path (struct file_multi *file, gint tier, gchar *path)
+{
+    gchar md5[MD5_HEX_SIZE];
+
+    /* Get md5 representation of uri, digest is kept on the file */
+    md5_hex (file_multi_get_digest (file), md5);
+
+    /* Build path to thumb file */
+    g_snprintf (path, THUMB_PATH_MAX, "%s" G_DIR_SEPARATOR_S "%s.png",
+                thumb_cache_dir (tier), md5);
+}
 
 /**
  * Callback used when loading images making sure they are of the correct
@@ -381,16 +1007,21 @@ thumb_cache_md5_uri (const gchar *uri)
  * @param loader Loader used to signal.
  * @param width Width of image being loaded.
  * @param height Height of image being loaded.
- * @param user_data User supplied data (pointer to side size)
+ * @param user_data Pointer to struct thumb_image_info.
  */
 void
 thumb_callback_size_prepared (GdkPixbufLoader *loader,
                               gint width, gint height, gpointer user_data)
 {
     /* Get side and calculate ratio */
-    guint side = *((guint*) user_data);
+    struct thumb_image_info *info = (struct thumb_image_info*) user_data;
+    guint side = info->side;
     gfloat ratio;
 
+    /* Keep original size for the cache entry */
+    info->width = width;
+    info->height = height;
+
     /* Nothing to do, image fits in thumbnail size */
     if ((width <= side) && (height <= side)) {
         return;
@@ -37,13 +37,26 @@
 
 #include "file_multi.h"
 
-#define THUMB_CACHE_PATH_BASE "/.thumbnails/"
-#define THUMB_CACHE_PATH "/.thumbnails/normal/"
+#define THUMB_CACHE_PATH_BASE "thumbnails"
+#define THUMB_CACHE_FAIL "fail"
 
 #define THUMB_DEFAULT_SIDE 128
 #define THUMB_LARGE_SIDE 256
+#define THUMB_XLARGE_SIDE 512
+#define THUMB_XXLARGE_SIDE 1024
+
+#define THUMB_FLAG_PACK (1 << 0) /**< Use packed thumbnail store. */
+#define THUMB_FLAG_WAIT_WRITES (1 << 1) /**< Never drop cache writes. */
+
+extern void thumb_init (guint flags);
+extern void thumb_shutdown (void);
 
 extern GdkPixbuf *thumb_get (struct file_multi *file,
                              guint side, gboolean cache);
+extern gboolean thumb_is_cached (struct file_multi *file, guint side);
+extern gboolean thumb_is_failed (struct file_multi *file);
+extern gboolean thumb_need_read (struct file_multi *file, guint side);
+extern gint thumb_pending_writes (void);
+extern guint thumb_purge_failed (void);
 
 #endif /* _THUMB_H_ */
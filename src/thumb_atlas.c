@@ -0,0 +1,450 @@
+/*
+ * Copyright (C) 2026 Claes Nästén <pekdon@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * Compact storage of displayed thumbnails.
+ *
+ * Thumbnails are copied into large shared pages instead of being kept
+ * as one pixbuf object each. Rows are stored without padding and the
+ * alpha channel is dropped from opaque thumbnails, a 128 pixel JPEG
+ * thumbnail takes 48 KiB instead of 64 KiB. Thumbnails that are
+ * off-screen can in addition be deflate compressed in place.
+ *
+ * Pages are allocated from front to back and freed once all of their
+ * thumbnails have been released. Thumbnails are loaded and released in
+ * scroll order so pages empty out as the view moves on.
+ *
+ * Only used from the main thread.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <string.h>
+
+#include "thumb_atlas.h"
+
+/**
+ * Page thumbnails are allocated from.
+ */
+struct thumb_atlas_page {
+    guchar *data; /**< Page data. */
+    gsize size; /**< Size of page data. */
+    gsize used; /**< Bytes allocated from the front of the page. */
+    guint live; /**< Number of entries with data in page. */
+};
+
+static guchar *thumb_atlas_alloc (struct thumb_atlas *atlas,
+                                  struct thumb_atlas_entry *entry,
+                                  gsize size);
+static void thumb_atlas_page_release (struct thumb_atlas *atlas,
+                                      struct thumb_atlas_page *page);
+static gboolean thumb_atlas_convert (GConverter *converter,
+                                     const guchar *in, gsize in_size,
+                                     guchar *out, gsize out_size,
+                                     gsize *written);
+static gboolean thumb_atlas_is_opaque (GdkPixbuf *pixbuf);
+static void thumb_atlas_free_pixels (guchar *pixels, gpointer data);
+
+/**
+ * Creates new thumbnail atlas.
+ *
+ * @return Pointer to struct thumb_atlas.
+ */
+struct thumb_atlas*
+thumb_atlas_new (void)
+{
+    struct thumb_atlas *atlas;
+
+    atlas = g_malloc0 (sizeof (struct thumb_atlas));
+
+    return atlas;
+}
+
+/**
+ * Frees thumbnail atlas, all entries must have been released.
+ *
+ * @param atlas Pointer to struct thumb_atlas to free.
+ */
+void
+thumb_atlas_free (struct thumb_atlas *atlas)
+{
+    if (atlas->page) {
+        g_free (atlas->page->data);
+        g_free (atlas->page);
+    }
+    if (atlas->compressor) {
+        g_object_unref (atlas->compressor);
+    }
+    if (atlas->decompressor) {
+        g_object_unref (atlas->decompressor);
+    }
+    g_free (atlas);
+}
+
+/**
+ * Copies thumbnail into the atlas, replacing data already in entry.
+ *
+ * @param atlas Pointer to struct thumb_atlas.
+ * @param entry Entry to store thumbnail in.
+ * @param pixbuf Thumbnail to store.
+ * @return TRUE if thumbnail was stored, FALSE if format is unsupported.
+ */
+gboolean
+thumb_atlas_put (struct thumb_atlas *atlas, struct thumb_atlas_entry *entry,
+                 GdkPixbuf *pixbuf)
+{
+    const guchar *src, *src_row;
+    guchar *dst;
+    gint x, y, width, height, rowstride, channels, src_channels;
+
+    thumb_atlas_release (atlas, entry);
+
+    if (gdk_pixbuf_get_colorspace (pixbuf) != GDK_COLORSPACE_RGB
+        || gdk_pixbuf_get_bits_per_sample (pixbuf) != 8) {
+        return FALSE;
+    }
+
+    width = gdk_pixbuf_get_width (pixbuf);
+    height = gdk_pixbuf_get_height (pixbuf);
+    rowstride = gdk_pixbuf_get_rowstride (pixbuf);
+    src_channels = gdk_pixbuf_get_n_channels (pixbuf);
+    src = gdk_pixbuf_get_pixels (pixbuf);
+    if (width > G_MAXUINT16 || height > G_MAXUINT16) {
+        return FALSE;
+    }
+
+    channels = src_channels == 4 && ! thumb_atlas_is_opaque (pixbuf) ? 4 : 3;
+    dst = thumb_atlas_alloc (atlas, entry, (gsize) width * height * channels);
+    entry->width = width;
+    entry->height = height;
+    entry->has_alpha = channels == 4;
+    entry->compressed = FALSE;
+
+    for (y = 0; y < height; y++) {
+        src_row = src + (gsize) y * rowstride;
+        if (src_channels == channels) {
+            memcpy (dst, src_row, (gsize) width * channels);
+            dst += width * channels;
+        } else {
+            for (x = 0; x < width; x++) {
+                *dst++ = src_row[x * src_channels];
+                *dst++ = src_row[x * src_channels + 1];
+                *dst++ = src_row[x * src_channels + 2];
+            }
+        }
+    }
+
+    atlas->stat_entries++;
+    atlas->stat_rgba += (guint64) width * height * 4;
+
+    return TRUE;
+}
+
+/**
+ * Releases data of entry, the entry is left empty.
+ *
+ * @param atlas Pointer to struct thumb_atlas.
+ * @param entry Entry to release.
+ */
+void
+thumb_atlas_release (struct thumb_atlas *atlas,
+                     struct thumb_atlas_entry *entry)
+{
+    if (entry->page) {
+        thumb_atlas_page_release (atlas, entry->page);
+        entry->page = NULL;
+
+        atlas->stat_entries--;
+        atlas->stat_rgba -= (guint64) entry->width * entry->height * 4;
+        atlas->stat_packed -= entry->size;
+        if (entry->compressed) {
+            atlas->stat_compressed--;
+        }
+    }
+}
+
+/**
+ * Gets pixbuf for entry. Uncompressed entries reference the atlas
+ * page directly, the pixbuf must not be used after the entry changes.
+ *
+ * @param atlas Pointer to struct thumb_atlas.
+ * @param entry Entry to get pixbuf for.
+ * @return Pixbuf, NULL if entry is empty.
+ */
+GdkPixbuf*
+thumb_atlas_get (struct thumb_atlas *atlas, struct thumb_atlas_entry *entry)
+{
+    guchar *data, *pixels;
+    gint rowstride;
+    gsize size, written;
+
+    if (! entry->page) {
+        return NULL;
+    }
+
+    data = entry->page->data + entry->offset;
+    rowstride = entry->width * (entry->has_alpha ? 4 : 3);
+    if (! entry->compressed) {
+        return gdk_pixbuf_new_from_data (data, GDK_COLORSPACE_RGB,
+                                         entry->has_alpha, 8,
+                                         entry->width, entry->height,
+                                         rowstride, NULL, NULL);
+    }
+
+    if (! atlas->decompressor) {
+        atlas->decompressor = G_CONVERTER (
+            g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_RAW));
+    }
+
+    size = (gsize) rowstride * entry->height;
+    pixels = g_malloc (size);
+    if (! thumb_atlas_convert (atlas->decompressor, data, entry->size,
+                               pixels, size, &written)
+        || written != size) {
+        g_free (pixels);
+        return NULL;
+    }
+
+    return gdk_pixbuf_new_from_data (pixels, GDK_COLORSPACE_RGB,
+                                     entry->has_alpha, 8,
+                                     entry->width, entry->height,
+                                     rowstride, &thumb_atlas_free_pixels,
+                                     NULL);
+}
+
+/**
+ * Compresses entry, entries that do not get smaller are kept as is.
+ *
+ * @param atlas Pointer to struct thumb_atlas.
+ * @param entry Entry to compress.
+ * @return TRUE if entry is compressed, else FALSE.
+ */
+gboolean
+thumb_atlas_compress (struct thumb_atlas *atlas,
+                      struct thumb_atlas_entry *entry)
+{
+    struct thumb_atlas_entry old = *entry;
+    guchar *buf;
+    gsize written;
+
+    if (! entry->page || entry->compressed) {
+        return entry->compressed;
+    }
+
+    if (! atlas->compressor) {
+        atlas->compressor = G_CONVERTER (
+            g_zlib_compressor_new (G_ZLIB_COMPRESSOR_FORMAT_RAW,
+                                   THUMB_ATLAS_COMPRESSION));
+    }
+
+    /* Only accept output smaller than the input */
+    buf = g_malloc (old.size);
+    if (thumb_atlas_convert (atlas->compressor,
+                             old.page->data + old.offset, old.size,
+                             buf, old.size - 1, &written)) {
+        memcpy (thumb_atlas_alloc (atlas, entry, written), buf, written);
+        entry->compressed = TRUE;
+        thumb_atlas_page_release (atlas, old.page);
+
+        atlas->stat_compressed++;
+        atlas->stat_packed -= old.size;
+    }
+    g_free (buf);
+
+    return entry->compressed;
+}
+
+/**
+ * Expands compressed entry back to uncompressed pixels.
+ *
+ * @param atlas Pointer to struct thumb_atlas.
+ * @param entry Entry to expand.
+ * @return TRUE if entry is uncompressed, else FALSE.
+ */
+gboolean
+thumb_atlas_expand (struct thumb_atlas *atlas,
+                    struct thumb_atlas_entry *entry)
+{
+    struct thumb_atlas_entry old = *entry;
+    GdkPixbuf *pixbuf;
+
+    if (! entry->page || ! entry->compressed) {
+        return entry->page != NULL;
+    }
+
+    pixbuf = thumb_atlas_get (atlas, &old);
+    if (! pixbuf) {
+        return FALSE;
+    }
+
+    memcpy (thumb_atlas_alloc (atlas, entry,
+                               (gsize) gdk_pixbuf_get_rowstride (pixbuf)
+                               * old.height),
+            gdk_pixbuf_get_pixels (pixbuf),
+            (gsize) gdk_pixbuf_get_rowstride (pixbuf) * old.height);
+    entry->compressed = FALSE;
+    thumb_atlas_page_release (atlas, old.page);
+    g_object_unref (pixbuf);
+
+    atlas->stat_compressed--;
+    atlas->stat_packed -= old.size;
+
+    return TRUE;
+}
+
+/**
+ * Allocates data for entry, starting a new page if the current page is
+ * full.
+ *
+ * @param atlas Pointer to struct thumb_atlas.
+ * @param entry Entry to allocate data for, page, offset and size set.
+ * @param size Number of bytes to allocate.
+ * @return Pointer to allocated data.
+ */
+guchar*
+thumb_atlas_alloc (struct thumb_atlas *atlas, struct thumb_atlas_entry *entry,
+                   gsize size)
+{
+    struct thumb_atlas_page *page = atlas->page;
+
+    if (! page || page->used + size > page->size) {
+        /* Full pages are freed by their last entry */
+        if (page && ! page->live) {
+            atlas->stat_pages -= page->size;
+            g_free (page->data);
+            g_free (page);
+        }
+
+        page = g_malloc (sizeof (struct thumb_atlas_page));
+        page->size = MAX (THUMB_ATLAS_PAGE_SIZE, size);
+        page->data = g_malloc (page->size);
+        page->used = 0;
+        page->live = 0;
+        atlas->page = page;
+        atlas->stat_pages += page->size;
+    }
+
+    entry->page = page;
+    entry->offset = page->used;
+    entry->size = size;
+    atlas->stat_packed += size;
+
+    page->used += size;
+    page->live++;
+
+    return page->data + entry->offset;
+}
+
+/**
+ * Releases an entry from page, freeing the page once empty. The
+ * current page is reused from the start instead.
+ *
+ * @param atlas Pointer to struct thumb_atlas.
+ * @param page Page entry was allocated from.
+ */
+void
+thumb_atlas_page_release (struct thumb_atlas *atlas,
+                          struct thumb_atlas_page *page)
+{
+    if (--page->live) {
+        return;
+    }
+
+    if (page == atlas->page) {
+        page->used = 0;
+    } else {
+        atlas->stat_pages -= page->size;
+        g_free (page->data);
+        g_free (page);
+    }
+}
+
+/**
+ * Runs converter over complete input.
+ *
+ * @param converter Converter to use, reset before use.
+ * @param in Input data.
+ * @param in_size Size of input data.
+ * @param out Output buffer.
+ * @param out_size Size of output buffer.
+ * @param written Set to the number of bytes written.
+ * @return TRUE if all output fit the output buffer, else FALSE.
+ */
+gboolean
+thumb_atlas_convert (GConverter *converter,
+                     const guchar *in, gsize in_size,
+                     guchar *out, gsize out_size, gsize *written)
+{
+    GConverterResult result;
+    gsize read;
+
+    g_converter_reset (converter);
+    result = g_converter_convert (converter, in, in_size, out, out_size,
+                                  G_CONVERTER_INPUT_AT_END,
+                                  &read, written, NULL);
+
+    return result == G_CONVERTER_FINISHED;
+}
+
+/**
+ * Checks if all pixels of pixbuf with alpha channel are opaque.
+ *
+ * @param pixbuf Pixbuf with alpha channel.
+ * @return TRUE if all pixels are opaque, else FALSE.
+ */
+gboolean
+thumb_atlas_is_opaque (GdkPixbuf *pixbuf)
+{
+    const guchar *row;
+    gint x, y, width, height, rowstride;
+
+    width = gdk_pixbuf_get_width (pixbuf);
+    height = gdk_pixbuf_get_height (pixbuf);
+    rowstride = gdk_pixbuf_get_rowstride (pixbuf);
+    row = gdk_pixbuf_get_pixels (pixbuf);
+
+    for (y = 0; y < height; y++, row += rowstride) {
+        for (x = 0; x < width; x++) {
+            if (row[x * 4 + 3] != 0xff) {
+                return FALSE;
+            }
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ * Frees pixels of decompressed pixbuf.
+ *
+ * @param pixels Pixels to free.
+ * @param data Not used.
+ */
+void
+thumb_atlas_free_pixels (guchar *pixels, gpointer data)
+{
+    g_free (pixels);
+}
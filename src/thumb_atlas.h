@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2026 Claes Nästén <pekdon@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * Compact storage of displayed thumbnails.
+ */
+
+#ifndef _THUMB_ATLAS_H_
+#define _THUMB_ATLAS_H_
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <gio/gio.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#define THUMB_ATLAS_PAGE_SIZE (2 * 1024 * 1024)
+#define THUMB_ATLAS_COMPRESSION 1
+
+struct thumb_atlas_page;
+
+/**
+ * Thumbnail stored in an atlas page, pixels are packed without row
+ * padding and without alpha channel for opaque thumbnails.
+ */
+struct thumb_atlas_entry {
+    struct thumb_atlas_page *page; /**< Page holding data, NULL if empty. */
+    guint32 offset; /**< Offset of data in page. */
+    guint32 size; /**< Size of data in page. */
+    guint16 width; /**< Width of thumbnail. */
+    guint16 height; /**< Height of thumbnail. */
+    guint8 has_alpha; /**< Set if pixels have an alpha channel. */
+    guint8 compressed; /**< Set if data is deflate compressed. */
+};
+
+/**
+ * Pages thumbnails are allocated from, pages are freed once all of
+ * their thumbnails have been released. Statistics cover the thumbnails
+ * currently stored.
+ */
+struct thumb_atlas {
+    struct thumb_atlas_page *page; /**< Page allocations are made from. */
+    GConverter *compressor; /**< Compressor for off-screen entries. */
+    GConverter *decompressor; /**< Decompressor for compressed entries. */
+
+    guint stat_entries; /**< Number of thumbnails stored. */
+    guint stat_compressed; /**< Number of stored thumbnails compressed. */
+    guint64 stat_rgba; /**< Bytes of stored thumbnails as RGBA pixbufs. */
+    guint64 stat_packed; /**< Bytes of stored thumbnails in pages. */
+    guint64 stat_pages; /**< Bytes of allocated pages. */
+};
+
+extern struct thumb_atlas *thumb_atlas_new (void);
+extern void thumb_atlas_free (struct thumb_atlas *atlas);
+
+extern gboolean thumb_atlas_put (struct thumb_atlas *atlas,
+                                 struct thumb_atlas_entry *entry,
+                                 GdkPixbuf *pixbuf);
+extern void thumb_atlas_release (struct thumb_atlas *atlas,
+                                 struct thumb_atlas_entry *entry);
+extern GdkPixbuf *thumb_atlas_get (struct thumb_atlas *atlas,
+                                   struct thumb_atlas_entry *entry);
+
+extern gboolean thumb_atlas_compress (struct thumb_atlas *atlas,
+                                      struct thumb_atlas_entry *entry);
+extern gboolean thumb_atlas_expand (struct thumb_atlas *atlas,
+                                    struct thumb_atlas_entry *entry);
+
+#endif /* _THUMB_ATLAS_H_ */
@@ -0,0 +1,786 @@
+/*
+ * Copyright (C) 2026 Claes Nästén <pekdon@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * Virtualized grid of thumbnails.
+ *
+ * All cells have the same size so the position of a cell follows from
+ * its index and the number of columns, nothing is measured per cell.
+ * Drawing only visits the cells intersecting the exposed area which
+ * keeps layout and drawing independent of the number of files.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <string.h>
+
+#include <gdk/gdkkeysyms.h>
+
+#include "thumb_grid.h"
+
+/* Compatibility with older gtk+ versions */
+#ifndef GDK_KEY_Left
+    #define GDK_KEY_Left GDK_Left
+    #define GDK_KEY_Right GDK_Right
+    #define GDK_KEY_Up GDK_Up
+    #define GDK_KEY_Down GDK_Down
+    #define GDK_KEY_Home GDK_Home
+    #define GDK_KEY_End GDK_End
+    #define GDK_KEY_Return GDK_Return
+    #define GDK_KEY_KP_Enter GDK_KP_Enter
+#endif
+
+static void thumb_grid_update_layout (struct thumb_grid *grid);
+static void thumb_grid_render (struct thumb_grid *grid, cairo_t *cr);
+static void thumb_grid_invalidate (struct thumb_grid *grid, gint index);
+static void thumb_grid_scroll_adjustment (GtkAdjustment *adjustment,
+                                          gdouble start, gdouble size,
+                                          gboolean center);
+
+/* Callbacks */
+#if GTK_CHECK_VERSION(3, 0, 0)
+static gboolean callback_grid_draw (GtkWidget *widget, cairo_t *cr,
+                                    gpointer data);
+#else /* GTK < 3 */
+static gboolean callback_grid_expose (GtkWidget *widget,
+                                      GdkEventExpose *event, gpointer data);
+#endif
+static void callback_grid_allocate (GtkWidget *widget,
+                                    GtkAllocation *allocation, gpointer data);
+static gboolean callback_grid_button (GtkWidget *widget,
+                                      GdkEventButton *event, gpointer data);
+static gboolean callback_grid_key (GtkWidget *widget,
+                                   GdkEventKey *event, gpointer data);
+
+/**
+ * Creates new thumbnail grid.
+ *
+ * @param side Maximum side of thumbnails.
+ * @param padding Space around thumbnails.
+ * @param activate Called when a cell is activated.
+ * @param data User data for activate.
+ * @return Pointer to struct thumb_grid.
+ */
+struct thumb_grid*
+thumb_grid_new (guint side, guint padding,
+                thumb_grid_activate_func activate, gpointer data)
+{
+    struct thumb_grid *grid;
+    gint text_height;
+
+    grid = g_malloc (sizeof (struct thumb_grid));
+    grid->items = g_array_new (FALSE, FALSE, sizeof (struct thumb_grid_item));
+    grid->atlas = thumb_atlas_new ();
+    grid->side = side;
+    grid->padding = padding;
+    grid->columns = 1;
+    grid->single_row = FALSE;
+    grid->selected = -1;
+    grid->scroll_to = -1;
+    grid->scroll_center = FALSE;
+    grid->activate = activate;
+    grid->activate_data = data;
+
+    grid->window = GTK_SCROLLED_WINDOW (gtk_scrolled_window_new (NULL, NULL));
+    gtk_scrolled_window_set_policy (grid->window,
+                                    GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+
+    grid->layout = GTK_LAYOUT (gtk_layout_new (NULL, NULL));
+    gtk_widget_set_can_focus (GTK_WIDGET (grid->layout), TRUE);
+    gtk_widget_add_events (GTK_WIDGET (grid->layout),
+                           GDK_BUTTON_PRESS_MASK | GDK_KEY_PRESS_MASK);
+    gtk_container_add (GTK_CONTAINER (grid->window),
+                       GTK_WIDGET (grid->layout));
+
+    /* Names are ellipsized to the cell width, one line high */
+    grid->text = gtk_widget_create_pango_layout (GTK_WIDGET (grid->layout),
+                                                 "Ag");
+    pango_layout_get_pixel_size (grid->text, NULL, &text_height);
+    pango_layout_set_width (grid->text, (side + padding) * PANGO_SCALE);
+    pango_layout_set_ellipsize (grid->text, PANGO_ELLIPSIZE_END);
+    pango_layout_set_alignment (grid->text, PANGO_ALIGN_CENTER);
+
+    grid->cell_width = side + padding;
+    grid->cell_height = side + padding + text_height;
+
+#if GTK_CHECK_VERSION(3, 0, 0)
+    g_signal_connect (grid->layout, "draw",
+                      G_CALLBACK (callback_grid_draw), grid);
+#else /* GTK < 3 */
+    g_signal_connect (grid->layout, "expose-event",
+                      G_CALLBACK (callback_grid_expose), grid);
+#endif
+    g_signal_connect (grid->layout, "size-allocate",
+                      G_CALLBACK (callback_grid_allocate), grid);
+    g_signal_connect (grid->layout, "button-press-event",
+                      G_CALLBACK (callback_grid_button), grid);
+    g_signal_connect (grid->layout, "key-press-event",
+                      G_CALLBACK (callback_grid_key), grid);
+
+    return grid;
+}
+
+/**
+ * Frees resources used by grid, widgets are destroyed with their
+ * parent.
+ *
+ * @param grid Pointer to struct thumb_grid to free.
+ */
+void
+thumb_grid_free (struct thumb_grid *grid)
+{
+    struct thumb_grid_item *item;
+    guint i;
+
+    for (i = 0; i < grid->items->len; i++) {
+        item = &g_array_index (grid->items, struct thumb_grid_item, i);
+        thumb_atlas_release (grid->atlas, &item->thumb);
+    }
+    g_array_free (grid->items, TRUE);
+    thumb_atlas_free (grid->atlas);
+    g_object_unref (grid->text);
+
+    g_free (grid);
+}
+
+/**
+ * Returns the top level widget of the grid.
+ *
+ * @param grid Pointer to struct thumb_grid.
+ * @return Scrolled window holding the grid.
+ */
+GtkWidget*
+thumb_grid_get_widget (struct thumb_grid *grid)
+{
+    return GTK_WIDGET (grid->window);
+}
+
+/**
+ * Lays out all cells in a single row or in as many columns as fit the
+ * width of the grid.
+ *
+ * @param grid Pointer to struct thumb_grid.
+ * @param single_row TRUE to lay out all cells in a single row.
+ */
+void
+thumb_grid_set_single_row (struct thumb_grid *grid, gboolean single_row)
+{
+    grid->single_row = single_row;
+    thumb_grid_update_layout (grid);
+}
+
+/**
+ * Appends cell to the grid.
+ *
+ * @param grid Pointer to struct thumb_grid.
+ * @param file File displayed in cell.
+ * @param thumb Thumbnail, copied, or NULL.
+ * @param state Initial state of cell.
+ * @return Index of the added cell.
+ */
+gint
+thumb_grid_append (struct thumb_grid *grid, struct file_multi *file,
+                   GdkPixbuf *thumb, gint state)
+{
+    struct thumb_grid_item item;
+
+    memset (&item, 0, sizeof (item));
+    item.file = file;
+    item.state = state;
+    g_array_append_val (grid->items, item);
+    if (thumb) {
+        thumb_atlas_put (grid->atlas,
+                         &g_array_index (grid->items, struct thumb_grid_item,
+                                         grid->items->len - 1).thumb,
+                         thumb);
+    }
+
+    thumb_grid_update_layout (grid);
+    thumb_grid_invalidate (grid, grid->items->len - 1);
+
+    return grid->items->len - 1;
+}
+
+/**
+ * Returns the number of cells in the grid.
+ *
+ * @param grid Pointer to struct thumb_grid.
+ * @return Number of cells.
+ */
+guint
+thumb_grid_get_count (struct thumb_grid *grid)
+{
+    return grid->items->len;
+}
+
+/**
+ * Returns the file of a cell.
+ *
+ * @param grid Pointer to struct thumb_grid.
+ * @param index Index of cell.
+ * @return File of cell, NULL if index is out of range.
+ */
+struct file_multi*
+thumb_grid_get_file (struct thumb_grid *grid, gint index)
+{
+    if (index < 0 || index >= grid->items->len) {
+        return NULL;
+    }
+    return g_array_index (grid->items, struct thumb_grid_item, index).file;
+}
+
+/**
+ * Returns the state of a cell.
+ *
+ * @param grid Pointer to struct thumb_grid.
+ * @param index Index of cell.
+ * @return State of cell, -1 if index is out of range.
+ */
+gint
+thumb_grid_get_state (struct thumb_grid *grid, gint index)
+{
+    if (index < 0 || index >= grid->items->len) {
+        return -1;
+    }
+    return g_array_index (grid->items, struct thumb_grid_item, index).state;
+}
+
+/**
+ * Returns the thumbnail of a cell.
+ *
+ * @param grid Pointer to struct thumb_grid.
+ * @param index Index of cell.
+ * @return New reference to thumbnail, may share pixels with the grid so
+ *         it must not be kept past changes to the cell. NULL if not loaded.
+ */
+GdkPixbuf*
+thumb_grid_get_thumb (struct thumb_grid *grid, gint index)
+{
+    if (index < 0 || index >= grid->items->len) {
+        return NULL;
+    }
+    return thumb_atlas_get (grid->atlas,
+                            &g_array_index (grid->items,
+                                            struct thumb_grid_item,
+                                            index).thumb);
+}
+
+/**
+ * Sets the thumbnail and state of a cell, redrawing it if visible.
+ *
+ * @param grid Pointer to struct thumb_grid.
+ * @param index Index of cell.
+ * @param thumb Thumbnail, copied, or NULL to release it.
+ * @param state State of cell.
+ */
+void
+thumb_grid_set_thumb (struct thumb_grid *grid, gint index,
+                      GdkPixbuf *thumb, gint state)
+{
+    struct thumb_grid_item *item;
+
+    if (index < 0 || index >= grid->items->len) {
+        return;
+    }
+
+    item = &g_array_index (grid->items, struct thumb_grid_item, index);
+    if (thumb) {
+        thumb_atlas_put (grid->atlas, &item->thumb, thumb);
+    } else {
+        thumb_atlas_release (grid->atlas, &item->thumb);
+    }
+    item->state = state;
+
+    thumb_grid_invalidate (grid, index);
+}
+
+/**
+ * Compresses the thumbnail of an off-screen cell, or expands it again
+ * before it is displayed.
+ *
+ * @param grid Pointer to struct thumb_grid.
+ * @param index Index of cell.
+ * @param compress TRUE to compress, FALSE to expand.
+ */
+void
+thumb_grid_compress (struct thumb_grid *grid, gint index, gboolean compress)
+{
+    struct thumb_grid_item *item;
+
+    if (index < 0 || index >= grid->items->len) {
+        return;
+    }
+
+    item = &g_array_index (grid->items, struct thumb_grid_item, index);
+    if (compress) {
+        thumb_atlas_compress (grid->atlas, &item->thumb);
+    } else {
+        thumb_atlas_expand (grid->atlas, &item->thumb);
+    }
+}
+
+/**
+ * Gets the range of cells visible in the scrolled window.
+ *
+ * @param grid Pointer to struct thumb_grid.
+ * @param first Set to the first visible cell.
+ * @param last Set to the last visible cell.
+ * @return TRUE if any cell is visible, else FALSE.
+ */
+gboolean
+thumb_grid_get_visible_range (struct thumb_grid *grid,
+                              gint *first, gint *last)
+{
+    GtkAdjustment *hadj, *vadj;
+    gdouble x, y, width, height;
+    gint col_first, col_last, row_first, row_last;
+
+    hadj = gtk_scrolled_window_get_hadjustment (grid->window);
+    vadj = gtk_scrolled_window_get_vadjustment (grid->window);
+    x = gtk_adjustment_get_value (hadj);
+    y = gtk_adjustment_get_value (vadj);
+    width = gtk_adjustment_get_page_size (hadj);
+    height = gtk_adjustment_get_page_size (vadj);
+
+    if (grid->items->len == 0 || width < 1 || height < 1) {
+        return FALSE;
+    }
+
+    col_first = x / grid->cell_width;
+    col_last = MIN (grid->columns - 1, (x + width - 1) / grid->cell_width);
+    row_first = y / grid->cell_height;
+    row_last = (y + height - 1) / grid->cell_height;
+
+    *first = row_first * grid->columns + col_first;
+    *last = MIN (grid->items->len - 1,
+                 row_last * grid->columns + col_last);
+
+    return col_first <= col_last && *first <= *last;
+}
+
+/**
+ * Returns the selected cell.
+ *
+ * @param grid Pointer to struct thumb_grid.
+ * @return Index of selected cell, -1 if none.
+ */
+gint
+thumb_grid_get_selected (struct thumb_grid *grid)
+{
+    return grid->selected;
+}
+
+/**
+ * Selects a cell.
+ *
+ * @param grid Pointer to struct thumb_grid.
+ * @param index Index of cell to select, -1 to clear selection.
+ */
+void
+thumb_grid_select (struct thumb_grid *grid, gint index)
+{
+    thumb_grid_invalidate (grid, grid->selected);
+    grid->selected = index;
+    thumb_grid_invalidate (grid, grid->selected);
+}
+
+/**
+ * Moves the selection with arrow keys, Home and End and activates the
+ * selected cell with Return while the grid has focus. Windows with
+ * their own shortcuts for these keys call this before handling them,
+ * their handlers run before the ones of the focused widget.
+ *
+ * @param grid Pointer to struct thumb_grid.
+ * @param event Key event.
+ * @return TRUE if the key was handled, else FALSE.
+ */
+gboolean
+thumb_grid_key_press (struct thumb_grid *grid, GdkEventKey *event)
+{
+    gint index, last = (gint) grid->items->len - 1;
+
+    if (last < 0 || ! gtk_widget_has_focus (GTK_WIDGET (grid->layout))) {
+        return FALSE;
+    }
+
+    /* Without a selection any movement starts from the first cell */
+    index = grid->selected;
+    switch (event->keyval) {
+    case GDK_KEY_Left:
+        index = MAX (index - 1, 0);
+        break;
+    case GDK_KEY_Right:
+        index = MIN (index + 1, last);
+        break;
+    case GDK_KEY_Up:
+        if (index >= (gint) grid->columns) {
+            index -= grid->columns;
+        }
+        index = MAX (index, 0);
+        break;
+    case GDK_KEY_Down:
+        if (index < 0) {
+            index = 0;
+        } else if (index + (gint) grid->columns <= last) {
+            index += grid->columns;
+        }
+        break;
+    case GDK_KEY_Home:
+        index = 0;
+        break;
+    case GDK_KEY_End:
+        index = last;
+        break;
+    case GDK_KEY_Return:
+    case GDK_KEY_KP_Enter:
+        if (grid->selected >= 0 && grid->activate) {
+            grid->activate (grid, grid->selected, grid->activate_data);
+        }
+        return TRUE;
+    default:
+        return FALSE;
+    }
+
+    if (index != grid->selected) {
+        thumb_grid_select (grid, index);
+    }
+    thumb_grid_scroll_to (grid, index, FALSE);
+
+    return TRUE;
+}
+
+/**
+ * Scrolls the grid to make a cell visible. The scroll is repeated on
+ * the next allocation as the size of the grid might be about to
+ * change.
+ *
+ * @param grid Pointer to struct thumb_grid.
+ * @param index Index of cell to scroll to.
+ * @param center TRUE to center cell, else scroll as little as possible.
+ */
+void
+thumb_grid_scroll_to (struct thumb_grid *grid, gint index, gboolean center)
+{
+    if (index < 0 || index >= grid->items->len) {
+        return;
+    }
+
+    thumb_grid_scroll_adjustment (
+        gtk_scrolled_window_get_hadjustment (grid->window),
+        (index % grid->columns) * grid->cell_width, grid->cell_width, center);
+    thumb_grid_scroll_adjustment (
+        gtk_scrolled_window_get_vadjustment (grid->window),
+        (index / grid->columns) * grid->cell_height, grid->cell_height,
+        center);
+
+    grid->scroll_to = index;
+    grid->scroll_center = center;
+}
+
+/**
+ * Scrolls adjustment to make range visible.
+ *
+ * @param adjustment Adjustment to scroll.
+ * @param start Start of range.
+ * @param size Size of range.
+ * @param center TRUE to center range, else scroll as little as possible.
+ */
+void
+thumb_grid_scroll_adjustment (GtkAdjustment *adjustment,
+                              gdouble start, gdouble size, gboolean center)
+{
+    gdouble value, page, upper;
+
+    value = gtk_adjustment_get_value (adjustment);
+    page = gtk_adjustment_get_page_size (adjustment);
+    upper = gtk_adjustment_get_upper (adjustment);
+
+    if (center) {
+        value = start - (page - size) / 2;
+    } else if (start < value) {
+        value = start;
+    } else if (start + size > value + page) {
+        value = start + size - page;
+    }
+
+    gtk_adjustment_set_value (adjustment,
+                              CLAMP (value, 0, MAX (0, upper - page)));
+}
+
+/**
+ * Computes the number of columns and sets the size of the layout from
+ * the number of cells.
+ *
+ * @param grid Pointer to struct thumb_grid.
+ */
+void
+thumb_grid_update_layout (struct thumb_grid *grid)
+{
+    GtkAllocation allocation;
+    guint columns, rows;
+
+    if (grid->single_row) {
+        columns = MAX (1, grid->items->len);
+    } else {
+        gtk_widget_get_allocation (GTK_WIDGET (grid->layout), &allocation);
+        columns = MAX (1, allocation.width / (gint) grid->cell_width);
+    }
+    rows = (grid->items->len + columns - 1) / columns;
+
+    if (columns != grid->columns) {
+        grid->columns = columns;
+        gtk_widget_queue_draw (GTK_WIDGET (grid->layout));
+    }
+    gtk_layout_set_size (grid->layout,
+                         MIN (columns, MAX (1, grid->items->len))
+                         * grid->cell_width,
+                         rows * grid->cell_height);
+}
+
+/**
+ * Draws the cells intersecting the clip area of cr.
+ *
+ * @param grid Pointer to struct thumb_grid.
+ * @param cr Cairo context in layout coordinates.
+ */
+void
+thumb_grid_render (struct thumb_grid *grid, cairo_t *cr)
+{
+    GtkWidget *widget = GTK_WIDGET (grid->layout);
+    struct thumb_grid_item *item;
+    GdkPixbuf *thumb;
+    gdouble x1, y1, x2, y2;
+    gint col, col_first, col_last, row, row_first, row_last, index;
+    gint x, y, width, height;
+#if GTK_CHECK_VERSION(3, 0, 0)
+    GtkStyleContext *style = gtk_widget_get_style_context (widget);
+#endif
+
+    if (grid->items->len == 0) {
+        return;
+    }
+
+    cairo_clip_extents (cr, &x1, &y1, &x2, &y2);
+    col_first = MAX (0, x1 / grid->cell_width);
+    col_last = MIN (grid->columns - 1, x2 / grid->cell_width);
+    row_first = MAX (0, y1 / grid->cell_height);
+    row_last = MIN ((grid->items->len - 1) / grid->columns,
+                    y2 / grid->cell_height);
+
+    for (row = row_first; row <= row_last; row++) {
+        for (col = col_first; col <= col_last; col++) {
+            index = row * grid->columns + col;
+            if (index >= grid->items->len) {
+                break;
+            }
+            item = &g_array_index (grid->items, struct thumb_grid_item, index);
+            x = col * grid->cell_width;
+            y = row * grid->cell_height;
+
+            if (index == grid->selected) {
+                cairo_set_source_rgba (cr, 0.3, 0.5, 0.9, 0.4);
+                cairo_rectangle (cr, x, y,
+                                 grid->cell_width, grid->cell_height);
+                cairo_fill (cr);
+            }
+
+            /* Thumbnail centered at the bottom of the thumbnail area */
+            thumb = thumb_atlas_get (grid->atlas, &item->thumb);
+            if (thumb) {
+                width = gdk_pixbuf_get_width (thumb);
+                height = gdk_pixbuf_get_height (thumb);
+                gdk_cairo_set_source_pixbuf (
+                    cr, thumb,
+                    x + (gint) (grid->cell_width - width) / 2,
+                    y + grid->padding / 2 + (gint) (grid->side - height));
+                cairo_rectangle (
+                    cr, x + (gint) (grid->cell_width - width) / 2,
+                    y + grid->padding / 2 + (gint) (grid->side - height),
+                    width, height);
+                cairo_fill (cr);
+                g_object_unref (thumb);
+            }
+
+            pango_layout_set_text (grid->text,
+                                   file_multi_get_name (item->file), -1);
+#if GTK_CHECK_VERSION(3, 0, 0)
+            gtk_render_layout (style, cr, x, y + grid->side + grid->padding,
+                               grid->text);
+#else /* GTK < 3 */
+            gdk_cairo_set_source_color (
+                cr, &gtk_widget_get_style (widget)->text[GTK_STATE_NORMAL]);
+            cairo_move_to (cr, x, y + grid->side + grid->padding);
+            pango_cairo_show_layout (cr, grid->text);
+#endif
+        }
+    }
+}
+
+/**
+ * Queues redraw of a cell.
+ *
+ * @param grid Pointer to struct thumb_grid.
+ * @param index Index of cell, ignored if out of range.
+ */
+void
+thumb_grid_invalidate (struct thumb_grid *grid, gint index)
+{
+    GdkWindow *window = gtk_layout_get_bin_window (grid->layout);
+    GdkRectangle rect;
+
+    if (! window || index < 0 || index >= grid->items->len) {
+        return;
+    }
+
+    rect.x = (index % grid->columns) * grid->cell_width;
+    rect.y = (index / grid->columns) * grid->cell_height;
+    rect.width = grid->cell_width;
+    rect.height = grid->cell_height;
+    gdk_window_invalidate_rect (window, &rect, FALSE);
+}
+
+#if GTK_CHECK_VERSION(3, 0, 0)
+/**
+ * Callback drawing the grid.
+ *
+ * @param widget Layout of grid.
+ * @param cr Cairo context to draw on.
+ * @param data Pointer to struct thumb_grid.
+ * @return FALSE to continue drawing.
+ */
+gboolean
+callback_grid_draw (GtkWidget *widget, cairo_t *cr, gpointer data)
+{
+    struct thumb_grid *grid = (struct thumb_grid*) data;
+    GdkWindow *window = gtk_layout_get_bin_window (grid->layout);
+
+    if (gtk_cairo_should_draw_window (cr, window)) {
+        cairo_save (cr);
+        gtk_cairo_transform_to_window (cr, widget, window);
+        thumb_grid_render (grid, cr);
+        cairo_restore (cr);
+    }
+
+    return FALSE;
+}
+#else /* GTK < 3 */
+/**
+ * Callback drawing the exposed area of the grid.
+ *
+ * @param widget Layout of grid.
+ * @param event Expose event.
+ * @param data Pointer to struct thumb_grid.
+ * @return FALSE to continue drawing.
+ */
+gboolean
+callback_grid_expose (GtkWidget *widget, GdkEventExpose *event,
+                      gpointer data)
+{
+    struct thumb_grid *grid = (struct thumb_grid*) data;
+    cairo_t *cr;
+
+    if (event->window == gtk_layout_get_bin_window (grid->layout)) {
+        cr = gdk_cairo_create (event->window);
+        gdk_cairo_region (cr, event->region);
+        cairo_clip (cr);
+        thumb_grid_render (grid, cr);
+        cairo_destroy (cr);
+    }
+
+    return FALSE;
+}
+#endif
+
+/**
+ * Callback for resizing of the grid, updates the number of columns.
+ *
+ * @param widget Layout of grid.
+ * @param allocation New allocation.
+ * @param data Pointer to struct thumb_grid.
+ */
+void
+callback_grid_allocate (GtkWidget *widget, GtkAllocation *allocation,
+                        gpointer data)
+{
+    struct thumb_grid *grid = (struct thumb_grid*) data;
+    gint index = grid->scroll_to;
+
+    thumb_grid_update_layout (grid);
+    if (index != -1) {
+        thumb_grid_scroll_to (grid, index, grid->scroll_center);
+        grid->scroll_to = -1;
+    }
+}
+
+/**
+ * Callback for button presses, selects the cell under the pointer and
+ * activates it on double click.
+ *
+ * @param widget Layout of grid.
+ * @param event Button event, coordinates relative to the layout.
+ * @param data Pointer to struct thumb_grid.
+ * @return TRUE if the event was handled, else FALSE.
+ */
+gboolean
+callback_grid_button (GtkWidget *widget, GdkEventButton *event,
+                      gpointer data)
+{
+    struct thumb_grid *grid = (struct thumb_grid*) data;
+    gint col, row, index;
+
+    if (event->button != 1 || event->x < 0 || event->y < 0) {
+        return FALSE;
+    }
+
+    col = event->x / grid->cell_width;
+    row = event->y / grid->cell_height;
+    index = row * grid->columns + col;
+    if (col >= grid->columns || index >= grid->items->len) {
+        return FALSE;
+    }
+
+    gtk_widget_grab_focus (widget);
+    thumb_grid_select (grid, index);
+    if (event->type == GDK_2BUTTON_PRESS && grid->activate) {
+        grid->activate (grid, index, grid->activate_data);
+    }
+
+    return TRUE;
+}
+
+/**
+ * Handles key presses on the layout.
+ *
+ * @param widget Layout of grid.
+ * @param event Key event.
+ * @param data Pointer to struct thumb_grid.
+ * @return TRUE if the event was handled, else FALSE.
+ */
+gboolean
+callback_grid_key (GtkWidget *widget, GdkEventKey *event, gpointer data)
+{
+    return thumb_grid_key_press ((struct thumb_grid*) data, event);
+}
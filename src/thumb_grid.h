@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2026 Claes Nästén <pekdon@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * Virtualized grid of thumbnails.
+ */
+
+#ifndef _THUMB_GRID_H_
+#define _THUMB_GRID_H_
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <gtk/gtk.h>
+
+#include "file_multi.h"
+#include "thumb_atlas.h"
+
+struct thumb_grid;
+
+/**
+ * Called when a cell is activated with a double click.
+ */
+typedef void (*thumb_grid_activate_func) (struct thumb_grid *grid,
+                                          gint index, gpointer data);
+
+/**
+ * Cell in the grid, only the thumbnails in use are kept.
+ */
+struct thumb_grid_item {
+    struct file_multi *file; /**< File displayed in cell. */
+    struct thumb_atlas_entry thumb; /**< Thumbnail, empty if not loaded. */
+    gint state; /**< State of thumbnail, owned by the user of the grid. */
+};
+
+/**
+ * Grid of fixed size cells, layout is computed from the cell index and
+ * only cells intersecting the exposed area are drawn.
+ */
+struct thumb_grid {
+    GtkScrolledWindow *window; /**< Scrolled window holding layout. */
+    GtkLayout *layout; /**< Layout cells are drawn on. */
+    PangoLayout *text; /**< Layout for drawing cell names. */
+    GArray *items; /**< Array of struct thumb_grid_item. */
+    struct thumb_atlas *atlas; /**< Storage of loaded thumbnails. */
+
+    guint side; /**< Maximum side of thumbnails. */
+    guint padding; /**< Space around thumbnails. */
+    guint cell_width; /**< Width of cell. */
+    guint cell_height; /**< Height of cell, thumbnail and name. */
+    guint columns; /**< Number of columns in current layout. */
+    gboolean single_row; /**< Set to TRUE to lay out all cells in a row. */
+
+    gint selected; /**< Selected cell, -1 if none. */
+    gint scroll_to; /**< Cell to scroll to on allocation, -1 if none. */
+    gboolean scroll_center; /**< Center scroll_to cell. */
+
+    thumb_grid_activate_func activate; /**< Activation callback. */
+    gpointer activate_data; /**< User data for activation callback. */
+};
+
+extern struct thumb_grid *thumb_grid_new (guint side, guint padding,
+                                          thumb_grid_activate_func activate,
+                                          gpointer data);
+extern void thumb_grid_free (struct thumb_grid *grid);
+
+extern GtkWidget *thumb_grid_get_widget (struct thumb_grid *grid);
+extern void thumb_grid_set_single_row (struct thumb_grid *grid,
+                                       gboolean single_row);
+
+extern gint thumb_grid_append (struct thumb_grid *grid,
+                               struct file_multi *file, GdkPixbuf *thumb,
+                               gint state);
+extern guint thumb_grid_get_count (struct thumb_grid *grid);
+extern struct file_multi *thumb_grid_get_file (struct thumb_grid *grid,
+                                               gint index);
+extern gint thumb_grid_get_state (struct thumb_grid *grid, gint index);
+extern GdkPixbuf *thumb_grid_get_thumb (struct thumb_grid *grid, gint index);
+extern void thumb_grid_set_thumb (struct thumb_grid *grid, gint index,
+                                  GdkPixbuf *thumb, gint state);
+extern void thumb_grid_compress (struct thumb_grid *grid, gint index,
+                                 gboolean compress);
+
+extern gboolean thumb_grid_get_visible_range (struct thumb_grid *grid,
+                                              gint *first, gint *last);
+extern gint thumb_grid_get_selected (struct thumb_grid *grid);
+extern void thumb_grid_select (struct thumb_grid *grid, gint index);
+extern gboolean thumb_grid_key_press (struct thumb_grid *grid,
+                                      GdkEventKey *event);
+extern void thumb_grid_scroll_to (struct thumb_grid *grid, gint index,
+                                  gboolean center);
+
+#endif /* _THUMB_GRID_H_ */
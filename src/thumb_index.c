@@ -0,0 +1,281 @@
+/*
+ * Copyright (C) 2026 Claes Nästén <pekdon@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * In-memory index of the on-disk thumbnail cache.
+ *
+ * The cache directory is read once in a background thread, entries
+ * are added to the index in batches as they are read. Until the whole
+ * directory is read a digest missing from the index is reported as
+ * unknown and the caller has to check the filesystem, after that
+ * negative lookups are answered from memory.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <glib.h>
+#include <string.h>
+
+#include "thumb_index.h"
+
+#define THUMB_INDEX_STORAGE 16384
+#define THUMB_INDEX_NAME_LEN 36 /* 32 hex digits and .png */
+
+static gpointer thumb_index_worker (struct thumb_index *index);
+static void thumb_index_insert (struct thumb_index *index,
+                                const md5_byte_t *digest);
+static gboolean thumb_index_parse (const gchar *name, md5_byte_t *digest);
+
+static guint thumb_index_hash (gconstpointer key);
+static gboolean thumb_index_equal (gconstpointer a, gconstpointer b);
+
+/**
+ * Creates index of cache directory and starts reading it.
+ *
+ * @param dir Cache directory to index.
+ * @return Pointer to struct thumb_index.
+ */
+struct thumb_index*
+thumb_index_new (const gchar *dir)
+{
+    struct thumb_index *index;
+
+    g_assert (dir);
+
+    index = g_malloc (sizeof (struct thumb_index));
+    index->dir = g_strdup (dir);
+    index->digests = g_hash_table_new (&thumb_index_hash, &thumb_index_equal);
+    index->storage = g_string_chunk_new (THUMB_INDEX_STORAGE);
+    index->complete = FALSE;
+    index->stop = FALSE;
+    g_mutex_init (&index->mutex);
+
+    index->thread = g_thread_new ("thumb_index_worker",
+                                  (GThreadFunc) &thumb_index_worker, index);
+
+    return index;
+}
+
+/**
+ * Stops reading of directory and frees resources used by index.
+ *
+ * @param index Pointer to struct thumb_index to free.
+ */
+void
+thumb_index_free (struct thumb_index *index)
+{
+    g_assert (index);
+
+    g_mutex_lock (&index->mutex);
+    index->stop = TRUE;
+    g_mutex_unlock (&index->mutex);
+
+    g_thread_join (index->thread);
+
+    g_hash_table_destroy (index->digests);
+    g_string_chunk_free (index->storage);
+    g_mutex_clear (&index->mutex);
+    g_free (index->dir);
+    g_free (index);
+}
+
+/**
+ * Looks up digest in index.
+ *
+ * @param index Pointer to struct thumb_index.
+ * @param digest Digest of URI to look up.
+ * @return THUMB_INDEX_EXISTS if there is an entry, THUMB_INDEX_MISSING
+ * if there is none and THUMB_INDEX_UNKNOWN if the directory is not yet
+ * fully read.
+ */
+guint
+thumb_index_lookup (struct thumb_index *index, const md5_byte_t *digest)
+{
+    guint status;
+
+    g_mutex_lock (&index->mutex);
+    if (g_hash_table_lookup (index->digests, digest)) {
+        status = THUMB_INDEX_EXISTS;
+    } else if (index->complete) {
+        status = THUMB_INDEX_MISSING;
+    } else {
+        status = THUMB_INDEX_UNKNOWN;
+    }
+    g_mutex_unlock (&index->mutex);
+
+    return status;
+}
+
+/**
+ * Adds digest to index, used when a new entry is written to the cache.
+ *
+ * @param index Pointer to struct thumb_index.
+ * @param digest Digest of URI to add.
+ */
+void
+thumb_index_add (struct thumb_index *index, const md5_byte_t *digest)
+{
+    g_mutex_lock (&index->mutex);
+    thumb_index_insert (index, digest);
+    g_mutex_unlock (&index->mutex);
+}
+
+/**
+ * Removes digest from index, used when an entry turns out to be
+ * missing or unreadable.
+ *
+ * @param index Pointer to struct thumb_index.
+ * @param digest Digest of URI to remove.
+ */
+void
+thumb_index_remove (struct thumb_index *index, const md5_byte_t *digest)
+{
+    g_mutex_lock (&index->mutex);
+    g_hash_table_remove (index->digests, digest);
+    g_mutex_unlock (&index->mutex);
+}
+
+/**
+ * Reads cache directory, adding entries to the index.
+ *
+ * @param index Pointer to struct thumb_index.
+ * @return NULL
+ */
+gpointer
+thumb_index_worker (struct thumb_index *index)
+{
+    GDir *dir;
+    guint i, num = 0;
+    gboolean stop = FALSE;
+    const gchar *name;
+    md5_byte_t digests[THUMB_INDEX_BATCH][MD5_DIGEST_SIZE];
+
+    dir = g_dir_open (index->dir, 0, NULL);
+    if (dir) {
+        while (! stop) {
+            name = g_dir_read_name (dir);
+            if (name && thumb_index_parse (name, digests[num])) {
+                num++;
+            }
+
+            /* Publish entries in batches to keep lock traffic low */
+            if (num == THUMB_INDEX_BATCH || (! name && num > 0)) {
+                g_mutex_lock (&index->mutex);
+                for (i = 0; i < num; i++) {
+                    thumb_index_insert (index, digests[i]);
+                }
+                stop = index->stop;
+                g_mutex_unlock (&index->mutex);
+                num = 0;
+            }
+
+            if (! name) {
+                break;
+            }
+        }
+
+        g_dir_close (dir);
+    }
+
+    /* A missing directory is a complete, empty, index. */
+    g_mutex_lock (&index->mutex);
+    index->complete = ! stop;
+    g_mutex_unlock (&index->mutex);
+
+    return NULL;
+}
+
+/**
+ * Inserts digest in set, caller must hold the index lock.
+ *
+ * @param index Pointer to struct thumb_index.
+ * @param digest Digest to insert.
+ */
+void
+thumb_index_insert (struct thumb_index *index, const md5_byte_t *digest)
+{
+    gchar *key;
+
+    if (! g_hash_table_lookup (index->digests, digest)) {
+        key = g_string_chunk_insert_len (index->storage,
+                                         (const gchar*) digest,
+                                         MD5_DIGEST_SIZE);
+        g_hash_table_insert (index->digests, key, key);
+    }
+}
+
+/**
+ * Parses cache entry name, <md5 hex>.png, into digest.
+ *
+ * @param name Name of entry in cache directory.
+ * @param digest Buffer of MD5_DIGEST_SIZE bytes to write digest to.
+ * @return TRUE if name is a cache entry, else FALSE.
+ */
+gboolean
+thumb_index_parse (const gchar *name, md5_byte_t *digest)
+{
+    guint i;
+    gint high, low;
+
+    if (strlen (name) != THUMB_INDEX_NAME_LEN
+        || strcmp (name + MD5_DIGEST_SIZE * 2, ".png")) {
+        return FALSE;
+    }
+
+    for (i = 0; i < MD5_DIGEST_SIZE; i++) {
+        high = g_ascii_xdigit_value (name[i * 2]);
+        low = g_ascii_xdigit_value (name[i * 2 + 1]);
+        if (high == -1 || low == -1) {
+            return FALSE;
+        }
+        digest[i] = (high << 4) | low;
+    }
+
+    return TRUE;
+}
+
+/**
+ * Hash function for digests, the digest itself is already well
+ * distributed.
+ */
+guint
+thumb_index_hash (gconstpointer key)
+{
+    guint hash;
+
+    memcpy (&hash, key, sizeof (hash));
+
+    return hash;
+}
+
+/**
+ * Equal function for digests.
+ */
+gboolean
+thumb_index_equal (gconstpointer a, gconstpointer b)
+{
+    return memcmp (a, b, MD5_DIGEST_SIZE) == 0;
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2026 Claes Nästén <pekdon@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * In-memory index of the on-disk thumbnail cache.
+ */
+
+#ifndef _THUMB_INDEX_H_
+#define _THUMB_INDEX_H_
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <glib.h>
+
+#include "md5_multi.h"
+
+#define THUMB_INDEX_BATCH 256
+
+#define THUMB_INDEX_MISSING 0
+#define THUMB_INDEX_EXISTS 1
+#define THUMB_INDEX_UNKNOWN 2
+
+/**
+ * Set of digests with an entry in a thumbnail cache directory, filled
+ * in by a background thread reading the directory once.
+ */
+struct thumb_index {
+    gchar *dir; /**< Cache directory being indexed. */
+    GHashTable *digests; /**< Set of known digests. */
+    GStringChunk *storage; /**< Storage for digests in set. */
+    gboolean complete; /**< Set to TRUE when directory is fully read. */
+    gboolean stop; /**< Set to TRUE to stop reading directory. */
+    GMutex mutex; /**< Lock for index. */
+    GThread *thread; /**< Thread reading directory. */
+};
+
+extern struct thumb_index *thumb_index_new (const gchar *dir);
+extern void thumb_index_free (struct thumb_index *index);
+
+extern guint thumb_index_lookup (struct thumb_index *index,
+                                 const md5_byte_t *digest);
+extern void thumb_index_add (struct thumb_index *index,
+                             const md5_byte_t *digest);
+extern void thumb_index_remove (struct thumb_index *index,
+                                const md5_byte_t *digest);
+
+#endif /* _THUMB_INDEX_H_ */
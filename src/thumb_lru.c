@@ -0,0 +1,228 @@
+/*
+ * Copyright (C) 2026 Claes Nästén <pekdon@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * In-memory cache of recently used thumbnails.
+ *
+ * Thumbnails are shared between all views, a view only keeps the
+ * thumbnails it displays and gets them back from here, or from the
+ * disk cache once evicted, when they are displayed again.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <string.h>
+
+#include "thumb_lru.h"
+
+/**
+ * Cached thumbnail.
+ */
+struct thumb_lru_entry {
+    struct thumb_lru_key key; /**< Key of entry, must be first. */
+    GdkPixbuf *pixbuf; /**< Cached thumbnail. */
+    gsize bytes; /**< Bytes of pixel data in thumbnail. */
+};
+
+static void thumb_lru_evict (struct thumb_lru *lru);
+static void thumb_lru_entry_free (struct thumb_lru_entry *entry);
+
+static guint thumb_lru_hash (gconstpointer key);
+static gboolean thumb_lru_equal (gconstpointer a, gconstpointer b);
+
+/**
+ * Creates new thumbnail cache.
+ *
+ * @param budget Maximum bytes of pixel data to keep.
+ * @return Pointer to struct thumb_lru.
+ */
+struct thumb_lru*
+thumb_lru_new (gsize budget)
+{
+    struct thumb_lru *lru;
+
+    lru = g_malloc (sizeof (struct thumb_lru));
+    lru->entries = g_hash_table_new (&thumb_lru_hash, &thumb_lru_equal);
+    lru->order = g_queue_new ();
+    lru->bytes = 0;
+    lru->budget = budget;
+    g_mutex_init (&lru->mutex);
+
+    return lru;
+}
+
+/**
+ * Frees thumbnail cache and all thumbnails in it.
+ *
+ * @param lru Pointer to struct thumb_lru to free.
+ */
+void
+thumb_lru_free (struct thumb_lru *lru)
+{
+    g_assert (lru);
+
+    while (! g_queue_is_empty (lru->order)) {
+        thumb_lru_evict (lru);
+    }
+
+    g_hash_table_destroy (lru->entries);
+    g_queue_free (lru->order);
+    g_mutex_clear (&lru->mutex);
+    g_free (lru);
+}
+
+/**
+ * Gets thumbnail from cache, marking it as most recently used.
+ *
+ * @param lru Pointer to struct thumb_lru.
+ * @param key Key of thumbnail.
+ * @return New reference to GdkPixbuf, NULL if not cached.
+ */
+GdkPixbuf*
+thumb_lru_get (struct thumb_lru *lru, const struct thumb_lru_key *key)
+{
+    GList *link;
+    GdkPixbuf *pixbuf = NULL;
+
+    g_mutex_lock (&lru->mutex);
+    link = g_hash_table_lookup (lru->entries, key);
+    if (link) {
+        g_queue_unlink (lru->order, link);
+        g_queue_push_head_link (lru->order, link);
+        pixbuf = g_object_ref (((struct thumb_lru_entry*) link->data)->pixbuf);
+    }
+    g_mutex_unlock (&lru->mutex);
+
+    return pixbuf;
+}
+
+/**
+ * Adds thumbnail to cache, evicting least recently used thumbnails to
+ * stay within the budget.
+ *
+ * @param lru Pointer to struct thumb_lru.
+ * @param key Key of thumbnail.
+ * @param pixbuf Thumbnail to add, a reference is kept.
+ */
+void
+thumb_lru_put (struct thumb_lru *lru, const struct thumb_lru_key *key,
+               GdkPixbuf *pixbuf)
+{
+    GList *link;
+    struct thumb_lru_entry *entry;
+    gsize bytes;
+
+    bytes = (gsize) gdk_pixbuf_get_rowstride (pixbuf)
+        * gdk_pixbuf_get_height (pixbuf);
+    if (bytes > lru->budget) {
+        return;
+    }
+
+    g_mutex_lock (&lru->mutex);
+
+    /* Replace existing entry, could be added by another thread */
+    link = g_hash_table_lookup (lru->entries, key);
+    if (link) {
+        entry = (struct thumb_lru_entry*) link->data;
+        g_hash_table_remove (lru->entries, &entry->key);
+        g_queue_delete_link (lru->order, link);
+        lru->bytes -= entry->bytes;
+        thumb_lru_entry_free (entry);
+    }
+
+    while (lru->bytes + bytes > lru->budget) {
+        thumb_lru_evict (lru);
+    }
+
+    entry = g_malloc (sizeof (struct thumb_lru_entry));
+    memcpy (&entry->key, key, sizeof (struct thumb_lru_key));
+    entry->pixbuf = g_object_ref (pixbuf);
+    entry->bytes = bytes;
+
+    g_queue_push_head (lru->order, entry);
+    g_hash_table_insert (lru->entries, &entry->key,
+                         g_queue_peek_head_link (lru->order));
+    lru->bytes += bytes;
+
+    g_mutex_unlock (&lru->mutex);
+}
+
+/**
+ * Evicts least recently used thumbnail, caller must hold the lock.
+ *
+ * @param lru Pointer to struct thumb_lru.
+ */
+void
+thumb_lru_evict (struct thumb_lru *lru)
+{
+    struct thumb_lru_entry *entry;
+
+    entry = (struct thumb_lru_entry*) g_queue_pop_tail (lru->order);
+    g_hash_table_remove (lru->entries, &entry->key);
+    lru->bytes -= entry->bytes;
+    thumb_lru_entry_free (entry);
+}
+
+/**
+ * Frees cache entry and its reference to the thumbnail.
+ *
+ * @param entry Pointer to struct thumb_lru_entry to free.
+ */
+void
+thumb_lru_entry_free (struct thumb_lru_entry *entry)
+{
+    g_object_unref (entry->pixbuf);
+    g_free (entry);
+}
+
+/**
+ * Hash function for struct thumb_lru_key.
+ */
+guint
+thumb_lru_hash (gconstpointer key)
+{
+    const struct thumb_lru_key *lru_key = (const struct thumb_lru_key*) key;
+    guint hash;
+
+    /* Digest is uniformly distributed already */
+    memcpy (&hash, lru_key->digest, sizeof (hash));
+
+    return hash ^ (guint) lru_key->mtime ^ lru_key->side;
+}
+
+/**
+ * Equal function for struct thumb_lru_key.
+ */
+gboolean
+thumb_lru_equal (gconstpointer a, gconstpointer b)
+{
+    const struct thumb_lru_key *key_a = (const struct thumb_lru_key*) a;
+    const struct thumb_lru_key *key_b = (const struct thumb_lru_key*) b;
+
+    return memcmp (key_a->digest, key_b->digest, MD5_DIGEST_SIZE) == 0
+        && key_a->mtime == key_b->mtime
+        && key_a->side == key_b->side;
+}
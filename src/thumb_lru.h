@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2026 Claes Nästén <pekdon@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * In-memory cache of recently used thumbnails.
+ */
+
+#ifndef _THUMB_LRU_H_
+#define _THUMB_LRU_H_
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <glib.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include <time.h>
+
+#include "md5_multi.h"
+
+#define THUMB_LRU_BUDGET (32 * 1024 * 1024)
+
+/**
+ * Key identifying a thumbnail, digest of the URI, modification time of
+ * the original and thumbnail size.
+ */
+struct thumb_lru_key {
+    md5_byte_t digest[MD5_DIGEST_SIZE]; /**< Digest of file URI. */
+    time_t mtime; /**< Modification time of file. */
+    guint side; /**< Maximum side of thumbnail. */
+};
+
+/**
+ * Thumbnails kept within a byte budget, least recently used thumbnails
+ * are evicted first.
+ */
+struct thumb_lru {
+    GHashTable *entries; /**< struct thumb_lru_key to GList in order. */
+    GQueue *order; /**< Entries, most recently used first. */
+    gsize bytes; /**< Bytes of pixel data in cache. */
+    gsize budget; /**< Maximum bytes of pixel data. */
+    GMutex mutex; /**< Lock for cache. */
+};
+
+extern struct thumb_lru *thumb_lru_new (gsize budget);
+extern void thumb_lru_free (struct thumb_lru *lru);
+
+extern GdkPixbuf *thumb_lru_get (struct thumb_lru *lru,
+                                 const struct thumb_lru_key *key);
+extern void thumb_lru_put (struct thumb_lru *lru,
+                           const struct thumb_lru_key *key,
+                           GdkPixbuf *pixbuf);
+
+#endif /* _THUMB_LRU_H_ */
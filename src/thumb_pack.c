@@ -0,0 +1,610 @@
+/*
+ * Copyright (C) 2026 Claes Nästén <pekdon@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * Packed single file thumbnail store.
+ *
+ * Thumbnails are appended uncompressed to a single file, each record
+ * is a fixed size header followed by the pixel data padded to 8 bytes.
+ * The file is memory mapped and the records are indexed when opened,
+ * thumbnails are then served straight from the mapping without copying
+ * or decoding. The store is mapped again when it has grown, earlier
+ * mappings are unmapped once no pixbufs reference them. All pixbufs
+ * from the store must be released before closing it.
+ *
+ * Records are appended holding an fcntl write lock on the store, as
+ * O_APPEND alone is not atomic on network filesystems, so concurrent
+ * writers in other processes never interleave. A torn record at the
+ * end of the file, left by an interrupted writer, is skipped when
+ * indexing. The key of the record
+ * is checked when serving, an index entry pointing at another record
+ * is dropped.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "thumb_pack.h"
+
+#define THUMB_PACK_MAGIC "GEHPACK1"
+#define THUMB_PACK_MAGIC_LEN 8
+#define THUMB_PACK_RECORD_MAGIC 0x54485042 /* THPB */
+#define THUMB_PACK_ALIGN 8
+#define THUMB_PACK_SIDE_MAX 4096
+
+/**
+ * Record header, followed by data_len bytes of pixel data.
+ */
+struct thumb_pack_record {
+    guint32 magic; /**< THUMB_PACK_RECORD_MAGIC. */
+    guint32 data_len; /**< Bytes of pixel data. */
+    struct thumb_pack_key key; /**< Key of thumbnail. */
+    guint32 width; /**< Thumbnail width. */
+    guint32 height; /**< Thumbnail height. */
+    guint32 rowstride; /**< Bytes per row of pixel data. */
+    guint32 has_alpha; /**< Non zero if pixel data has alpha. */
+};
+
+/* Records are read back by other builds, the layout must not change */
+G_STATIC_ASSERT (sizeof (struct thumb_pack_record) == 64);
+
+/**
+ * Index entry, position of record in the store.
+ */
+struct thumb_pack_entry {
+    struct thumb_pack_key key; /**< Key of record, must be first. */
+    goffset offset; /**< Offset of record header. */
+};
+
+/**
+ * Mapping of the store.
+ */
+struct thumb_pack_map {
+    struct thumb_pack *pack; /**< Store mapped. */
+    guchar *data; /**< Mapped data. */
+    gsize len; /**< Length of mapping. */
+    guint refs; /**< Number of pixbufs referencing the mapping. */
+};
+
+static gboolean thumb_pack_lock (int fd, short type);
+static gboolean thumb_pack_remap (struct thumb_pack *pack);
+static void thumb_pack_unmap_unused (struct thumb_pack *pack);
+static void thumb_pack_pixbuf_destroy (guchar *pixels, gpointer data);
+static struct thumb_pack_record *thumb_pack_record_at (
+    struct thumb_pack *pack, goffset offset,
+    const struct thumb_pack_key *key);
+static void thumb_pack_index (struct thumb_pack *pack);
+static gboolean thumb_pack_record_valid (const struct thumb_pack_record *rec,
+                                         gsize avail);
+static void thumb_pack_insert (struct thumb_pack *pack,
+                               const struct thumb_pack_key *key,
+                               goffset offset);
+static gsize thumb_pack_padded (gsize len);
+
+static guint thumb_pack_hash (gconstpointer key);
+static gboolean thumb_pack_equal (gconstpointer a, gconstpointer b);
+
+/**
+ * Opens store, creating it if it does not exist, and indexes the
+ * records in it.
+ *
+ * @param path Path to store.
+ * @return Pointer to struct thumb_pack, NULL on error.
+ */
+struct thumb_pack*
+thumb_pack_open (const gchar *path)
+{
+    struct thumb_pack *pack;
+    gchar *dir;
+    struct stat buf;
+    int fd;
+
+    dir = g_path_get_dirname (path);
+    g_mkdir_with_parents (dir, 0700);
+    g_free (dir);
+
+    fd = g_open (path, O_RDWR | O_APPEND | O_CREAT, 0600);
+    if (fd == -1) {
+        g_warning ("failed to open %s: %s", path, g_strerror (errno));
+        return NULL;
+    }
+
+    /* New store, the header is written by the first creator */
+    if (! thumb_pack_lock (fd, F_WRLCK)) {
+        g_warning ("failed to lock %s: %s", path, g_strerror (errno));
+        close (fd);
+        return NULL;
+    }
+    if (fstat (fd, &buf) == 0 && buf.st_size == 0) {
+        if (write (fd, THUMB_PACK_MAGIC, THUMB_PACK_MAGIC_LEN)
+            != THUMB_PACK_MAGIC_LEN) {
+            g_warning ("failed to write %s: %s", path, g_strerror (errno));
+            close (fd);
+            return NULL;
+        }
+    }
+    thumb_pack_lock (fd, F_UNLCK);
+
+    pack = g_malloc (sizeof (struct thumb_pack));
+    pack->path = g_strdup (path);
+    pack->fd = fd;
+    pack->entries = g_hash_table_new_full (&thumb_pack_hash,
+                                           &thumb_pack_equal,
+                                           g_free, NULL);
+    pack->maps = g_ptr_array_new ();
+    g_mutex_init (&pack->mutex);
+
+    if (! thumb_pack_remap (pack)) {
+        thumb_pack_close (pack);
+        return NULL;
+    }
+
+    if (memcmp (((struct thumb_pack_map*) g_ptr_array_index (pack->maps, 0))
+                ->data, THUMB_PACK_MAGIC, THUMB_PACK_MAGIC_LEN)) {
+        g_warning ("%s is not a thumbnail store", path);
+        thumb_pack_close (pack);
+        return NULL;
+    }
+
+    thumb_pack_index (pack);
+
+    return pack;
+}
+
+/**
+ * Closes store, no pixbufs from the store may be in use.
+ *
+ * @param pack Pointer to struct thumb_pack to close.
+ */
+void
+thumb_pack_close (struct thumb_pack *pack)
+{
+    struct thumb_pack_map *map;
+    guint i;
+
+    g_assert (pack);
+
+    for (i = 0; i < pack->maps->len; i++) {
+        map = (struct thumb_pack_map*) g_ptr_array_index (pack->maps, i);
+        munmap (map->data, map->len);
+        g_free (map);
+    }
+    g_ptr_array_free (pack->maps, TRUE);
+
+    g_hash_table_destroy (pack->entries);
+    close (pack->fd);
+    g_mutex_clear (&pack->mutex);
+    g_free (pack->path);
+    g_free (pack);
+}
+
+/**
+ * Gets thumbnail from store, the returned pixbuf references the mapped
+ * store and must not be modified.
+ *
+ * @param pack Pointer to struct thumb_pack.
+ * @param key Key of thumbnail.
+ * @return New GdkPixbuf, NULL if not in store.
+ */
+GdkPixbuf*
+thumb_pack_get (struct thumb_pack *pack, const struct thumb_pack_key *key)
+{
+    struct thumb_pack_entry *entry;
+    struct thumb_pack_record *rec;
+    struct thumb_pack_map *map;
+    GdkPixbuf *pixbuf = NULL;
+
+    g_mutex_lock (&pack->mutex);
+
+    entry = g_hash_table_lookup (pack->entries, key);
+    if (entry) {
+        /* Records appended after mapping need a new mapping */
+        rec = thumb_pack_record_at (pack, entry->offset, key);
+        if (! rec && thumb_pack_remap (pack)) {
+            rec = thumb_pack_record_at (pack, entry->offset, key);
+        }
+
+        if (rec) {
+            map = g_ptr_array_index (pack->maps, pack->maps->len - 1);
+            map->refs++;
+            pixbuf = gdk_pixbuf_new_from_data ((guchar*) (rec + 1),
+                                               GDK_COLORSPACE_RGB,
+                                               rec->has_alpha, 8,
+                                               rec->width, rec->height,
+                                               rec->rowstride,
+                                               &thumb_pack_pixbuf_destroy,
+                                               map);
+        } else {
+            /* Offset does not hold the record, such as after a racing
+               append, dropped and stored again by the caller. */
+            g_hash_table_remove (pack->entries, key);
+        }
+    }
+
+    g_mutex_unlock (&pack->mutex);
+
+    return pixbuf;
+}
+
+/**
+ * Appends thumbnail to store unless already stored.
+ *
+ * @param pack Pointer to struct thumb_pack.
+ * @param key Key of thumbnail.
+ * @param pixbuf Thumbnail to store.
+ * @return TRUE if thumbnail is in store, else FALSE.
+ */
+gboolean
+thumb_pack_put (struct thumb_pack *pack, const struct thumb_pack_key *key,
+                GdkPixbuf *pixbuf)
+{
+    static const guchar pad[THUMB_PACK_ALIGN] = { 0 };
+
+    struct thumb_pack_record rec;
+    struct iovec iov[3];
+    gsize total;
+    gssize written;
+    goffset end;
+
+    /* Only layouts accepted by thumb_pack_record_valid are stored */
+    if (gdk_pixbuf_get_bits_per_sample (pixbuf) != 8
+        || gdk_pixbuf_get_colorspace (pixbuf) != GDK_COLORSPACE_RGB
+        || gdk_pixbuf_get_rowstride (pixbuf)
+           > ((gdk_pixbuf_get_width (pixbuf)
+               * gdk_pixbuf_get_n_channels (pixbuf) + 3) & ~3)) {
+        return FALSE;
+    }
+
+    memset (&rec, 0, sizeof (rec));
+    rec.magic = THUMB_PACK_RECORD_MAGIC;
+    memcpy (&rec.key, key, sizeof (struct thumb_pack_key));
+    rec.key.pad = 0;
+    rec.width = gdk_pixbuf_get_width (pixbuf);
+    rec.height = gdk_pixbuf_get_height (pixbuf);
+    rec.rowstride = gdk_pixbuf_get_rowstride (pixbuf);
+    rec.has_alpha = gdk_pixbuf_get_has_alpha (pixbuf);
+    /* Last row is not padded to the rowstride */
+    rec.data_len = (rec.height - 1) * rec.rowstride
+        + rec.width * gdk_pixbuf_get_n_channels (pixbuf);
+
+    iov[0].iov_base = &rec;
+    iov[0].iov_len = sizeof (rec);
+    iov[1].iov_base = gdk_pixbuf_get_pixels (pixbuf);
+    iov[1].iov_len = rec.data_len;
+    iov[2].iov_base = (void*) pad;
+    iov[2].iov_len = thumb_pack_padded (rec.data_len) - rec.data_len;
+    total = iov[0].iov_len + iov[1].iov_len + iov[2].iov_len;
+
+    g_mutex_lock (&pack->mutex);
+
+    if (g_hash_table_lookup (pack->entries, key)) {
+        g_mutex_unlock (&pack->mutex);
+        return TRUE;
+    }
+
+    /* Other processes append under the same lock, the end of the file
+       is where the record is written. */
+    if (! thumb_pack_lock (pack->fd, F_WRLCK)) {
+        g_warning ("failed to lock %s: %s", pack->path, g_strerror (errno));
+        g_mutex_unlock (&pack->mutex);
+        return FALSE;
+    }
+    end = lseek (pack->fd, 0, SEEK_END);
+    written = end == -1 ? -1 : writev (pack->fd, iov, 3);
+    thumb_pack_lock (pack->fd, F_UNLCK);
+
+    if (written == (gssize) total) {
+        thumb_pack_insert (pack, key, end);
+    } else {
+        g_warning ("failed to append to %s: %s", pack->path,
+                   written == -1 ? g_strerror (errno) : "short write");
+    }
+
+    g_mutex_unlock (&pack->mutex);
+
+    return written == (gssize) total;
+}
+
+/**
+ * Locks or unlocks the whole store, waits for other processes to
+ * release their locks.
+ *
+ * @param fd File descriptor of store.
+ * @param type F_WRLCK to lock, F_UNLCK to unlock.
+ * @return TRUE on success, else FALSE.
+ */
+gboolean
+thumb_pack_lock (int fd, short type)
+{
+    struct flock lock;
+
+    memset (&lock, 0, sizeof (lock));
+    lock.l_type = type;
+    lock.l_whence = SEEK_SET;
+    lock.l_start = 0;
+    lock.l_len = 0;
+
+    while (fcntl (fd, F_SETLKW, &lock) == -1) {
+        if (errno != EINTR) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ * Maps the whole store if it has grown since the newest mapping,
+ * earlier mappings are kept while pixbufs reference them.
+ *
+ * @param pack Pointer to struct thumb_pack.
+ * @return TRUE if mapped again, else FALSE.
+ */
+gboolean
+thumb_pack_remap (struct thumb_pack *pack)
+{
+    struct thumb_pack_map *map;
+    struct stat buf;
+    void *data;
+
+    if (fstat (pack->fd, &buf) == -1 || buf.st_size < THUMB_PACK_MAGIC_LEN) {
+        return FALSE;
+    }
+    if (pack->maps->len > 0) {
+        map = g_ptr_array_index (pack->maps, pack->maps->len - 1);
+        if ((gsize) buf.st_size <= map->len) {
+            return FALSE;
+        }
+    }
+
+    data = mmap (NULL, buf.st_size, PROT_READ, MAP_SHARED, pack->fd, 0);
+    if (data == MAP_FAILED) {
+        g_warning ("failed to map %s: %s", pack->path, g_strerror (errno));
+        return FALSE;
+    }
+
+    map = g_malloc (sizeof (struct thumb_pack_map));
+    map->pack = pack;
+    map->data = data;
+    map->len = buf.st_size;
+    map->refs = 0;
+    g_ptr_array_add (pack->maps, map);
+
+    thumb_pack_unmap_unused (pack);
+
+    return TRUE;
+}
+
+/**
+ * Unmaps mappings, other than the newest, no longer referenced by any
+ * pixbuf. Called with the store locked.
+ *
+ * @param pack Pointer to struct thumb_pack.
+ */
+void
+thumb_pack_unmap_unused (struct thumb_pack *pack)
+{
+    struct thumb_pack_map *map;
+    guint i;
+
+    for (i = 0; i + 1 < pack->maps->len; ) {
+        map = (struct thumb_pack_map*) g_ptr_array_index (pack->maps, i);
+        if (map->refs == 0) {
+            munmap (map->data, map->len);
+            g_free (map);
+            g_ptr_array_remove_index (pack->maps, i);
+        } else {
+            i++;
+        }
+    }
+}
+
+/**
+ * Releases the reference a pixbuf from the store holds on its mapping.
+ *
+ * @param pixels Pixel data of pixbuf.
+ * @param data Pointer to struct thumb_pack_map.
+ */
+void
+thumb_pack_pixbuf_destroy (guchar *pixels, gpointer data)
+{
+    struct thumb_pack_map *map = (struct thumb_pack_map*) data;
+    struct thumb_pack *pack = map->pack;
+
+    g_mutex_lock (&pack->mutex);
+    map->refs--;
+    thumb_pack_unmap_unused (pack);
+    g_mutex_unlock (&pack->mutex);
+}
+
+/**
+ * Gets valid record with key at offset in the newest mapping.
+ *
+ * @param pack Pointer to struct thumb_pack.
+ * @param offset Offset of record header.
+ * @param key Key the record must have.
+ * @return Pointer to record, NULL if invalid, another record or not
+ * mapped.
+ */
+struct thumb_pack_record*
+thumb_pack_record_at (struct thumb_pack *pack, goffset offset,
+                      const struct thumb_pack_key *key)
+{
+    struct thumb_pack_map *map;
+    struct thumb_pack_record *rec;
+
+    map = g_ptr_array_index (pack->maps, pack->maps->len - 1);
+    if (offset + sizeof (struct thumb_pack_record) > map->len) {
+        return NULL;
+    }
+
+    rec = (struct thumb_pack_record*) (map->data + offset);
+    if (! thumb_pack_record_valid (rec, map->len - offset)
+        || ! thumb_pack_equal (&rec->key, key)) {
+        return NULL;
+    }
+
+    return rec;
+}
+
+/**
+ * Indexes all records in the store, later records replace earlier ones
+ * with the same key. Invalid data is skipped by scanning for the next
+ * aligned valid record.
+ *
+ * @param pack Pointer to struct thumb_pack.
+ */
+void
+thumb_pack_index (struct thumb_pack *pack)
+{
+    struct thumb_pack_map *map;
+    struct thumb_pack_record *rec;
+    gsize offset = THUMB_PACK_MAGIC_LEN;
+    guint skipped = 0;
+
+    map = g_ptr_array_index (pack->maps, pack->maps->len - 1);
+    madvise (map->data, map->len, MADV_SEQUENTIAL);
+
+    while (offset + sizeof (struct thumb_pack_record) <= map->len) {
+        rec = (struct thumb_pack_record*) (map->data + offset);
+        if (thumb_pack_record_valid (rec, map->len - offset)) {
+            thumb_pack_insert (pack, &rec->key, offset);
+            offset += sizeof (struct thumb_pack_record)
+                + thumb_pack_padded (rec->data_len);
+        } else {
+            offset += THUMB_PACK_ALIGN;
+            skipped++;
+        }
+    }
+
+    madvise (map->data, map->len, MADV_RANDOM);
+
+    if (skipped) {
+        g_log (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG,
+               "thumb_pack: skipped %u invalid blocks in %s",
+               skipped, pack->path);
+    }
+}
+
+/**
+ * Checks that record header is consistent and its data available.
+ *
+ * @param rec Record to check.
+ * @param avail Bytes available from start of record.
+ * @return TRUE if record is valid, else FALSE.
+ */
+gboolean
+thumb_pack_record_valid (const struct thumb_pack_record *rec, gsize avail)
+{
+    guint channels;
+
+    if (rec->magic != THUMB_PACK_RECORD_MAGIC
+        || rec->width == 0 || rec->width > THUMB_PACK_SIDE_MAX
+        || rec->height == 0 || rec->height > THUMB_PACK_SIDE_MAX
+        || rec->has_alpha > 1 || rec->key.pad != 0) {
+        return FALSE;
+    }
+
+    /* Rows are padded to at most 4 bytes as in pixbufs, computed in 64
+       bits so that corrupt sizes can not wrap around to data_len */
+    channels = rec->has_alpha ? 4 : 3;
+    return rec->rowstride >= rec->width * channels
+        && rec->rowstride <= ((rec->width * channels + 3) & ~3)
+        && rec->data_len == (guint64) (rec->height - 1) * rec->rowstride
+                            + rec->width * channels
+        && sizeof (struct thumb_pack_record) + (guint64) rec->data_len
+           <= avail;
+}
+
+/**
+ * Adds record to index, replacing existing entry with the same key.
+ *
+ * @param pack Pointer to struct thumb_pack.
+ * @param key Key of record.
+ * @param offset Offset of record header.
+ */
+void
+thumb_pack_insert (struct thumb_pack *pack, const struct thumb_pack_key *key,
+                   goffset offset)
+{
+    struct thumb_pack_entry *entry;
+
+    entry = g_malloc (sizeof (struct thumb_pack_entry));
+    memcpy (&entry->key, key, sizeof (struct thumb_pack_key));
+    entry->offset = offset;
+
+    g_hash_table_replace (pack->entries, entry, entry);
+}
+
+/**
+ * Returns length padded to record alignment.
+ */
+gsize
+thumb_pack_padded (gsize len)
+{
+    return (len + THUMB_PACK_ALIGN - 1) & ~((gsize) THUMB_PACK_ALIGN - 1);
+}
+
+/**
+ * Hash function for struct thumb_pack_key, the digest itself is
+ * already well distributed.
+ */
+guint
+thumb_pack_hash (gconstpointer key)
+{
+    const struct thumb_pack_key *pack_key = (const struct thumb_pack_key*) key;
+    guint hash;
+
+    memcpy (&hash, pack_key->digest, sizeof (hash));
+
+    return hash ^ (guint) pack_key->mtime ^ pack_key->side;
+}
+
+/**
+ * Equal function for struct thumb_pack_key.
+ */
+gboolean
+thumb_pack_equal (gconstpointer a, gconstpointer b)
+{
+    const struct thumb_pack_key *key_a = (const struct thumb_pack_key*) a;
+    const struct thumb_pack_key *key_b = (const struct thumb_pack_key*) b;
+
+    return memcmp (key_a->digest, key_b->digest, MD5_DIGEST_SIZE) == 0
+        && key_a->mtime == key_b->mtime
+        && key_a->size == key_b->size
+        && key_a->side == key_b->side;
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2026 Claes Nästén <pekdon@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * Packed single file thumbnail store.
+ */
+
+#ifndef _THUMB_PACK_H_
+#define _THUMB_PACK_H_
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <glib.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include "md5_multi.h"
+
+#define THUMB_PACK_DIR "geh"
+#define THUMB_PACK_NAME "thumbs.pack"
+
+/**
+ * Key identifying a thumbnail in the store.
+ */
+struct thumb_pack_key {
+    md5_byte_t digest[MD5_DIGEST_SIZE]; /**< Digest of file URI. */
+    gint64 mtime; /**< Modification time of file. */
+    gint64 size; /**< Size of file. */
+    guint32 side; /**< Maximum side of thumbnail. */
+    guint32 pad; /**< Zero, the stored layout has no implicit padding. */
+};
+
+/**
+ * Memory mapped, append only store of uncompressed thumbnails.
+ */
+struct thumb_pack {
+    gchar *path; /**< Path to store. */
+    int fd; /**< Store opened for appending. */
+    GHashTable *entries; /**< Index of records in store. */
+    GPtrArray *maps; /**< Mappings of store in use, newest last. */
+    GMutex mutex; /**< Lock for store. */
+};
+
+extern struct thumb_pack *thumb_pack_open (const gchar *path);
+extern void thumb_pack_close (struct thumb_pack *pack);
+
+extern GdkPixbuf *thumb_pack_get (struct thumb_pack *pack,
+                                  const struct thumb_pack_key *key);
+extern gboolean thumb_pack_put (struct thumb_pack *pack,
+                                const struct thumb_pack_key *key,
+                                GdkPixbuf *pixbuf);
+
+#endif /* _THUMB_PACK_H_ */
@@ -0,0 +1,322 @@
+/*
+ * Copyright (C) 2026 Claes Nästén <pekdon@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * Background writer of thumbnail cache entries.
+ *
+ * Thumbnails are PNG encoded at a fast compression level and written
+ * to a temporary file in the cache directory that is renamed into
+ * place, other readers never see a partial entry. When writes can not
+ * keep up new entries are dropped, they are generated again on the
+ * next run, or the caller waits when every entry has to be written.
+ *
+ * Queued thumbnails are taken in batches of up to THUMB_WRITER_BATCH,
+ * the batch is encoded before any of it is written so that encoding
+ * and file system work are not interleaved per entry, and pending
+ * counts are updated once per batch.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "thumb_writer.h"
+#include "util.h"
+
+#define THUMB_WRITER_TMP_SUFFIX ".XXXXXX"
+
+/**
+ * Queued write of a single thumbnail.
+ */
+struct thumb_writer_job {
+    gchar *path; /**< Final path of cache entry. */
+    GdkPixbuf *pixbuf; /**< Thumbnail to write. */
+    gchar **keys; /**< Save option keys. */
+    gchar **values; /**< Save option values. */
+    struct thumb_index *index; /**< Index to add entry to, or NULL. */
+    md5_byte_t digest[MD5_DIGEST_SIZE]; /**< Digest of entry. */
+    gchar *buf; /**< Encoded PNG, NULL if not encoded. */
+    gsize len; /**< Length of buf. */
+};
+
+static void thumb_writer_worker (gpointer data, gpointer user_data);
+static gboolean thumb_writer_encode (struct thumb_writer_job *job);
+static gboolean thumb_writer_write (struct thumb_writer_job *job);
+static void thumb_writer_job_free (struct thumb_writer_job *job);
+
+/**
+ * Creates new thumbnail writer.
+ *
+ * @param max_pending Maximum number of queued writes.
+ * @param wait TRUE to wait for pending writes instead of dropping.
+ * @return Pointer to struct thumb_writer.
+ */
+struct thumb_writer*
+thumb_writer_new (gint max_pending, gboolean wait)
+{
+    struct thumb_writer *writer;
+
+    writer = g_malloc (sizeof (struct thumb_writer));
+    writer->pending = 0;
+    writer->max_pending = max_pending;
+    writer->wait = wait;
+    writer->dropped = 0;
+    g_queue_init (&writer->jobs);
+    writer->scheduled = FALSE;
+    g_mutex_init (&writer->mutex);
+    g_cond_init (&writer->cond);
+    writer->pool = g_thread_pool_new (&thumb_writer_worker, writer,
+                                      1 /* max threads */,
+                                      FALSE /* exclusive */, NULL);
+
+    return writer;
+}
+
+/**
+ * Writes all queued thumbnails and frees the writer.
+ *
+ * @param writer Pointer to struct thumb_writer to free.
+ */
+void
+thumb_writer_free (struct thumb_writer *writer)
+{
+    g_assert (writer);
+
+    g_thread_pool_free (writer->pool, FALSE /* immediate */, TRUE /* wait */);
+
+    if (writer->dropped) {
+        g_log (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG,
+               "thumb_writer: dropped %u writes", writer->dropped);
+    }
+
+    g_mutex_clear (&writer->mutex);
+    g_cond_clear (&writer->cond);
+    g_free (writer);
+}
+
+/**
+ * Queues thumbnail for writing, dropped if too many writes are pending
+ * unless the writer waits.
+ *
+ * @param writer Pointer to struct thumb_writer.
+ * @param path Path to write thumbnail to.
+ * @param pixbuf Thumbnail to write, a reference is kept until written.
+ * @param keys NULL terminated array of PNG save option keys.
+ * @param values NULL terminated array of PNG save option values.
+ * @param index Index to add entry to once written, or NULL.
+ * @param digest Digest of entry in index.
+ * @return TRUE if queued, FALSE if dropped.
+ */
+gboolean
+thumb_writer_push (struct thumb_writer *writer, const gchar *path,
+                   GdkPixbuf *pixbuf, gchar **keys, gchar **values,
+                   struct thumb_index *index, const md5_byte_t *digest)
+{
+    struct thumb_writer_job *job;
+
+    g_mutex_lock (&writer->mutex);
+    while (writer->wait && writer->pending >= writer->max_pending) {
+        g_cond_wait (&writer->cond, &writer->mutex);
+    }
+    if (writer->pending >= writer->max_pending) {
+        writer->dropped++;
+        g_mutex_unlock (&writer->mutex);
+        return FALSE;
+    }
+    writer->pending++;
+    g_mutex_unlock (&writer->mutex);
+
+    job = g_malloc (sizeof (struct thumb_writer_job));
+    job->path = g_strdup (path);
+    job->pixbuf = g_object_ref (pixbuf);
+    job->keys = g_strdupv (keys);
+    job->values = g_strdupv (values);
+    job->index = index;
+    memcpy (job->digest, digest, MD5_DIGEST_SIZE);
+    job->buf = NULL;
+    job->len = 0;
+
+    /* Queued jobs are taken by a running worker, only start one if none
+       is scheduled */
+    g_mutex_lock (&writer->mutex);
+    g_queue_push_tail (&writer->jobs, job);
+    if (! writer->scheduled) {
+        writer->scheduled = TRUE;
+        g_thread_pool_push (writer->pool, writer, NULL);
+    }
+    g_mutex_unlock (&writer->mutex);
+
+    return TRUE;
+}
+
+/**
+ * Returns number of queued writes.
+ *
+ * @param writer Pointer to struct thumb_writer.
+ * @return Number of writes not yet completed.
+ */
+gint
+thumb_writer_pending (struct thumb_writer *writer)
+{
+    gint pending;
+
+    g_mutex_lock (&writer->mutex);
+    pending = writer->pending;
+    g_mutex_unlock (&writer->mutex);
+
+    return pending;
+}
+
+/**
+ * Encodes and writes queued thumbnails in batches until the queue is
+ * empty.
+ *
+ * @param data Pointer to struct thumb_writer.
+ * @param user_data Pointer to struct thumb_writer.
+ */
+void
+thumb_writer_worker (gpointer data, gpointer user_data)
+{
+    struct thumb_writer *writer = (struct thumb_writer*) user_data;
+    struct thumb_writer_job *batch[THUMB_WRITER_BATCH];
+    guint i, count;
+
+    for (;;) {
+        g_mutex_lock (&writer->mutex);
+        for (count = 0; count < THUMB_WRITER_BATCH; count++) {
+            batch[count] = g_queue_pop_head (&writer->jobs);
+            if (! batch[count]) {
+                break;
+            }
+        }
+        if (count == 0) {
+            writer->scheduled = FALSE;
+            g_mutex_unlock (&writer->mutex);
+            return;
+        }
+        g_mutex_unlock (&writer->mutex);
+
+        for (i = 0; i < count; i++) {
+            thumb_writer_encode (batch[i]);
+        }
+        for (i = 0; i < count; i++) {
+            if (batch[i]->buf && thumb_writer_write (batch[i])
+                && batch[i]->index) {
+                thumb_index_add (batch[i]->index, batch[i]->digest);
+            }
+            thumb_writer_job_free (batch[i]);
+        }
+
+        g_mutex_lock (&writer->mutex);
+        writer->pending -= count;
+        g_cond_broadcast (&writer->cond);
+        g_mutex_unlock (&writer->mutex);
+    }
+}
+
+/**
+ * Encodes thumbnail to PNG, setting buf and len of job.
+ *
+ * @param job Pointer to struct thumb_writer_job.
+ * @return TRUE on success, else FALSE.
+ */
+gboolean
+thumb_writer_encode (struct thumb_writer_job *job)
+{
+    GError *error = NULL;
+
+    if (! gdk_pixbuf_save_to_bufferv (job->pixbuf, &job->buf, &job->len,
+                                      "png", job->keys, job->values,
+                                      &error)) {
+        g_warning ("failed to encode thumbnail %s: %s",
+                   job->path, error->message);
+        g_error_free (error);
+        job->buf = NULL;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ * Writes encoded thumbnail to a temporary file renamed into place.
+ *
+ * @param job Pointer to struct thumb_writer_job.
+ * @return TRUE on success, else FALSE.
+ */
+gboolean
+thumb_writer_write (struct thumb_writer_job *job)
+{
+    int fd;
+    gchar *tmp_path;
+    gboolean status;
+
+    tmp_path = g_strconcat (job->path, THUMB_WRITER_TMP_SUFFIX, NULL);
+    fd = g_mkstemp (tmp_path);
+    if (fd == -1) {
+        g_warning ("failed to create %s: %s", tmp_path, g_strerror (errno));
+        g_free (tmp_path);
+        return FALSE;
+    }
+
+    status = util_write_all (fd, (const guchar*) job->buf, job->len);
+    if (close (fd) == -1) {
+        status = FALSE;
+    }
+    if (status && g_rename (tmp_path, job->path) == -1) {
+        status = FALSE;
+    }
+    if (! status) {
+        g_warning ("failed to write thumbnail %s: %s",
+                   job->path, g_strerror (errno));
+        g_unlink (tmp_path);
+    }
+
+    g_free (tmp_path);
+
+    return status;
+}
+
+/**
+ * Frees resources used by job.
+ *
+ * @param job Pointer to struct thumb_writer_job to free.
+ */
+void
+thumb_writer_job_free (struct thumb_writer_job *job)
+{
+    g_free (job->path);
+    g_object_unref (job->pixbuf);
+    g_strfreev (job->keys);
+    g_strfreev (job->values);
+    g_free (job->buf);
+    g_free (job);
+}
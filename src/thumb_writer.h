@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2026 Claes Nästén <pekdon@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * Background writer of thumbnail cache entries.
+ */
+
+#ifndef _THUMB_WRITER_H_
+#define _THUMB_WRITER_H_
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <glib.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include "md5_multi.h"
+#include "thumb_index.h"
+
+#define THUMB_WRITER_PENDING_MAX 64
+#define THUMB_WRITER_COMPRESSION "1"
+#define THUMB_WRITER_BATCH 16
+
+/**
+ * Thumbnail writer, encodes and writes queued thumbnails in batches
+ * from a single thread.
+ */
+struct thumb_writer {
+    GThreadPool *pool; /**< Thread encoding and writing thumbnails. */
+    GQueue jobs; /**< Queued writes not yet taken by the thread. */
+    gboolean scheduled; /**< Thread is running or pushed to the pool. */
+    gint pending; /**< Number of queued writes. */
+    gint max_pending; /**< Writes are dropped when reaching this. */
+    gboolean wait; /**< Wait for pending writes instead of dropping. */
+    guint dropped; /**< Number of dropped writes. */
+    GMutex mutex; /**< Lock for pending count and queue. */
+    GCond cond; /**< Signalled when a write completes. */
+};
+
+extern struct thumb_writer *thumb_writer_new (gint max_pending,
+                                              gboolean wait);
+extern void thumb_writer_free (struct thumb_writer *writer);
+
+extern gboolean thumb_writer_push (struct thumb_writer *writer,
+                                   const gchar *path, GdkPixbuf *pixbuf,
+                                   gchar **keys, gchar **values,
+                                   struct thumb_index *index,
+                                   const md5_byte_t *digest);
+extern gint thumb_writer_pending (struct thumb_writer *writer);
+
+#endif /* _THUMB_WRITER_H_ */
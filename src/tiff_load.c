@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2026 Claes Nästén <pekdon@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * TIFF thumbnail loading, strips are downscaled as they are decoded.
+ *
+ * Strips, or rows of tiles, are read with the libtiff RGBA interface,
+ * which handles the photometric interpretations and bit depths, one
+ * band at a time and pushed through the box filter. Only a band and
+ * the thumbnail are kept in memory. Images with huge bands are left to
+ * the generic loader.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <glib.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#ifdef HAVE_LIBTIFF
+#include <tiffio.h>
+#endif /* HAVE_LIBTIFF */
+
+#include "orientation.h"
+#include "scale.h"
+#include "tiff_load.h"
+
+#ifdef HAVE_LIBTIFF
+
+static void tiff_error_handler (const char *module, const char *fmt,
+                                va_list ap);
+
+/**
+ * Installs libtiff error and warning handlers, done once as the
+ * handlers are global and thumbnails are loaded from several threads.
+ * Unsupported files end up in the generic loader, no need to report
+ * errors here.
+ */
+void
+tiff_load_init (void)
+{
+    static gsize init = 0;
+
+    if (g_once_init_enter (&init)) {
+        TIFFSetErrorHandler (tiff_error_handler);
+        TIFFSetWarningHandler (tiff_error_handler);
+        g_once_init_leave (&init, 1);
+    }
+}
+
+/**
+ * Loads TIFF image at thumbnail size, rotated according to the
+ * orientation tag.
+ *
+ * @param path Path to file.
+ * @param side Maximum side of thumbnail.
+ * @param width Set to width of original image.
+ * @param height Set to height of original image.
+ * @return Pointer to GdkPixbuf or NULL if image is not a supported TIFF.
+ */
+GdkPixbuf*
+tiff_load_thumb (const gchar *path, guint side, gint *width, gint *height)
+{
+    TIFF *tif;
+    TIFFRGBAImage img;
+    char emsg[1024];
+    uint32_t src_width, src_height, band_height, row, rows, i, x;
+    uint32_t *band, *src;
+    guint dst_width, dst_height;
+    guchar *row_buf, *dst;
+    GdkPixbuf *thumb;
+    struct scale *sc;
+    gboolean ok = TRUE;
+
+    tif = TIFFOpen (path, "r");
+    if (! tif) {
+        return NULL;
+    }
+
+    if (! TIFFRGBAImageOK (tif, emsg)
+        || ! TIFFRGBAImageBegin (&img, tif, 0, emsg)) {
+        TIFFClose (tif);
+        return NULL;
+    }
+    src_width = img.width;
+    src_height = img.height;
+
+    /* Read a row of tiles or a strip at a time */
+    if (TIFFIsTiled (tif)) {
+        TIFFGetFieldDefaulted (tif, TIFFTAG_TILELENGTH, &band_height);
+    } else {
+        TIFFGetFieldDefaulted (tif, TIFFTAG_ROWSPERSTRIP, &band_height);
+    }
+    band_height = MIN (band_height, src_height);
+    if (src_width == 0 || src_height == 0 || band_height == 0
+        || ((guint64) src_width * band_height * sizeof (uint32_t)
+            > TIFF_STRIP_MAX)) {
+        TIFFRGBAImageEnd (&img);
+        TIFFClose (tif);
+        return NULL;
+    }
+
+    /* Read rows as stored, top down, orientation is applied to the
+       thumbnail. */
+    img.req_orientation = img.orientation;
+
+    if (src_width > src_height) {
+        dst_width = side;
+        dst_height = (guint64) side * src_height / src_width;
+    } else {
+        dst_width = (guint64) side * src_width / src_height;
+        dst_height = side;
+    }
+
+    sc = scale_new (src_width, src_height, dst_width, dst_height, 4);
+    if (! sc) {
+        TIFFRGBAImageEnd (&img);
+        TIFFClose (tif);
+        return NULL;
+    }
+
+    band = g_malloc (sizeof (uint32_t) * src_width * band_height);
+    row_buf = g_malloc (src_width * 4);
+
+    for (row = 0; ok && row < src_height; row += band_height) {
+        rows = MIN (band_height, src_height - row);
+        img.row_offset = row;
+        img.col_offset = 0;
+        if (! TIFFRGBAImageGet (&img, band, src_width, rows)) {
+            ok = FALSE;
+            break;
+        }
+
+        for (i = 0; i < rows; i++) {
+            src = band + i * src_width;
+            dst = row_buf;
+            for (x = 0; x < src_width; x++) {
+                *dst++ = TIFFGetR (src[x]);
+                *dst++ = TIFFGetG (src[x]);
+                *dst++ = TIFFGetB (src[x]);
+                *dst++ = TIFFGetA (src[x]);
+            }
+            scale_push_row (sc, row_buf);
+        }
+    }
+
+    g_free (row_buf);
+    g_free (band);
+    TIFFRGBAImageEnd (&img);
+    TIFFClose (tif);
+
+    if (! ok) {
+        scale_free (sc);
+        return NULL;
+    }
+
+    thumb = scale_finish (sc);
+    if (thumb && img.orientation > TOP_LEFT_SIDE) {
+        /* TIFF orientation values match the EXIF Orientation tag */
+        orientation_apply (&thumb, &dst_width, &dst_height,
+                           img.orientation);
+    }
+
+    *width = src_width;
+    *height = src_height;
+
+    return thumb;
+}
+
+/**
+ * libtiff error and warning handler, ignores messages.
+ */
+void
+tiff_error_handler (const char *module, const char *fmt, va_list ap)
+{
+}
+
+#endif /* HAVE_LIBTIFF */
@@ -38,11 +38,15 @@
 #include <stdlib.h>
 
 #include "geh.h"
+#include "orientation.h"
+#include "thumb.h"
 #include "ui_window.h"
 
 /* Compatibility with older gtk+ versions */
 #ifndef GDK_KEY_f
     #define GDK_KEY_0 GDK_0
+    #define GDK_KEY_1 GDK_1
+    #define GDK_KEY_9 GDK_9
     #define GDK_KEY_f GDK_f
     #define GDK_KEY_F GDK_F
     #define GDK_KEY_n GDK_n
@@ -58,22 +62,71 @@
     #define GDK_KEY_R GDK_R
     #define GDK_KEY_plus GDK_plus
     #define GDK_KEY_minus GDK_minus
+    #define GDK_KEY_g GDK_g
+    #define GDK_KEY_G GDK_G
     #define GDK_KEY_F11 GDK_F11
+    #define GDK_KEY_Home GDK_Home
+    #define GDK_KEY_End GDK_End
+    #define GDK_KEY_Page_Up GDK_Page_Up
+    #define GDK_KEY_Page_Down GDK_Page_Down
 #endif
 
 static GtkWidget *ui_window_create_menu (struct ui_window *ui);
 static void ui_window_update_image (struct ui_window *ui);
+static void ui_window_set_preview (struct ui_window *ui, GdkPixbuf *pix);
+static void ui_window_render_image (struct ui_window *ui, cairo_t *cr);
+static void ui_window_readahead (struct ui_window *ui, gint dir);
 
 /* Callbacks */
 static gboolean callback_key_press (GtkWidget *widget,
                                     GdkEventKey *key, gpointer data);
-static void callback_image (GtkIconView *icon_view, GtkTreePath *path, gpointer data);
+static void callback_image (struct thumb_grid *grid, gint index, gpointer data);
 static void callback_zoom (GtkWidget *widget, GdkEventScroll *event, gpointer user_Data);
-static void callback_icon_edited (GtkCellRendererText *cell,
-                                  gchar *path_string, gchar *text,
-                                  gpointer data);
+#if GTK_CHECK_VERSION(3, 0, 0)
+static gboolean callback_image_draw (GtkWidget *widget, cairo_t *cr,
+                                     gpointer data);
+#else /* GTK < 3 */
+static gboolean callback_image_expose (GtkWidget *widget,
+                                       GdkEventExpose *event, gpointer data);
+#endif
 
 static gboolean idle_zoom_fit (gpointer data);
+static gboolean idle_image_decoded (gpointer data);
+static gboolean idle_image_progress (gpointer data);
+static gboolean timeout_image_decode (gpointer data);
+
+static GdkPixbuf *ui_window_set_placeholder (struct ui_window *ui,
+                                             struct file_multi *file);
+static GdkPixbuf *ui_window_scale_fit (GdkPixbuf *pix,
+                                       guint width, guint height,
+                                       GdkInterpType interp);
+static void ui_window_decode_cancel (struct ui_window *ui);
+static void ui_window_decode_reload (struct ui_window *ui);
+static void ui_window_decode_worker (gpointer data, gpointer user_data);
+static void ui_window_decode_progress (GdkPixbuf *pix, gboolean prepared,
+                                       gpointer data);
+static void ui_decode_job_free (struct ui_decode_job *job);
+static gboolean idle_thumb_load (gpointer data);
+static gboolean idle_thumb_loaded (gpointer data);
+
+struct ui_thumb_job;
+
+static void ui_window_thumb_schedule (struct ui_window *ui);
+static void ui_window_thumb_request (struct ui_window *ui,
+                                     gint from, gint to);
+static void ui_window_thumb_hint (struct ui_window *ui,
+                                  struct ui_thumb_job *job);
+static void ui_window_thumb_release (struct ui_window *ui,
+                                     gint first, gint last);
+static void ui_window_thumb_compress (struct ui_window *ui,
+                                      gint first, gint last);
+static gboolean ui_window_thumb_is_wanted (struct ui_window *ui,
+                                           gint index);
+static void ui_window_thumb_worker (gpointer data, gpointer user_data);
+static void callback_thumb_scroll (GtkAdjustment *adjustment, gpointer data);
+static void callback_thumb_allocate (GtkWidget *widget,
+                                     GtkAllocation *allocation,
+                                     gpointer data);
 
 static gboolean callback_menu (GtkWidget *widget, GdkEvent *event);
 static void callback_menu_zoom_orig (GtkMenuItem *item, gpointer data);
@@ -87,6 +140,48 @@ static void callback_menu_file_rename (GtkMenuItem *item, gpointer data);
 
 static void slide_next (struct ui_window *ui);
 static void slide_prev (struct ui_window *ui);
+static void slide_page (struct ui_window *ui, gint dir);
+static void slide_jump (struct ui_window *ui, gint index);
+static void ui_window_slide_to (struct ui_window *ui, gint index, gint dir);
+
+/**
+ * Thumbnail generation request passed to the thumbnail pool.
+ */
+struct ui_thumb_job {
+    struct ui_window *ui; /**< Window requesting the thumbnail. */
+    struct file_multi *file; /**< File to generate thumbnail for. */
+    gint index; /**< Row in the icon store. */
+    GdkPixbuf *thumb; /**< Generated thumbnail, NULL if failed or skipped. */
+    gboolean skipped; /**< Row left the wanted range before generation. */
+};
+
+/**
+ * Decode of the active image, only the last requested decode is
+ * displayed.
+ */
+struct ui_decode_job {
+    struct ui_window *ui; /**< Window displaying the image. */
+    struct file_multi *file; /**< File to decode. */
+    guint width; /**< Width to fit image in, 0 for full size. */
+    guint height; /**< Height to fit image in, 0 for full size. */
+    gboolean zoom_fit; /**< Zoom image to fit when displaying. */
+    guint view_width; /**< Width of view partial images are fitted to. */
+    guint view_height; /**< Height of view partial images are fitted to. */
+    GdkPixbuf *placeholder; /**< Thumbnail of file, NULL if none. */
+    gboolean reload; /**< Replaces the displayed image at full size. */
+    guint serial; /**< Serial of decode, see decode_serial. */
+    GCancellable *cancellable; /**< Cancelled when no longer wanted. */
+    struct image *image; /**< Decoded image, NULL if failed or cancelled. */
+};
+
+/**
+ * Partially decoded image scaled to the view.
+ */
+struct ui_decode_preview {
+    struct ui_window *ui; /**< Window displaying the image. */
+    guint serial; /**< Serial of decode producing the preview. */
+    GdkPixbuf *pix; /**< Scaled partial image. */
+};
 
 void
 ui_init (int* argc, char*** argv)
@@ -101,7 +196,6 @@ ui_init (int* argc, char*** argv)
 struct ui_window*
 ui_window_new (void)
 {
-    GtkCellRenderer *icon_rend;
     struct ui_window *ui;
 
     ui = g_malloc (sizeof (struct ui_window));
@@ -109,12 +203,37 @@ ui_window_new (void)
     ui->is_fullscreen = FALSE;
     ui->width_alloc_prev = 0;
     ui->height_alloc_prev = 0;
+    ui->thumb_current = -1;
+    ui->jump_to = 0;
     ui->thumbnails = 0;
+    ui->thumb_idle = 0;
+    ui->thumb_first = 0;
+    ui->thumb_last = -1;
+    ui->thumb_want_first = 0;
+    ui->thumb_want_last = -1;
+    ui->thumb_scroll_value = 0.0;
+    ui->thumb_scroll_time = 0;
+    ui->thumb_velocity = 0.0;
+    ui->thumb_pool = g_thread_pool_new (&ui_window_thumb_worker, ui,
+                                        MAX (1, g_get_num_processors () - 1),
+                                        FALSE, NULL);
+    g_queue_init (&ui->thumb_queued);
+    g_mutex_init (&ui->thumb_queued_mutex);
+    ui->thumb_readahead = readahead_new (UI_WINDOW_THUMB_READAHEAD,
+                                         READAHEAD_BUDGET);
+    ui->mode = UI_WINDOW_MODE_FULL;
     ui->file = NULL;
     ui->image_data = NULL;
+    ui->decode_pool = g_thread_pool_new (&ui_window_decode_worker, ui,
+                                         1, FALSE, NULL);
+    ui->decode_job = NULL;
+    ui->decode_timeout = 0;
+    ui->decode_time = 0;
+    ui->decode_serial = 0;
+    ui->readahead = readahead_new (UI_WINDOW_READAHEAD, READAHEAD_BUDGET);
+    ui->readahead_dir = 1;
     ui->progress_total = 0;
     ui->progress_step = 0.0;
-    ui->icon_iter.stamp = 0;
 
     /* Create main UI window */
     ui->window = GTK_WINDOW (gtk_window_new (GTK_WINDOW_TOPLEVEL));
@@ -149,48 +268,36 @@ ui_window_new (void)
     g_signal_connect (GTK_WIDGET (ui->image_window), "scroll-event",
                       G_CALLBACK (callback_zoom), ui);
 
-    ui->image = GTK_IMAGE (gtk_image_new ());
+    ui->image = GTK_DRAWING_AREA (gtk_drawing_area_new ());
+    ui->image_preview = NULL;
+#if GTK_CHECK_VERSION(3, 0, 0)
+    g_signal_connect (ui->image, "draw",
+                      G_CALLBACK (callback_image_draw), ui);
+#else /* GTK < 3 */
+    g_signal_connect (ui->image, "expose-event",
+                      G_CALLBACK (callback_image_expose), ui);
+#endif
 
     gtk_scrolled_window_add_with_viewport (GTK_SCROLLED_WINDOW (ui->image_window),
                                            GTK_WIDGET (ui->image));
 
-    /* Create store for icon view */
-    ui->icon_store = gtk_list_store_new (UI_ICON_STORE_FIELDS,
-                                         G_TYPE_POINTER, /* struct file */
-                                         G_TYPE_STRING, /* Display name */
-                                         GDK_TYPE_PIXBUF); /* Thumbnail */
-
     /* Create thumbnail area */
-    ui->icon_view_window = GTK_SCROLLED_WINDOW (gtk_scrolled_window_new (NULL, NULL));
-    gtk_scrolled_window_set_policy (GTK_SCROLLED_WINDOW (ui->icon_view_window),
-                                    GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
-
-    ui->icon_view = GTK_ICON_VIEW (gtk_icon_view_new_with_model (GTK_TREE_MODEL (ui->icon_store)));
-
-    /* Map fields to view */
-    gtk_icon_view_set_item_width (ui->icon_view, options.thumb_side + UI_THUMB_PADDING);
-    gtk_icon_view_set_pixbuf_column (ui->icon_view, UI_ICON_STORE_THUMB);
+    ui->thumb_grid = thumb_grid_new (options.thumb_side, UI_THUMB_PADDING,
+                                     &callback_image, ui);
 
-    /* Make names editable */
-    icon_rend = gtk_cell_renderer_text_new ();
-    gtk_cell_layout_pack_start (GTK_CELL_LAYOUT (ui->icon_view), icon_rend, TRUE);
-    g_object_set (icon_rend, "editable", FALSE, NULL);
-    g_signal_connect (icon_rend, "edited",
-                      G_CALLBACK (callback_icon_edited), ui);
-    gtk_cell_layout_set_attributes (GTK_CELL_LAYOUT (ui->icon_view), icon_rend,
-                                    "text", UI_ICON_STORE_NAME, NULL);
-
-    g_signal_connect (ui->icon_view, "item_activated",
-                      G_CALLBACK (callback_image), ui);
-
-    gtk_container_add (GTK_CONTAINER (ui->icon_view_window),
-                       GTK_WIDGET (ui->icon_view));
+    /* Decode pending thumbnails as they become visible */
+    g_signal_connect (ui->thumb_grid->layout, "size-allocate",
+                      G_CALLBACK (callback_thumb_allocate), ui);
+    g_signal_connect (gtk_scrolled_window_get_hadjustment (ui->thumb_grid->window),
+                      "value-changed", G_CALLBACK (callback_thumb_scroll), ui);
+    g_signal_connect (gtk_scrolled_window_get_vadjustment (ui->thumb_grid->window),
+                      "value-changed", G_CALLBACK (callback_thumb_scroll), ui);
 
     /* Fill pane */
     gtk_paned_pack1 (ui->pane, GTK_WIDGET (ui->image_window),
                      TRUE /* resize */, TRUE /* shrink */);
 
-    gtk_paned_pack2 (ui->pane, GTK_WIDGET (ui->icon_view_window),
+    gtk_paned_pack2 (ui->pane, thumb_grid_get_widget (ui->thumb_grid),
                      TRUE /* resize */, TRUE /* shrink */);
 
     /* Create progress */
@@ -225,13 +332,33 @@ ui_window_free (struct ui_window *ui)
 {
     g_assert (ui);
 
+    if (ui->thumb_idle) {
+        g_source_remove (ui->thumb_idle);
+    }
+
+    /* Drop queued requests, results of running ones are left in idle
+       callbacks that never run as the main loop has finished. Jobs the
+       pool never ran are still in thumb_queued, without thumbnail. */
+    g_thread_pool_free (ui->thumb_pool, TRUE, TRUE);
+    g_queue_foreach (&ui->thumb_queued, (GFunc) g_free, NULL);
+    g_queue_clear (&ui->thumb_queued);
+    g_mutex_clear (&ui->thumb_queued_mutex);
+    readahead_free (ui->thumb_readahead);
+    ui_window_decode_cancel (ui);
+    g_thread_pool_free (ui->decode_pool, TRUE, TRUE);
+
+    thumb_grid_free (ui->thumb_grid);
+
     /* Unref explicitly ref widgets */
-    g_object_unref (ui->icon_store);
     g_object_unref (ui->progress);
 
     if (ui->image_data) {
         image_close (ui->image_data);
     }
+    if (ui->image_preview) {
+        g_object_unref (ui->image_preview);
+    }
+    readahead_free (ui->readahead);
 
     g_free (ui);
 }
@@ -284,8 +411,6 @@ void
 ui_window_set_mode (struct ui_window *ui, guint mode)
 {
     gint max_pos, pane_pos = 0;
-    GList *selection;
-    GtkTreePath *tree_path;
 
     g_assert (ui);
 
@@ -300,36 +425,34 @@ ui_window_set_mode (struct ui_window *ui, guint mode)
         /* Slide-show mode, having a thumbnail height bottom border
            with icons */
         pane_pos = max_pos - options.thumb_side - UI_SLIDE_PADDING;
-        /* Set columns to display in thumbnail mode */
-        gtk_icon_view_set_columns (ui->icon_view, ui->thumbnails); 
+        /* All thumbnails in a single row */
+        thumb_grid_set_single_row (ui->thumb_grid, TRUE);
 
     } else if (mode == UI_WINDOW_MODE_THUMB) {
         /* Set columns to display in thumbnail mode */
-        gtk_icon_view_set_columns (ui->icon_view, -1);
+        thumb_grid_set_single_row (ui->thumb_grid, FALSE);
     }
 
     gtk_paned_set_position (ui->pane, pane_pos);
 
-    /* Re-focus thumbnail image to currently displayed image if any. */
-    selection = gtk_icon_view_get_selected_items(ui->icon_view);
-    if (selection != NULL) {
-        if (selection->data != NULL) {
-            /* For some reason scroll_to_path has to be called twice to
-               work on my setup. */
-            tree_path = (GtkTreePath*) selection->data;
-            gtk_icon_view_scroll_to_path (ui->icon_view, tree_path, TRUE, 0.5, 0.5);
-            gtk_icon_view_scroll_to_path (ui->icon_view, tree_path, TRUE, 0.5, 0.5);
-        }
-        g_list_foreach (selection, (GFunc)gtk_tree_path_free, NULL);
-        g_list_free (selection);
-    }
+    /* Re-focus thumbnail image to currently displayed image if any,
+       repeated by the grid once the pane has been resized. */
+    thumb_grid_scroll_to (ui->thumb_grid,
+                          thumb_grid_get_selected (ui->thumb_grid), TRUE);
 
     /* Store mode */
     ui->mode = mode;
+
+    /* Thumbnails are only generated once they can be seen */
+    if (mode != UI_WINDOW_MODE_FULL) {
+        ui_window_thumb_schedule (ui);
+    }
 }
 
 /**
- * Sets the file to be used as the current image.
+ * Sets the file to be used as the current image. The image is decoded
+ * in the background while its thumbnail is displayed, changes in quick
+ * succession, such as from key repeat, only decode the last image.
  *
  * @param ui Pointer to struct ui_window.
  * @param file Struct file_multi to get image data from.
@@ -341,7 +464,9 @@ ui_window_set_image (struct ui_window *ui, struct file_multi *file,
                      gboolean zoom_fit, gboolean lock)
 {
     gchar *title;
-    struct image *image_old = ui->image_data;
+    GtkAllocation allocation;
+    struct ui_decode_job *job;
+    gint64 now;
 
     g_assert (ui);
 
@@ -355,27 +480,45 @@ ui_window_set_image (struct ui_window *ui, struct file_multi *file,
     gtk_window_set_title (ui->window, title);
     g_free (title);
 
-    /* Open new image */
+    /* Previous image is no longer wanted, stop decoding it */
     ui->file = file;
-    ui->image_data = image_open (file_multi_get_path (file));
+    readahead_read (ui->readahead, file);
+    ui_window_decode_cancel (ui);
     if (ui->image_data) {
+        image_close (ui->image_data);
+        ui->image_data = NULL;
+    }
+
+    /* Open new image, displaying partial data as it is decoded */
+    job = g_malloc0 (sizeof (struct ui_decode_job));
+    job->ui = ui;
+    job->file = file;
+    job->zoom_fit = zoom_fit;
+    job->placeholder = ui_window_set_placeholder (ui, file);
+    job->serial = ++ui->decode_serial;
+    job->cancellable = g_cancellable_new ();
+    gtk_widget_get_allocation (GTK_WIDGET (ui->image_window), &allocation);
+    if (allocation.width > 16 && allocation.height > 16) {
+        job->view_width = allocation.width - 16;
+        job->view_height = allocation.height - 16;
         if (zoom_fit) {
-            /* Use an idle function so that the UI gets to update
-               its size before zooming to fit. */
-            g_idle_add (&idle_zoom_fit, (void*) ui);
-        } else {
-            /* Display file */
-            ui_window_update_image (ui);
+            /* Only decode what is needed to fill the view */
+            job->width = job->view_width;
+            job->height = job->view_height;
         }
-    } else {
-        g_log (G_LOG_DOMAIN, G_LOG_LEVEL_WARNING,
-               "Failed to activate image %s", file_multi_get_path (file));
     }
-
-    /* Clean up resources */
-    if (image_old) {
-        image_close (image_old);
+    ui->decode_job = job;
+
+    /* Delay decoding while changing images faster than it can be
+       displayed, the decode starts once changes stop. */
+    now = g_get_monotonic_time ();
+    if (now - ui->decode_time < UI_WINDOW_DECODE_DELAY * 1000) {
+        ui->decode_timeout = g_timeout_add (UI_WINDOW_DECODE_DELAY,
+                                            &timeout_image_decode, ui);
+    } else {
+        g_thread_pool_push (ui->decode_pool, job, NULL);
     }
+    ui->decode_time = now;
 
     if (lock) {
         gdk_threads_leave ();
@@ -387,7 +530,8 @@ ui_window_set_image (struct ui_window *ui, struct file_multi *file,
  *
  * @param ui Pointer to struct ui_window.
  * @param path Pointer to original file.
- * @param pix Pointer to GdkPixbuf to add.
+ * @param pix Pointer to GdkPixbuf to add, NULL to decode the thumbnail
+ * when it becomes visible.
  */
 void
 ui_window_add_thumbnail (struct ui_window *ui, struct file_multi *file, GdkPixbuf *pix)
@@ -397,38 +541,15 @@ ui_window_add_thumbnail (struct ui_window *ui, struct file_multi *file, GdkPixbu
     /* Thread safety */
     gdk_threads_enter ();
 
-    /* Set correct amount of columns */
     ui->thumbnails++;
-    if (ui->mode != UI_WINDOW_MODE_THUMB) {
-        gtk_icon_view_set_columns (ui->icon_view, ui->thumbnails);
-    }
+    thumb_grid_append (ui->thumb_grid, file, pix,
+                       pix ? UI_THUMB_STATE_LOADED : UI_THUMB_STATE_PENDING);
 
-
-    /* Limit length of name. */
-    gchar *name = g_strdup (file_multi_get_name (file));
-    if (g_utf8_validate (name, -1, NULL)) {
-        if (g_utf8_strlen (name, -1) > UI_THUMB_CHARS) {
-            int i;
-            gchar *p = name;
-            for (i = UI_THUMB_CHARS - 3; i > 0; i--) {
-                p = g_utf8_next_char (p);
-            }
-            g_sprintf (p, "...");
-        }
-    } else if (strlen (name) > UI_THUMB_CHARS) {
-        g_sprintf (name + UI_THUMB_CHARS - 4, "...");
+    if (! pix) {
+        ui_window_thumb_schedule (ui);
     }
 
-    /* Add thumbnail */
-    gtk_list_store_append (ui->icon_store, &ui->icon_iter_add);
-    gtk_list_store_set (ui->icon_store, &ui->icon_iter_add,
-                        UI_ICON_STORE_FILE, file,
-                        UI_ICON_STORE_NAME, name,
-                        UI_ICON_STORE_THUMB, pix, -1);
-
     gdk_threads_leave ();
-
-    free (name);
 }
 
 /**
@@ -532,9 +653,125 @@ ui_window_create_menu (struct ui_window *ui)
 void
 ui_window_update_image (struct ui_window *ui)
 {
-    gtk_image_set_from_pixbuf (GTK_IMAGE (ui->image),
-                               image_get_curr (ui->image_data));
+    cairo_surface_t *surface = image_get_surface (ui->image_data);
+
+    if (ui->image_preview) {
+        g_object_unref (ui->image_preview);
+        ui->image_preview = NULL;
+    }
+
+    gtk_widget_set_size_request (GTK_WIDGET (ui->image),
+                                 cairo_image_surface_get_width (surface),
+                                 cairo_image_surface_get_height (surface));
+    gtk_widget_queue_draw (GTK_WIDGET (ui->image));
+
+    /* Zoomed in past the downscaled decode, displayed upscaled until
+       the full size image is loaded */
+    if (! ui->decode_job && image_need_full (ui->image_data)) {
+        ui_window_decode_reload (ui);
+    }
+}
+
+/**
+ * Displays pixbuf while there is no decoded image.
+ *
+ * @param ui Pointer to struct ui_window.
+ * @param pix Pixbuf to display, NULL to clear.
+ */
+void
+ui_window_set_preview (struct ui_window *ui, GdkPixbuf *pix)
+{
+    if (ui->image_preview) {
+        g_object_unref (ui->image_preview);
+    }
+    ui->image_preview = pix ? g_object_ref (pix) : NULL;
+
+    if (pix) {
+        gtk_widget_set_size_request (GTK_WIDGET (ui->image),
+                                     gdk_pixbuf_get_width (pix),
+                                     gdk_pixbuf_get_height (pix));
+    } else {
+        gtk_widget_set_size_request (GTK_WIDGET (ui->image), -1, -1);
+    }
+    gtk_widget_queue_draw (GTK_WIDGET (ui->image));
+}
+
+/**
+ * Paints the current image, or the preview while decoding, centered in
+ * the image area. The image surface is painted as is at integer
+ * offsets, a plain copy of the exposed area.
+ *
+ * @param ui Pointer to struct ui_window.
+ * @param cr Cairo context to paint on.
+ */
+void
+ui_window_render_image (struct ui_window *ui, cairo_t *cr)
+{
+    GtkAllocation allocation;
+    cairo_surface_t *surface;
+    gint width, height;
+
+    gtk_widget_get_allocation (GTK_WIDGET (ui->image), &allocation);
+    if (ui->image_data) {
+        surface = image_get_surface (ui->image_data);
+        width = cairo_image_surface_get_width (surface);
+        height = cairo_image_surface_get_height (surface);
+        cairo_set_source_surface (cr, surface,
+                                  MAX (0, (allocation.width - width) / 2),
+                                  MAX (0, (allocation.height - height) / 2));
+    } else if (ui->image_preview) {
+        width = gdk_pixbuf_get_width (ui->image_preview);
+        height = gdk_pixbuf_get_height (ui->image_preview);
+        gdk_cairo_set_source_pixbuf (cr, ui->image_preview,
+                                     MAX (0, (allocation.width - width) / 2),
+                                     MAX (0, (allocation.height - height) / 2));
+    } else {
+        return;
+    }
+
+    cairo_paint (cr);
+}
+
+#if GTK_CHECK_VERSION(3, 0, 0)
+/**
+ * Callback drawing the image area.
+ *
+ * @param widget Image area.
+ * @param cr Cairo context to draw on.
+ * @param data Pointer to struct ui_window.
+ * @return FALSE to continue drawing.
+ */
+gboolean
+callback_image_draw (GtkWidget *widget, cairo_t *cr, gpointer data)
+{
+    ui_window_render_image ((struct ui_window*) data, cr);
+
+    return FALSE;
 }
+#else /* GTK < 3 */
+/**
+ * Callback drawing the exposed part of the image area.
+ *
+ * @param widget Image area.
+ * @param event Expose event.
+ * @param data Pointer to struct ui_window.
+ * @return FALSE to continue drawing.
+ */
+gboolean
+callback_image_expose (GtkWidget *widget, GdkEventExpose *event,
+                       gpointer data)
+{
+    cairo_t *cr;
+
+    cr = gdk_cairo_create (gtk_widget_get_window (widget));
+    gdk_cairo_region (cr, event->region);
+    cairo_clip (cr);
+    ui_window_render_image ((struct ui_window*) data, cr);
+    cairo_destroy (cr);
+
+    return FALSE;
+}
+#endif
 
 gboolean
 idle_zoom_fit (gpointer data)
@@ -543,6 +780,657 @@ idle_zoom_fit (gpointer data)
     return FALSE;
 }
 
+/**
+ * Displays decoded image unless another image has been set since the
+ * decode was started.
+ *
+ * @param data Pointer to struct ui_decode_job.
+ * @return FALSE, called once per decode.
+ */
+gboolean
+idle_image_decoded (gpointer data)
+{
+    struct ui_decode_job *job = (struct ui_decode_job*) data;
+    struct ui_window *ui = job->ui;
+
+    gdk_threads_enter ();
+
+    if (job == ui->decode_job) {
+        ui->decode_job = NULL;
+        if (job->image && job->reload) {
+            /* Keep zoom and rotation of the replaced image */
+            image_set_view (job->image, ui->image_data);
+            image_close (ui->image_data);
+            ui->image_data = job->image;
+            job->image = NULL;
+            ui_window_update_image (ui);
+        } else if (job->image) {
+            ui->image_data = job->image;
+            job->image = NULL;
+            if (job->zoom_fit) {
+                /* Use an idle function so that the UI gets to update
+                   its size before zooming to fit. */
+                g_idle_add (&idle_zoom_fit, (void*) ui);
+            } else {
+                /* Display file */
+                ui_window_update_image (ui);
+            }
+        } else {
+            g_log (G_LOG_DOMAIN, G_LOG_LEVEL_WARNING,
+                   "Failed to activate image %s",
+                   file_multi_get_path (job->file));
+        }
+    }
+
+    gdk_threads_leave ();
+
+    ui_decode_job_free (job);
+
+    return FALSE;
+}
+
+/**
+ * Displays partially decoded image unless decoding has finished or
+ * another image has been set since.
+ *
+ * @param data Pointer to struct ui_decode_preview.
+ * @return FALSE, called once per preview.
+ */
+gboolean
+idle_image_progress (gpointer data)
+{
+    struct ui_decode_preview *preview = (struct ui_decode_preview*) data;
+    struct ui_window *ui = preview->ui;
+
+    gdk_threads_enter ();
+
+    if (ui->decode_job && preview->serial == ui->decode_serial) {
+        ui_window_set_preview (ui, preview->pix);
+    }
+
+    gdk_threads_leave ();
+
+    g_object_unref (preview->pix);
+    g_free (preview);
+
+    return FALSE;
+}
+
+/**
+ * Starts decoding the active image once image changes have stopped.
+ *
+ * @param data Pointer to struct ui_window.
+ * @return FALSE, restarted on the next image change.
+ */
+gboolean
+timeout_image_decode (gpointer data)
+{
+    struct ui_window *ui = (struct ui_window*) data;
+
+    gdk_threads_enter ();
+
+    ui->decode_timeout = 0;
+    if (ui->decode_job) {
+        g_thread_pool_push (ui->decode_pool, ui->decode_job, NULL);
+    }
+
+    gdk_threads_leave ();
+
+    return FALSE;
+}
+
+/**
+ * Displays the thumbnail of file scaled to the view while the image is
+ * being decoded, cleared if no thumbnail is available without reading
+ * the image.
+ *
+ * @param ui Pointer to struct ui_window.
+ * @param file File to display thumbnail for.
+ * @return Thumbnail of file, NULL if none.
+ */
+GdkPixbuf*
+ui_window_set_placeholder (struct ui_window *ui, struct file_multi *file)
+{
+    GtkAllocation allocation;
+    GdkPixbuf *thumb = NULL, *view, *scaled;
+
+    if (thumb_grid_get_file (ui->thumb_grid, ui->thumb_current) == file) {
+        /* Pixels are shared with the grid, copied to be kept */
+        view = thumb_grid_get_thumb (ui->thumb_grid, ui->thumb_current);
+        if (view) {
+            thumb = gdk_pixbuf_copy (view);
+            g_object_unref (view);
+        }
+    }
+    if (! thumb && ! thumb_need_read (file, options.thumb_side)) {
+        thumb = thumb_get (file, options.thumb_side, FALSE);
+    }
+    if (! thumb) {
+        ui_window_set_preview (ui, NULL);
+        return NULL;
+    }
+
+    gtk_widget_get_allocation (GTK_WIDGET (ui->image_window), &allocation);
+    if (allocation.width > 16 && allocation.height > 16) {
+        scaled = ui_window_scale_fit (thumb, allocation.width - 16,
+                                      allocation.height - 16,
+                                      GDK_INTERP_BILINEAR);
+        ui_window_set_preview (ui, scaled);
+        g_object_unref (scaled);
+    } else {
+        ui_window_set_preview (ui, thumb);
+    }
+
+    return thumb;
+}
+
+/**
+ * Scales pixbuf up or down to fit in width x height keeping the aspect.
+ *
+ * @param pix Pixbuf to scale.
+ * @param width Width to fit in.
+ * @param height Height to fit in.
+ * @param interp Interpolation used when scaling.
+ * @return New pixbuf.
+ */
+GdkPixbuf*
+ui_window_scale_fit (GdkPixbuf *pix, guint width, guint height,
+                     GdkInterpType interp)
+{
+    gdouble scale;
+
+    scale = MIN ((gdouble) width / gdk_pixbuf_get_width (pix),
+                 (gdouble) height / gdk_pixbuf_get_height (pix));
+    return gdk_pixbuf_scale_simple (pix,
+                                    MAX (1, gdk_pixbuf_get_width (pix) * scale),
+                                    MAX (1, gdk_pixbuf_get_height (pix) * scale),
+                                    interp);
+}
+
+/**
+ * Cancels decoding of the active image, a running decode stops at the
+ * next slice of data and its result is dropped.
+ *
+ * @param ui Pointer to struct ui_window.
+ */
+void
+ui_window_decode_cancel (struct ui_window *ui)
+{
+    if (! ui->decode_job) {
+        return;
+    }
+
+    if (ui->decode_timeout) {
+        /* Not pushed to the pool yet */
+        g_source_remove (ui->decode_timeout);
+        ui->decode_timeout = 0;
+        ui_decode_job_free (ui->decode_job);
+    } else {
+        /* Freed by idle_image_decoded */
+        g_cancellable_cancel (ui->decode_job->cancellable);
+    }
+    ui->decode_job = NULL;
+}
+
+/**
+ * Reloads the displayed image at full size in the decode pool, the
+ * downscaled image is displayed until done.
+ *
+ * @param ui Pointer to struct ui_window.
+ */
+void
+ui_window_decode_reload (struct ui_window *ui)
+{
+    struct ui_decode_job *job;
+
+    job = g_malloc0 (sizeof (struct ui_decode_job));
+    job->ui = ui;
+    job->file = ui->file;
+    job->reload = TRUE;
+    job->serial = ++ui->decode_serial;
+    job->cancellable = g_cancellable_new ();
+    ui->decode_job = job;
+
+    g_thread_pool_push (ui->decode_pool, job, NULL);
+}
+
+/**
+ * Decodes image in the decode pool, handing the result back to the
+ * main loop.
+ *
+ * @param data Pointer to struct ui_decode_job.
+ * @param user_data Pointer to struct ui_window.
+ */
+void
+ui_window_decode_worker (gpointer data, gpointer user_data)
+{
+    struct ui_decode_job *job = (struct ui_decode_job*) data;
+    const gchar *path = file_multi_get_path (job->file);
+
+    if (job->width) {
+        job->image = image_open_fit (path, job->width, job->height,
+                                     job->cancellable,
+                                     &ui_window_decode_progress, job);
+    } else if (job->reload) {
+        /* The displayed image is kept until done, no partial images */
+        job->image = image_open (path, job->cancellable, NULL, NULL);
+    } else {
+        job->image = image_open (path, job->cancellable,
+                                 &ui_window_decode_progress, job);
+    }
+
+    g_idle_add (&idle_image_decoded, job);
+}
+
+/**
+ * Hands partially decoded image, scaled to the view, to the main loop.
+ * The image starts out with the placeholder scaled up so that areas not
+ * yet decoded keep showing the thumbnail.
+ *
+ * @param pix Partially decoded image.
+ * @param prepared TRUE if no data has been decoded yet.
+ * @param data Pointer to struct ui_decode_job.
+ */
+void
+ui_window_decode_progress (GdkPixbuf *pix, gboolean prepared, gpointer data)
+{
+    struct ui_decode_job *job = (struct ui_decode_job*) data;
+    struct ui_decode_preview *preview;
+    const gchar *orientation_str;
+    gint orientation = 0, width, height;
+    guint width_fit = job->view_width, height_fit = job->view_height, tmp;
+    gdouble aspect;
+
+    orientation_str = gdk_pixbuf_get_option (pix, "orientation");
+    if (orientation_str) {
+        orientation = g_ascii_strtoll (orientation_str, NULL, 10);
+    }
+
+    width = gdk_pixbuf_get_width (pix);
+    height = gdk_pixbuf_get_height (pix);
+    if (prepared) {
+        /* Thumbnails are oriented, only used when the image is not */
+        if (job->placeholder && orientation <= TOP_LEFT_SIDE) {
+            aspect = (gdouble) gdk_pixbuf_get_width (job->placeholder)
+                / gdk_pixbuf_get_height (job->placeholder);
+            if (ABS (aspect - (gdouble) width / height)
+                < aspect * UI_PREVIEW_ASPECT_DIFF) {
+                gdk_pixbuf_scale (job->placeholder, pix, 0, 0, width, height,
+                                  0.0, 0.0,
+                                  (gdouble) width
+                                  / gdk_pixbuf_get_width (job->placeholder),
+                                  (gdouble) height
+                                  / gdk_pixbuf_get_height (job->placeholder),
+                                  GDK_INTERP_NEAREST);
+            }
+        }
+        return;
+    }
+
+    if (! width_fit || ! height_fit) {
+        return;
+    }
+
+    /* Fit in the unrotated frame */
+    if (orientation >= LEFT_SIDE_TOP) {
+        tmp = width_fit;
+        width_fit = height_fit;
+        height_fit = tmp;
+    }
+
+    preview = g_malloc (sizeof (struct ui_decode_preview));
+    preview->ui = job->ui;
+    preview->serial = job->serial;
+    preview->pix = ui_window_scale_fit (pix, width_fit, height_fit,
+                                        GDK_INTERP_NEAREST);
+    if (orientation > 0) {
+        orientation_apply (&preview->pix, &width_fit, &height_fit,
+                           orientation);
+    }
+
+    g_idle_add (&idle_image_progress, preview);
+}
+
+/**
+ * Frees decode job and image not handed over to the window.
+ *
+ * @param job Pointer to struct ui_decode_job.
+ */
+void
+ui_decode_job_free (struct ui_decode_job *job)
+{
+    if (job->image) {
+        image_close (job->image);
+    }
+    if (job->placeholder) {
+        g_object_unref (job->placeholder);
+    }
+    g_object_unref (job->cancellable);
+    g_free (job);
+}
+
+/**
+ * Requests thumbnails for the visible range first, then for a margin
+ * in the scroll direction growing with the scroll velocity and a
+ * smaller margin behind. Rows outside the wanted range are released.
+ *
+ * @param data Pointer to struct ui_window.
+ * @return FALSE, requests are made in a single pass.
+ */
+gboolean
+idle_thumb_load (gpointer data)
+{
+    struct ui_window *ui = (struct ui_window*) data;
+    gdouble velocity;
+    gint first, last, visible, ahead, behind, want_first, want_last;
+
+    gdk_threads_enter ();
+
+    ui->thumb_idle = 0;
+
+    if (ui->mode != UI_WINDOW_MODE_FULL
+        && thumb_grid_get_visible_range (ui->thumb_grid, &first, &last)) {
+
+        /* Velocity is in pages per second, a page being the visible
+           rows, prefetch what is reached within the prefetch time. */
+        velocity = ui->thumb_velocity;
+        visible = last - first + 1;
+        behind = MAX (1, visible / 2);
+        ahead = (gint) ((velocity < 0 ? -velocity : velocity)
+                        * UI_THUMB_PREFETCH_TIME * visible);
+        ahead = CLAMP (ahead, behind, UI_THUMB_PREFETCH_MAX * visible);
+
+        if (velocity < 0) {
+            want_first = MAX (0, first - ahead);
+            want_last = MIN ((gint) ui->thumbnails - 1, last + behind);
+        } else {
+            want_first = MAX (0, first - behind);
+            want_last = MIN ((gint) ui->thumbnails - 1, last + ahead);
+        }
+
+        g_atomic_int_set (&ui->thumb_want_first, want_first);
+        g_atomic_int_set (&ui->thumb_want_last, want_last);
+
+        ui_window_thumb_release (ui, want_first, want_last);
+        if (options.thumb_compress) {
+            ui_window_thumb_compress (ui, first, last);
+        }
+
+        ui_window_thumb_request (ui, first, last);
+        if (velocity < 0) {
+            ui_window_thumb_request (ui, first - 1, want_first);
+            ui_window_thumb_request (ui, last + 1, want_last);
+        } else {
+            ui_window_thumb_request (ui, last + 1, want_last);
+            ui_window_thumb_request (ui, first - 1, want_first);
+        }
+    }
+
+    gdk_threads_leave ();
+
+    return FALSE;
+}
+
+/**
+ * Sets a thumbnail generated by the thumbnail pool on its row. Rows
+ * that left the wanted range meanwhile are reset to pending.
+ *
+ * @param data Pointer to struct ui_thumb_job.
+ * @return FALSE, only run once.
+ */
+gboolean
+idle_thumb_loaded (gpointer data)
+{
+    struct ui_thumb_job *job = (struct ui_thumb_job*) data;
+    struct ui_window *ui = job->ui;
+
+    gdk_threads_enter ();
+
+    if (thumb_grid_get_state (ui->thumb_grid, job->index)
+        == UI_THUMB_STATE_REQUESTED) {
+        if (job->skipped || ! ui_window_thumb_is_wanted (ui, job->index)) {
+            thumb_grid_set_thumb (ui->thumb_grid, job->index, NULL,
+                                  UI_THUMB_STATE_PENDING);
+        } else {
+            thumb_grid_set_thumb (ui->thumb_grid, job->index, job->thumb,
+                                  UI_THUMB_STATE_LOADED);
+        }
+    }
+
+    gdk_threads_leave ();
+
+    if (job->thumb) {
+        g_object_unref (job->thumb);
+    }
+    g_free (job);
+
+    return FALSE;
+}
+
+/**
+ * Pushes pending rows from from to to, inclusive and in that order,
+ * to the thumbnail pool.
+ *
+ * @param ui Pointer to struct ui_window.
+ * @param from First row to request.
+ * @param to Last row to request, may be before from.
+ */
+void
+ui_window_thumb_request (struct ui_window *ui, gint from, gint to)
+{
+    struct ui_thumb_job *job;
+    gint i, step = from <= to ? 1 : -1;
+
+    for (i = from; i != to + step; i += step) {
+        if (thumb_grid_get_state (ui->thumb_grid, i)
+            != UI_THUMB_STATE_PENDING) {
+            continue;
+        }
+
+        thumb_grid_set_thumb (ui->thumb_grid, i, NULL,
+                              UI_THUMB_STATE_REQUESTED);
+
+        job = g_malloc0 (sizeof (struct ui_thumb_job));
+        job->ui = ui;
+        job->file = thumb_grid_get_file (ui->thumb_grid, i);
+        job->index = i;
+
+        /* Hint the first jobs, the pool hints further ones as it
+           works through the queue. */
+        g_mutex_lock (&ui->thumb_queued_mutex);
+        g_queue_push_tail (&ui->thumb_queued, job);
+        if (g_queue_get_length (&ui->thumb_queued)
+            <= ui->thumb_readahead->count) {
+            ui_window_thumb_hint (ui, job);
+        }
+        g_mutex_unlock (&ui->thumb_queued_mutex);
+
+        g_thread_pool_push (ui->thumb_pool, job, NULL);
+    }
+}
+
+/**
+ * Hints the file of a queued thumbnail job if generating it needs
+ * reading the file.
+ *
+ * @param ui Pointer to struct ui_window.
+ * @param job Pointer to struct ui_thumb_job, NULL is ignored.
+ */
+void
+ui_window_thumb_hint (struct ui_window *ui, struct ui_thumb_job *job)
+{
+    if (job && ui_window_thumb_is_wanted (ui, job->index)
+        && thumb_need_read (job->file, options.thumb_side)) {
+        readahead_hint (ui->thumb_readahead, job->file);
+    }
+}
+
+/**
+ * Checks if row is in the wanted range, safe to call from the
+ * thumbnail pool.
+ *
+ * @param ui Pointer to struct ui_window.
+ * @param index Row to check.
+ * @return TRUE if row is wanted.
+ */
+gboolean
+ui_window_thumb_is_wanted (struct ui_window *ui, gint index)
+{
+    return index >= g_atomic_int_get (&ui->thumb_want_first)
+        && index <= g_atomic_int_get (&ui->thumb_want_last);
+}
+
+/**
+ * Generates a requested thumbnail unless the row scrolled out of the
+ * wanted range while queued, result is set from the main loop.
+ *
+ * @param data Pointer to struct ui_thumb_job.
+ * @param user_data Pointer to struct ui_window.
+ */
+void
+ui_window_thumb_worker (gpointer data, gpointer user_data)
+{
+    struct ui_thumb_job *job = (struct ui_thumb_job*) data;
+    struct ui_window *ui = job->ui;
+
+    /* Keep count jobs hinted ahead of the ones being generated */
+    g_mutex_lock (&ui->thumb_queued_mutex);
+    g_queue_remove (&ui->thumb_queued, job);
+    ui_window_thumb_hint (ui, g_queue_peek_nth (&ui->thumb_queued,
+                                                ui->thumb_readahead->count
+                                                - 1));
+    g_mutex_unlock (&ui->thumb_queued_mutex);
+
+    if (ui_window_thumb_is_wanted (ui, job->index)) {
+        readahead_read (ui->thumb_readahead, job->file);
+        job->thumb = thumb_get (job->file, options.thumb_side, TRUE);
+    } else {
+        job->skipped = TRUE;
+    }
+
+    g_idle_add (&idle_thumb_loaded, job);
+}
+
+/**
+ * Schedules requesting of visible pending thumbnails unless already
+ * scheduled.
+ *
+ * @param ui Pointer to struct ui_window.
+ */
+void
+ui_window_thumb_schedule (struct ui_window *ui)
+{
+    if (! ui->thumb_idle) {
+        ui->thumb_idle = g_idle_add (&idle_thumb_load, (void*) ui);
+    }
+}
+
+/**
+ * Releases decoded thumbnails of rows far outside the wanted range,
+ * keeping memory use proportional to the view. Released rows are
+ * loaded again through the thumbnail cache when they become visible.
+ *
+ * @param ui Pointer to struct ui_window.
+ * @param first First wanted row.
+ * @param last Last wanted row.
+ */
+void
+ui_window_thumb_release (struct ui_window *ui, gint first, gint last)
+{
+    gint i, keep_first, keep_last;
+
+    /* Keep a view worth of rows on each side for short scrolls */
+    keep_first = first - (last - first + 1);
+    keep_last = last + (last - first + 1);
+
+    for (i = ui->thumb_first; i <= ui->thumb_last; i++) {
+        if (i >= keep_first && i <= keep_last) {
+            i = keep_last;
+            continue;
+        }
+        if (thumb_grid_get_state (ui->thumb_grid, i)
+            == UI_THUMB_STATE_LOADED) {
+            thumb_grid_set_thumb (ui->thumb_grid, i, NULL,
+                                  UI_THUMB_STATE_PENDING);
+        }
+    }
+
+    /* Rows kept from before and the wanted rows decoded next */
+    if (ui->thumb_first > ui->thumb_last
+        || ui->thumb_last < keep_first || ui->thumb_first > keep_last) {
+        ui->thumb_first = first;
+        ui->thumb_last = last;
+    } else {
+        ui->thumb_first = MIN (first, MAX (ui->thumb_first, keep_first));
+        ui->thumb_last = MAX (last, MIN (ui->thumb_last, keep_last));
+    }
+}
+
+/**
+ * Compresses kept thumbnails outside the visible range and expands the
+ * visible ones.
+ *
+ * @param ui Pointer to struct ui_window.
+ * @param first First visible row.
+ * @param last Last visible row.
+ */
+void
+ui_window_thumb_compress (struct ui_window *ui, gint first, gint last)
+{
+    gint i;
+
+    for (i = ui->thumb_first; i <= ui->thumb_last; i++) {
+        thumb_grid_compress (ui->thumb_grid, i, i < first || i > last);
+    }
+}
+
+/**
+ * Callback for scrolling of thumbnail view, tracks the scroll velocity
+ * used to size the prefetch range.
+ *
+ * @param adjustment Adjustment that changed.
+ * @param data Pointer to struct ui_window.
+ */
+void
+callback_thumb_scroll (GtkAdjustment *adjustment, gpointer data)
+{
+    struct ui_window *ui = (struct ui_window*) data;
+    gdouble value, page, velocity;
+    gint64 now, elapsed;
+
+    value = gtk_adjustment_get_value (adjustment);
+    page = gtk_adjustment_get_page_size (adjustment);
+    now = g_get_monotonic_time ();
+    elapsed = now - ui->thumb_scroll_time;
+
+    /* Scrolling after a pause starts from rest */
+    if (elapsed > 0 && elapsed < G_USEC_PER_SEC / 2 && page > 0) {
+        velocity = (value - ui->thumb_scroll_value) / page
+            * G_USEC_PER_SEC / elapsed;
+        ui->thumb_velocity = (ui->thumb_velocity + velocity) / 2;
+    } else {
+        ui->thumb_velocity = 0.0;
+    }
+    ui->thumb_scroll_value = value;
+    ui->thumb_scroll_time = now;
+
+    ui_window_thumb_schedule (ui);
+}
+
+/**
+ * Callback for resizing of thumbnail view.
+ *
+ * @param widget Thumbnail view.
+ * @param allocation New allocation.
+ * @param data Pointer to struct ui_window.
+ */
+void
+callback_thumb_allocate (GtkWidget *widget, GtkAllocation *allocation,
+                         gpointer data)
+{
+    ui_window_thumb_schedule ((struct ui_window*) data);
+}
+
 /**
  * Callback to handle key press events.
  *
@@ -554,6 +1442,22 @@ gboolean
 callback_key_press (GtkWidget *widget, GdkEventKey *key, gpointer data)
 {
     struct ui_window *ui = (struct ui_window*) data;
+    gint jump_to = ui->jump_to;
+
+    /* Number typed before g or G selects the image to jump to */
+    if ((key->keyval >= GDK_KEY_1 && key->keyval <= GDK_KEY_9)
+        || (key->keyval == GDK_KEY_0 && jump_to > 0)) {
+        if (jump_to < G_MAXINT / 10 - 9) {
+            ui->jump_to = jump_to * 10 + (key->keyval - GDK_KEY_0);
+        }
+        return TRUE;
+    }
+    ui->jump_to = 0;
+
+    /* Navigation keys move the selection while the grid has focus */
+    if (thumb_grid_key_press (ui->thumb_grid, key)) {
+        return TRUE;
+    }
 
     switch (key->keyval) {
     case GDK_KEY_0:
@@ -592,13 +1496,25 @@ callback_key_press (GtkWidget *widget, GdkEventKey *key, gpointer data)
         /* Prev image (if in slideshow/full mode). */
         slide_prev (ui);      
         break;
+    case GDK_KEY_g: /* First or numbered image */
+    case GDK_KEY_Home:
+        slide_jump (ui, jump_to > 0 ? jump_to - 1 : 0);
+        break;
+    case GDK_KEY_G: /* Last or numbered image */
+    case GDK_KEY_End:
+        slide_jump (ui, jump_to > 0 ? jump_to - 1 : (gint) ui->thumbnails - 1);
+        break;
+    case GDK_KEY_Page_Down:
+        slide_page (ui, 1);
+        break;
+    case GDK_KEY_Page_Up:
+        slide_page (ui, -1);
+        break;
     case GDK_KEY_minus:
-        image_zoom (ui->image_data, -10);
-        ui_window_update_image (ui);
+        callback_menu_zoom_out (NULL, ui);
         break;
     case GDK_KEY_plus:
-        image_zoom (ui->image_data, 10);
-        ui_window_update_image (ui);
+        callback_menu_zoom_in (NULL, ui);
         break;
     case GDK_KEY_F11:
         if (ui->is_fullscreen) {
@@ -619,30 +1535,26 @@ callback_key_press (GtkWidget *widget, GdkEventKey *key, gpointer data)
 /**
  * Activates image.
  *
- * @param icon_view Icon View.
- * @param tree_path Tree Path.
- * @param data Data.
+ * @param grid Thumbnail grid.
+ * @param index Index of activated thumbnail.
+ * @param data Pointer to struct ui_window.
  */
 void
-callback_image (GtkIconView *icon_view, GtkTreePath *tree_path, gpointer data)
+callback_image (struct thumb_grid *grid, gint index, gpointer data)
 {
     struct ui_window *ui = (struct ui_window*) data;
-    struct file_multi *file;
 
     /* Expand from thumb mode to slide mode. */
     if (ui->mode == UI_WINDOW_MODE_THUMB) {
         ui_window_set_mode (ui, UI_WINDOW_MODE_SLIDE);
     }
 
-    /* Get current object */
-    gtk_tree_model_get_iter (GTK_TREE_MODEL (ui->icon_store),
-                             &ui->icon_iter, tree_path);
-    gtk_tree_model_get (GTK_TREE_MODEL (ui->icon_store), &ui->icon_iter,
-                        UI_ICON_STORE_FILE, &file, -1);
-    gtk_icon_view_scroll_to_path (ui->icon_view, tree_path, FALSE, 0, 0);
-
     /* Activate image and ensure that thumbnail being visible */
-    ui_window_set_image (ui, file, ui->zoom_fit, FALSE);
+    ui->thumb_current = index;
+    thumb_grid_scroll_to (grid, index, FALSE);
+    ui_window_set_image (ui, thumb_grid_get_file (grid, index),
+                         ui->zoom_fit, FALSE);
+    ui_window_readahead (ui, 1);
 }
 
 /**
@@ -677,44 +1589,6 @@ callback_zoom (GtkWidget *widget, GdkEventScroll *event, gpointer user_data)
     }
 }
 
-/**
- * Callback when text is edited for thumbnails, renames the file.
- *
- * @param cell Rendered generating the singnal.
- * @param path_string Path to item.
- * @param text Edited text.
- * @param data Pointer to struct ui_window.
- */
-void
-callback_icon_edited (GtkCellRendererText *cell,
-                      gchar *path_string, gchar *text, gpointer data)
-{
-    struct ui_window *ui = (struct ui_window*) data;
-    struct file_multi *file;
-
-    GtkTreeIter iter;
-
-    /* Nothing to do */
-    if (! g_utf8_strlen (text, 2)) {
-        return;
-    }
-
-    gtk_tree_model_get_iter_from_string (GTK_TREE_MODEL (ui->icon_store),
-                                         &iter, path_string);
-    gtk_tree_model_get (GTK_TREE_MODEL (ui->icon_store),
-                        &iter, UI_ICON_STORE_FILE, &file, -1);
-
-    if (file_multi_rename (file, text)) {
-        gtk_list_store_set (GTK_LIST_STORE (ui->icon_store), &iter,
-                            UI_ICON_STORE_NAME, text, -1);
-
-    } else {
-        g_log (G_LOG_DOMAIN, G_LOG_LEVEL_WARNING,
-               "failed to rename file from %s to %s",
-               file_multi_get_name (file), text);
-    }
-}
-
 /**
  * Handles callbacks for displaying the menu.
  *
@@ -1111,77 +1985,113 @@ ui_window_progress_add (gpointer data, gint count)
 void
 slide_next (struct ui_window *ui)
 {
-    gboolean set_image = TRUE;
-    struct file_multi *file;
+    gint index = ui->thumb_current + 1;
 
-    if (ui->icon_iter.stamp == 0) {
-        set_image = FALSE;
-    } else {
-        set_image = gtk_tree_model_iter_next (
-            GTK_TREE_MODEL (ui->icon_store), &ui->icon_iter);
+    if (index >= (gint) ui->thumbnails) {
+        index = 0;
     }
+    ui_window_slide_to (ui, index, 1);
+}
+
+/**
+ * Show the previous image in the set.
+ */
+void
+slide_prev (struct ui_window *ui)
+{
+    gint index = ui->thumb_current - 1;
 
-    if (! set_image) {
-        set_image = gtk_tree_model_get_iter_first(
-            GTK_TREE_MODEL (ui->icon_store), &ui->icon_iter);
+    if (index < 0) {
+        index = ui->thumbnails - 1;
     }
+    ui_window_slide_to (ui, index, -1);
+}
+
+/**
+ * Skips a page of images, a page being the visible thumbnails or
+ * UI_WINDOW_PAGE images when no thumbnails are visible.
+ *
+ * @param ui Pointer to struct ui_window.
+ * @param dir 1 to skip forward, -1 to skip backward.
+ */
+void
+slide_page (struct ui_window *ui, gint dir)
+{
+    gint first, last, page = UI_WINDOW_PAGE;
 
-    if (set_image) {
-        gtk_tree_model_get (GTK_TREE_MODEL (ui->icon_store), &ui->icon_iter,
-                            UI_ICON_STORE_FILE, &file, -1);
+    if (ui->mode != UI_WINDOW_MODE_FULL
+        && thumb_grid_get_visible_range (ui->thumb_grid, &first, &last)) {
+        page = last - first + 1;
+    }
 
-        /* Update selected item. */
-        GtkTreePath *path = gtk_tree_model_get_path (GTK_TREE_MODEL (ui->icon_store), &ui->icon_iter);
-        gtk_icon_view_select_path (ui->icon_view, path);
-        gtk_icon_view_scroll_to_path (ui->icon_view, path, FALSE, 0, 0);
-        gtk_tree_path_free (path);
+    slide_jump (ui, ui->thumb_current + dir * page);
+}
 
-        ui_window_set_image (ui, file, ui->zoom_fit, FALSE);        
+/**
+ * Shows image at index, clamped to the set.
+ *
+ * @param ui Pointer to struct ui_window.
+ * @param index Index of image to show.
+ */
+void
+slide_jump (struct ui_window *ui, gint index)
+{
+    index = CLAMP (index, 0, (gint) ui->thumbnails - 1);
+    if (index != ui->thumb_current) {
+        ui_window_slide_to (ui, index, index > ui->thumb_current ? 1 : -1);
     }
 }
 
 /**
- * Show the previous image in the set.
+ * Selects thumbnail and activates its image.
+ *
+ * @param ui Pointer to struct ui_window.
+ * @param index Index of thumbnail to activate.
+ * @param dir Direction of navigation, 1 for next and -1 for previous.
  */
 void
-slide_prev (struct ui_window *ui)
+ui_window_slide_to (struct ui_window *ui, gint index, gint dir)
 {
-    int i;
-    gboolean set_image;
     struct file_multi *file;
-    GtkTreePath *path;
 
-    if (ui->icon_iter.stamp == 0) {
-        set_image = FALSE;
-    } else {
-        path = gtk_tree_model_get_path (GTK_TREE_MODEL (ui->icon_store), 
-                                        &ui->icon_iter);
-        set_image = gtk_tree_path_prev (path)
-            && gtk_tree_model_get_iter (GTK_TREE_MODEL (ui->icon_store), 
-                                        &ui->icon_iter, path);
-        gtk_tree_path_free(path);
+    file = thumb_grid_get_file (ui->thumb_grid, index);
+    if (! file) {
+        return;
     }
 
-    if (! set_image) {
-        set_image = gtk_tree_model_get_iter_first(
-            GTK_TREE_MODEL (ui->icon_store), &ui->icon_iter);        
+    /* Update selected item. */
+    ui->thumb_current = index;
+    thumb_grid_select (ui->thumb_grid, index);
+    thumb_grid_scroll_to (ui->thumb_grid, index, FALSE);
 
-        for (i = 1; i < ui->thumbnails && set_image; i++ ) {
-            set_image = gtk_tree_model_iter_next (
-                GTK_TREE_MODEL (ui->icon_store), &ui->icon_iter);
-        }
-    }
+    ui_window_set_image (ui, file, ui->zoom_fit, FALSE);
+    ui_window_readahead (ui, dir);
+}
 
-    if (set_image) {
-        gtk_tree_model_get (GTK_TREE_MODEL (ui->icon_store), &ui->icon_iter,
-                            UI_ICON_STORE_FILE, &file, -1);
+/**
+ * Hints upcoming images in navigation direction from the active image.
+ * Hints in the other direction are dropped when direction changes.
+ *
+ * @param ui Pointer to struct ui_window.
+ * @param dir Direction of navigation, 1 for next and -1 for previous.
+ */
+void
+ui_window_readahead (struct ui_window *ui, gint dir)
+{
+    struct file_multi *file;
+    guint i;
 
-        /* Update selected item. */
-        GtkTreePath *path = gtk_tree_model_get_path (GTK_TREE_MODEL (ui->icon_store), &ui->icon_iter);
-        gtk_icon_view_select_path (ui->icon_view, path);
-        gtk_icon_view_scroll_to_path (ui->icon_view, path, FALSE, 0, 0);
-        gtk_tree_path_free (path);
+    if (dir != ui->readahead_dir) {
+        readahead_reset (ui->readahead);
+        ui->readahead_dir = dir;
+    }
 
-        ui_window_set_image (ui, file, ui->zoom_fit, FALSE);        
+    for (i = 1; i <= ui->readahead->count; i++) {
+        file = thumb_grid_get_file (ui->thumb_grid,
+                                    ui->thumb_current + (gint) i * dir);
+        if (! file) {
+            break;
+        }
+        readahead_hint (ui->readahead, file);
     }
 }
@@ -37,19 +37,28 @@
 
 #include "file_multi.h"
 #include "image.h"
-
-#define UI_ICON_STORE_FILE 0
-#define UI_ICON_STORE_NAME 1
-#define UI_ICON_STORE_THUMB 2
-#define UI_ICON_STORE_FIELDS 3
+#include "readahead.h"
+#include "thumb_grid.h"
 
 #define UI_WINDOW_MODE_FULL 0
 #define UI_WINDOW_MODE_SLIDE 1
 #define UI_WINDOW_MODE_THUMB 2
 
+#define UI_THUMB_STATE_PENDING 0
+#define UI_THUMB_STATE_REQUESTED 1
+#define UI_THUMB_STATE_LOADED 2
+
 #define UI_THUMB_PADDING 8
-#define UI_THUMB_CHARS 14
 #define UI_SLIDE_PADDING 84
+#define UI_THUMB_PREFETCH_TIME 0.5
+#define UI_THUMB_PREFETCH_MAX 4
+#define UI_WINDOW_READAHEAD 4
+#define UI_WINDOW_THUMB_READAHEAD 8
+#define UI_WINDOW_PAGE 10
+#define UI_WINDOW_DECODE_DELAY 50
+#define UI_PREVIEW_ASPECT_DIFF 0.02
+
+struct ui_decode_job;
 
 /**
  * Struct defining UI window.
@@ -64,19 +73,37 @@ struct ui_window {
   guint width_alloc_prev; /**< Previous width allocation for window. */
   guint height_alloc_prev; /**< Previous height allocation for window. */
 
-  GtkImage *image; /**< Image */
+  GtkDrawingArea *image; /**< Area the current image is painted on. */
+  GdkPixbuf *image_preview; /**< Shown while decoding, NULL if none. */
   GtkScrolledWindow *image_window; /** Image Area */
 
-  GtkIconView *icon_view; /**< Thumbnail View */
-  GtkScrolledWindow *icon_view_window; /** Thumbnail Area */
-  GtkListStore *icon_store; /**< Thumbnail Store */
-  GtkTreeIter icon_iter; /**< Thumbnail Store Iterator */
-  GtkTreeIter icon_iter_add; /**< Thumbnail Store Iterator for adding data */
+  struct thumb_grid *thumb_grid; /**< Thumbnail View */
+  gint thumb_current; /**< Thumbnail of active file, -1 if none. */
+  gint jump_to; /**< Number typed before jumping, 0 if none. */
   guint thumbnails; /**< Number of thumbnails */
+  guint thumb_idle; /**< Idle source decoding visible thumbnails. */
+  gint thumb_first; /**< First row that may hold a decoded thumbnail. */
+  gint thumb_last; /**< Last row that may hold a decoded thumbnail. */
+  GThreadPool *thumb_pool; /**< Pool generating requested thumbnails. */
+  gint thumb_want_first; /**< First row wanted, read by thumb_pool. */
+  gint thumb_want_last; /**< Last row wanted, read by thumb_pool. */
+  GQueue thumb_queued; /**< Jobs pushed to thumb_pool, in request order. */
+  GMutex thumb_queued_mutex; /**< Lock for thumb_queued. */
+  struct readahead *thumb_readahead; /**< Readahead of queued thumbnails. */
+  gdouble thumb_scroll_value; /**< Adjustment value at last scroll. */
+  gint64 thumb_scroll_time; /**< Monotonic time of last scroll. */
+  gdouble thumb_velocity; /**< Smoothed scroll velocity, pages/second. */
 
   guint mode; /**< Current mode of window. */
   struct file_multi *file; /**< Active file. */
   struct image *image_data; /**< Image wrapper for scaling/rotating. */
+  GThreadPool *decode_pool; /**< Pool decoding the active image. */
+  struct ui_decode_job *decode_job; /**< Decode of active file, or NULL. */
+  guint decode_timeout; /**< Timeout starting a coalesced decode. */
+  gint64 decode_time; /**< Monotonic time of last image change. */
+  guint decode_serial; /**< Incremented for every decode started. */
+  struct readahead *readahead; /**< Readahead of upcoming images. */
+  gint readahead_dir; /**< Direction of last navigation, 1 or -1. */
 
   GtkProgressBar *progress; /**< Progress bar for loading. */
   gint progress_total; /**< Total number to load. */
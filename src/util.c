@@ -30,13 +30,17 @@
 #include "config.h"
 #endif /* HAVE_CONFIG_H */
 
+#include <errno.h>
 #include <string.h>
 #include <stdarg.h>
+#include <unistd.h>
 
 #include "util.h"
 
+static gboolean util_uri_is_safe (guchar c);
+
 /**
- * Lazy case insensitive strpos.
+ * Case insensitive strpos, does not allocate.
  *
  * @param haystack String to search in.
  * @param needle String to find.
@@ -45,23 +49,29 @@
 const gchar*
 util_stripos (const gchar *haystack, const gchar *needle)
 {
-    gchar *haystack_up = g_ascii_strup (g_strdup (haystack), strlen (haystack));
-    gchar *needle_up = g_ascii_strup (g_strdup (needle), strlen (needle));
-
-    const gchar *pos;
+    gsize needle_len = strlen (needle);
 
-    /* Find needle in haystack */ 
-    pos = strstr (haystack_up, needle_up);
-    if (pos) {
-        /* Get position in original stack */
-        pos = haystack + ((pos - haystack_up) / sizeof (pos[0]));
+    /* Find needle in haystack */
+    for (; *haystack != '\0'; haystack++) {
+        if (g_ascii_strncasecmp (haystack, needle, needle_len) == 0) {
+            return haystack;
+        }
     }
 
-    /* Clean resources */
-    g_free (haystack_up);
-    g_free (needle_up);
+    return needle_len ? NULL : haystack;
+}
 
-    return pos;
+/**
+ * Case insensitive check if str starts with prefix.
+ *
+ * @param str String to check.
+ * @param prefix Prefix to look for.
+ * @return TRUE if str starts with prefix, else FALSE.
+ */
+gboolean
+util_str_has_prefix_casei (const gchar *str, const gchar *prefix)
+{
+    return g_ascii_strncasecmp (str, prefix, strlen (prefix)) == 0;
 }
 
 /**
@@ -93,3 +103,121 @@ util_str_in (const gchar *str, gboolean casei, ...)
   
     return FALSE;
 }
+
+/**
+ * Returns the current directory, looked up once as geh never changes
+ * working directory.
+ *
+ * @return Current directory, must not be freed.
+ */
+const gchar*
+util_get_current_dir (void)
+{
+    static gsize cwd = 0;
+
+    if (g_once_init_enter (&cwd)) {
+        g_once_init_leave (&cwd, (gsize) g_get_current_dir ());
+    }
+
+    return (const gchar*) cwd;
+}
+
+/**
+ * Checks if character can be used as is in the path of an URI, same
+ * set of characters as g_filename_to_uri leaves unescaped.
+ *
+ * @param c Character to check.
+ * @return TRUE if character does not need escaping, else FALSE.
+ */
+gboolean
+util_uri_is_safe (guchar c)
+{
+    if (g_ascii_isalnum (c)) {
+        return TRUE;
+    }
+
+    switch (c) {
+    case '-': case '_': case '.': case '~': case '!': case '$':
+    case '&': case '\'': case '(': case ')': case '*': case '+':
+    case ',': case '=': case ':': case '@': case '/':
+        return TRUE;
+    default:
+        return FALSE;
+    }
+}
+
+/**
+ * Returns length of str once escaped for use in the path of an URI.
+ *
+ * @param str String to get escaped length for.
+ * @return Length of escaped string, not including terminating NUL.
+ */
+gsize
+util_uri_escape_len (const gchar *str)
+{
+    gsize len = 0;
+
+    for (; *str != '\0'; str++) {
+        len += util_uri_is_safe (*str) ? 1 : 3;
+    }
+
+    return len;
+}
+
+/**
+ * Escapes str for use in the path of an URI, writing the result
+ * directly to dst which must hold util_uri_escape_len (str) bytes.
+ * The result is not NUL terminated.
+ *
+ * @param dst Buffer to write escaped string to.
+ * @param str String to escape.
+ * @return Pointer to the byte after the last one written.
+ */
+gchar*
+util_uri_escape (gchar *dst, const gchar *str)
+{
+    static const gchar hex[] = "0123456789ABCDEF";
+    guchar c;
+
+    for (; *str != '\0'; str++) {
+        c = *str;
+        if (util_uri_is_safe (c)) {
+            *dst++ = c;
+        } else {
+            *dst++ = '%';
+            *dst++ = hex[c >> 4];
+            *dst++ = hex[c & 0xf];
+        }
+    }
+
+    return dst;
+}
+
+/**
+ * Writes all of data to file descriptor, retrying short and interrupted
+ * writes.
+ *
+ * @param fd File descriptor to write to.
+ * @param data Data to write.
+ * @param len Length of data.
+ * @return TRUE if all data was written, else FALSE.
+ */
+gboolean
+util_write_all (int fd, const guchar *data, gsize len)
+{
+    ssize_t written;
+
+    while (len > 0) {
+        written = write (fd, data, len);
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return FALSE;
+        }
+        data += written;
+        len -= written;
+    }
+
+    return TRUE;
+}
@@ -36,6 +36,15 @@
 #include <glib.h>
 
 extern const gchar *util_stripos (const gchar *haystack, const gchar *needle);
+extern gboolean util_str_has_prefix_casei (const gchar *str,
+                                           const gchar *prefix);
 extern gboolean util_str_in (const gchar *str, gboolean casei, ...);
 
+extern const gchar *util_get_current_dir (void);
+
+extern gsize util_uri_escape_len (const gchar *str);
+extern gchar *util_uri_escape (gchar *dst, const gchar *str);
+
+extern gboolean util_write_all (int fd, const guchar *data, gsize len);
+
 #endif /* _UTIL_H_ */
@@ -0,0 +1,120 @@
+#!/bin/sh
+#
+# Prewarms generated images in concurrent shards into a temporary cache
+# and checks that every image ends up with exactly one valid entry,
+# both in the thumbnail cache and in the packed store.
+#
+# Usage: prewarm_shard.sh path/to/geh [shards] [images]
+#
+
+GEH=${1:?usage: $0 path/to/geh [shards] [images]}
+SHARDS=${2:-4}
+IMAGES=${3:-64}
+
+TMP=$(mktemp -d) || exit 1
+trap 'rm -rf "$TMP"' EXIT
+mkdir "$TMP/images" "$TMP/cache" || exit 1
+
+# Small random PPM images, any format gdk-pixbuf loads will do
+i=0
+while [ $i -lt $IMAGES ]; do
+    name=$(printf "%s/images/image_%04d.ppm" "$TMP" $i)
+    { printf 'P6\n300 200\n255\n'; head -c 180000 /dev/urandom; } > "$name"
+    i=$((i + 1))
+done
+
+XDG_CACHE_HOME="$TMP/cache"
+export XDG_CACHE_HOME
+
+# All shards run at once, appending to the same packed store
+i=0
+pids=""
+while [ $i -lt $SHARDS ]; do
+    "$GEH" --prewarm --pack -r --shard $i/$SHARDS "$TMP/images" \
+        > "$TMP/shard_$i.log" 2>&1 &
+    pids="$pids $!"
+    i=$((i + 1))
+done
+
+status=0
+for pid in $pids; do
+    wait $pid || status=1
+done
+if [ $status -ne 0 ]; then
+    cat "$TMP"/shard_*.log
+    echo "FAIL: prewarm exited with an error"
+    exit 1
+fi
+
+python3 - "$TMP" <<'PYTHON'
+import hashlib
+import os
+import struct
+import sys
+
+tmp = sys.argv[1]
+uris = {}
+for name in sorted(os.listdir(os.path.join(tmp, 'images'))):
+    uri = 'file://' + os.path.join(tmp, 'images', name)
+    uris[hashlib.md5(uri.encode()).digest()] = uri
+
+errors = 0
+
+# Thumbnail cache, named by digest of the URI it was generated for
+for digest, uri in uris.items():
+    path = os.path.join(tmp, 'cache', 'thumbnails', 'normal',
+                        digest.hex() + '.png')
+    try:
+        with open(path, 'rb') as f:
+            data = f.read()
+    except OSError:
+        print('missing thumbnail for', uri)
+        errors += 1
+        continue
+    if not data.startswith(b'\x89PNG') \
+       or b'Thumb::URI\x00' + uri.encode() not in data:
+        print('invalid thumbnail for', uri)
+        errors += 1
+
+# Packed store, records validated as in thumb_pack_record_valid
+with open(os.path.join(tmp, 'cache', 'geh', 'thumbs.pack'), 'rb') as f:
+    data = f.read()
+if data[:8] != b'GEHPACK1':
+    print('invalid packed store header')
+    sys.exit(1)
+
+header = struct.Struct('<II16sqqIIIIII')
+counts = {}
+offset = 8
+while offset + header.size <= len(data):
+    (magic, data_len, digest, mtime, size, side, pad,
+     width, height, rowstride, has_alpha) = header.unpack_from(data, offset)
+    channels = 4 if has_alpha else 3
+    if magic == 0x54485042 \
+       and 0 < width <= 4096 and 0 < height <= 4096 and has_alpha <= 1 \
+       and pad == 0 \
+       and rowstride >= width * channels \
+       and rowstride <= (width * channels + 3) & ~3 \
+       and data_len == (height - 1) * rowstride + width * channels \
+       and offset + header.size + data_len <= len(data):
+        counts[digest] = counts.get(digest, 0) + 1
+        offset += header.size + ((data_len + 7) & ~7)
+    else:
+        print('invalid data at offset', offset)
+        errors += 1
+        offset += 8
+
+for digest, uri in uris.items():
+    if counts.get(digest, 0) != 1:
+        print('%d packed entries for %s' % (counts.get(digest, 0), uri))
+        errors += 1
+for digest in counts:
+    if digest not in uris:
+        print('unexpected packed entry', digest.hex())
+        errors += 1
+
+if errors:
+    print('FAIL: %d errors' % errors)
+    sys.exit(1)
+print('OK: %d images, one entry each' % len(uris))
+PYTHON